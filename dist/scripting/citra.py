@@ -1,22 +1,38 @@
+import collections
 import struct
 import random
 import enum
 import socket
+import time
 
-CURRENT_REQUEST_VERSION = 1
-MAX_REQUEST_DATA_SIZE = 32
-MAX_PACKET_SIZE = 48
+CURRENT_REQUEST_VERSION = 2
+MAX_REQUEST_DATA_SIZE = 60 * 1024
+MAX_PACKET_SIZE = 16 + MAX_REQUEST_DATA_SIZE
 
 class RequestType(enum.IntEnum):
     ReadMemory = 1,
-    WriteMemory = 2
+    WriteMemory = 2,
+    ReadMemoryRanges = 3,
+    Subscribe = 4,
+    Unsubscribe = 5,
+    SubscriptionUpdate = 6,
+    RenewSubscription = 7
+
+class SubscriptionFlags(enum.IntFlag):
+    EveryFrame = 0,
+    OnChange = 1
 
 CITRA_PORT = 45987
+# Subscriptions that aren't renewed within this time are dropped by the emulator
+SUBSCRIPTION_LEASE_SECONDS = 10
 
 class Citra:
     def __init__(self, address="127.0.0.1", port=CITRA_PORT):
         self.socket = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
         self.address = address
+        self.subscriptions = {}
+        self.subscription_renewals = {}
+        self.pending_updates = collections.deque()
 
     def is_connected(self):
         return self.socket is not None
@@ -90,6 +106,225 @@ class Citra:
                 return False
         return True
 
+    def _send_request(self, request_type, request_data):
+        request, request_id = self._generate_header(request_type, len(request_data))
+        self.socket.sendto(request + request_data, (self.address, CITRA_PORT))
+        while True:
+            raw_reply = self.socket.recv(MAX_PACKET_SIZE)
+            # Keep subscription updates that arrive before the reply for later
+            _, _, reply_type, _ = struct.unpack("IIII", raw_reply[:4*4])
+            if reply_type != RequestType.SubscriptionUpdate:
+                break
+            self.pending_updates.append(raw_reply)
+        return self._read_and_validate_header(raw_reply, request_id, request_type), request_id
+
+    @staticmethod
+    def _pack_ranges(ranges):
+        request_data = struct.pack("I", len(ranges))
+        for address, size in ranges:
+            request_data += struct.pack("II", address, size)
+        return request_data
+
+    def read_memory_ranges(self, ranges):
+        """
+        Reads several (address, size) ranges in a single request.
+        >>> c.read_memory_ranges([(0x100000, 4), (0x100000, 2)])
+        [b'\\x07\\x00\\x00\\xeb', b'\\x07\\x00']
+        """
+        reply_data, _ = self._send_request(RequestType.ReadMemoryRanges, self._pack_ranges(ranges))
+        if not reply_data:
+            return None
+        result = []
+        for _, size in ranges:
+            result.append(reply_data[:size])
+            reply_data = reply_data[size:]
+        return result
+
+    def subscribe(self, ranges, flags=SubscriptionFlags.EveryFrame):
+        """
+        Asks for the (address, size) ranges to be sent at every frame, or only when they changed.
+        Returns the subscription id, to be passed to unsubscribe, or None on failure.
+        Updates are received with receive_subscription_update, which also keeps the subscription
+        alive. Otherwise it has to be renewed with renew_subscription.
+        """
+        request_data = struct.pack("I", flags) + self._pack_ranges(ranges)
+        reply_data, _ = self._send_request(RequestType.Subscribe, request_data)
+        if not reply_data:
+            return None
+        subscription_id, = struct.unpack("I", reply_data)
+        if subscription_id == 0:
+            return None
+        self.subscriptions[subscription_id] = ranges
+        self.subscription_renewals[subscription_id] = time.monotonic()
+        return subscription_id
+
+    def renew_subscription(self, subscription_id):
+        """
+        Extends the lease of a subscription. Returns False if it already expired.
+        """
+        reply_data, _ = self._send_request(RequestType.RenewSubscription,
+                                           struct.pack("I", subscription_id))
+        if not reply_data or struct.unpack("I", reply_data)[0] == 0:
+            self.subscriptions.pop(subscription_id, None)
+            self.subscription_renewals.pop(subscription_id, None)
+            return False
+        self.subscription_renewals[subscription_id] = time.monotonic()
+        return True
+
+    def _renew_subscriptions(self):
+        now = time.monotonic()
+        for subscription_id, renewal in list(self.subscription_renewals.items()):
+            if now - renewal >= SUBSCRIPTION_LEASE_SECONDS / 2:
+                self.renew_subscription(subscription_id)
+
+    def receive_subscription_update(self):
+        """
+        Waits for the next subscription update. Returns the subscription id and the contents of
+        each of its ranges.
+        """
+        while True:
+            self._renew_subscriptions()
+            if self.pending_updates:
+                raw_reply = self.pending_updates.popleft()
+            else:
+                # Wake up regularly to renew the subscriptions while no update arrives
+                self.socket.settimeout(SUBSCRIPTION_LEASE_SECONDS / 4)
+                try:
+                    raw_reply = self.socket.recv(MAX_PACKET_SIZE)
+                except socket.timeout:
+                    continue
+                finally:
+                    self.socket.settimeout(None)
+            version, _, reply_type, reply_data_size = struct.unpack("IIII", raw_reply[:4*4])
+            if (version != CURRENT_REQUEST_VERSION or
+                reply_type != RequestType.SubscriptionUpdate or
+                reply_data_size != len(raw_reply[4*4:]) or reply_data_size < 4):
+                continue
+            subscription_id, = struct.unpack("I", raw_reply[4*4:4*5])
+            if subscription_id not in self.subscriptions:
+                continue
+            reply_data = raw_reply[4*5:]
+            result = []
+            for _, size in self.subscriptions[subscription_id]:
+                result.append(reply_data[:size])
+                reply_data = reply_data[size:]
+            return subscription_id, result
+
+    def unsubscribe(self, subscription_id):
+        """
+        Stops a subscription. Updates that were already sent may still be received.
+        """
+        self.subscriptions.pop(subscription_id, None)
+        self.subscription_renewals.pop(subscription_id, None)
+        reply_data, _ = self._send_request(RequestType.Unsubscribe,
+                                           struct.pack("I", subscription_id))
+        return reply_data is not None
+
+class CitraSharedMemory:
+    """
+    Client of the shared memory transport, enabled with rpc_shared_memory. Only works on the host
+    running the emulator. The control block layout matches RPC::SharedMemoryControl. The regions
+    are named after the process ID of the emulator, which is also printed in its log.
+    """
+    MAGIC = 0x43505243
+    LAYOUT_VERSION = 2
+    REQUEST_WRITE = 64
+    REQUEST_READ = 128
+    RESPONSE_WRITE = 192
+    RESPONSE_READ = 256
+    SNAPSHOT_REQUESTED = 320
+    SNAPSHOT_SEQUENCE = 324
+    SNAPSHOT_TICKS = 328
+    DROPPED_RESPONSES = 336
+    HEADER_SIZE = 384
+
+    def __init__(self, pid):
+        import mmap
+        import sys
+        control_name = "citra-rpc-{}".format(pid)
+        fcram_name = "citra-rpc-fcram-{}".format(pid)
+        if sys.platform == "win32":
+            self.control = mmap.mmap(-1, self.HEADER_SIZE, "Local\\" + control_name)
+        else:
+            with open("/dev/shm/" + control_name, "r+b") as f:
+                self.control = mmap.mmap(f.fileno(), 0)
+        magic, version, self.slot_count, self.slot_size, self.fcram_size = \
+            struct.unpack_from("IIIII", self.control, 0)
+        if magic != self.MAGIC or version != self.LAYOUT_VERSION:
+            raise RuntimeError("Unsupported shared memory layout")
+        if sys.platform == "win32":
+            size = self.HEADER_SIZE + self.slot_size * self.slot_count * 2
+            self.control = mmap.mmap(-1, size, "Local\\" + control_name)
+            self.fcram = mmap.mmap(-1, self.fcram_size, "Local\\" + fcram_name,
+                                   access=mmap.ACCESS_READ)
+        else:
+            with open("/dev/shm/" + fcram_name, "rb") as f:
+                self.fcram = mmap.mmap(f.fileno(), 0, access=mmap.ACCESS_READ)
+
+    def _load(self, offset):
+        return struct.unpack_from("I", self.control, offset)[0]
+
+    def _store(self, offset, value):
+        struct.pack_into("I", self.control, offset, value & 0xFFFFFFFF)
+
+    def _slot(self, index, response):
+        return self.HEADER_SIZE + self.slot_size * (index % self.slot_count +
+                                                    (self.slot_count if response else 0))
+
+    def request(self, request_type, request_data):
+        """
+        Sends a request in the same format as over UDP and waits for its reply data.
+        Subscription updates received in the meantime are discarded.
+        """
+        write = self._load(self.REQUEST_WRITE)
+        while write - self._load(self.REQUEST_READ) >= self.slot_count:
+            pass
+        request_id = random.getrandbits(32)
+        slot = self._slot(write, False)
+        struct.pack_into("IIIII", self.control, slot, 16 + len(request_data),
+                         CURRENT_REQUEST_VERSION, request_id, request_type, len(request_data))
+        self.control[slot + 20:slot + 20 + len(request_data)] = request_data
+        self._store(self.REQUEST_WRITE, write + 1)
+
+        while True:
+            read = self._load(self.RESPONSE_READ)
+            if read == self._load(self.RESPONSE_WRITE):
+                continue
+            slot = self._slot(read, True)
+            size, _, reply_id, reply_type, reply_size = struct.unpack_from("IIIII", self.control,
+                                                                           slot)
+            reply_data = bytes(self.control[slot + 20:slot + 20 + reply_size])
+            self._store(self.RESPONSE_READ, read + 1)
+            if reply_id == request_id and reply_type == request_type:
+                return reply_data
+
+    def read_memory(self, read_address, read_size):
+        return self.request(RequestType.ReadMemory, struct.pack("II", read_address, read_size))
+
+    def dropped_responses(self):
+        """
+        Returns how many responses the emulator dropped so far because the response ring was full.
+        Subscription updates are dropped right away, so a growing count means they were missed.
+        """
+        return self._load(self.DROPPED_RESPONSES)
+
+    def read_fcram_snapshot(self, offset, size):
+        """
+        Asks for an FCRAM snapshot at the next frame boundary, and returns the requested part of
+        it along with the emulated CPU ticks at which it was taken.
+        """
+        self._store(self.SNAPSHOT_REQUESTED, 1)
+        while self._load(self.SNAPSHOT_REQUESTED) != 0:
+            pass
+        while True:
+            sequence = self._load(self.SNAPSHOT_SEQUENCE)
+            if sequence % 2 != 0:
+                continue
+            ticks, = struct.unpack_from("Q", self.control, self.SNAPSHOT_TICKS)
+            data = bytes(self.fcram[offset:offset + size])
+            if sequence == self._load(self.SNAPSHOT_SEQUENCE):
+                return data, ticks
+
 if "__main__" == __name__:
     import doctest
     doctest.testmod(extraglobs={'c': Citra()})
@@ -2,7 +2,10 @@
 // Licensed under GPLv2 or any later version
 // Refer to the license.txt file included.
 
+#include <atomic>
+#include <chrono>
 #include <iostream>
+#include <map>
 #include <memory>
 #include <regex>
 #include <string>
@@ -31,16 +34,20 @@
 #include "common/scope_exit.h"
 #include "common/string_util.h"
 #include "core/core.h"
+#include "core/core_timing.h"
 #include "core/dumping/backend.h"
 #include "core/file_sys/cia_container.h"
 #include "core/frontend/applets/default_applets.h"
 #include "core/frontend/framebuffer_layout.h"
 #include "core/frontend/scope_acquire_context.h"
 #include "core/gdbstub/gdbstub.h"
+#include "core/hle/call_profiler.h"
 #include "core/hle/service/am/am.h"
 #include "core/hle/service/cfg/cfg.h"
+#include "core/hw/gpu.h"
 #include "core/loader/loader.h"
 #include "core/movie.h"
+#include "core/perf_stats.h"
 #include "core/settings.h"
 #include "network/network.h"
 #include "video_core/renderer_base.h"
@@ -69,6 +76,9 @@ static void PrintHelp(const char* argv0) {
                  "-p, --movie-play=[file]    Playback the movie (game inputs) from the given file\n"
                  "-d, --dump-video=[file]    Dumps audio and video to the given video file\n"
                  "-f, --fullscreen     Start in fullscreen mode\n"
+                 "-H, --headless       Run hidden and unthrottled, then print performance"
+                 " statistics as JSON\n"
+                 "-n, --frames=NUMBER  Stop after emulating NUMBER frames\n"
                  "-h, --help           Display this help and exit\n"
                  "-v, --version        Output version information and exit\n";
 }
@@ -77,6 +87,45 @@ static void PrintVersion() {
     std::cout << "Citra " << Common::g_scm_branch << " " << Common::g_scm_desc << std::endl;
 }
 
+/// Prints the performance statistics of a headless run to stdout as JSON.
+static void PrintBenchmarkResults(Core::System& system, const Core::PerfStats::Results& results,
+                                  std::chrono::duration<double> wall_time) {
+    u64 program_id = 0;
+    system.GetAppLoader().ReadProgramId(program_id);
+    const u64 frames = system.CoreTiming().GetGlobalTicks() / GPU::frame_ticks;
+    const Core::PerfStats& perf_stats = *system.perf_stats;
+
+    std::string out = fmt::format(
+        "{{\n  \"title_id\": \"{:016X}\",\n  \"frames\": {},\n  \"wall_time_s\": {:.3f},\n"
+        "  \"emulation_speed\": {:.4f},\n  \"system_fps\": {:.2f},\n  \"game_fps\": {:.2f},\n"
+        "  \"frametime_ms\": {{\"mean\": {:.3f}, \"p50\": {:.3f}, \"p90\": {:.3f}, "
+        "\"p99\": {:.3f}, \"max\": {:.3f}}},\n  \"hle_services\": [",
+        program_id, frames, wall_time.count(), results.emulation_speed, results.system_fps,
+        results.game_fps, perf_stats.GetMeanFrametime(), perf_stats.GetFrametimePercentile(50),
+        perf_stats.GetFrametimePercentile(90), perf_stats.GetFrametimePercentile(99),
+        perf_stats.GetFrametimePercentile(100));
+
+    // Host time spent in each HLE service, as the per-subsystem breakdown of the run
+    if (const auto* call_profiler = system.GetCallProfiler()) {
+        std::map<std::string, std::pair<u64, u64>> services;
+        for (const auto& stats : call_profiler->GetServiceCallStats()) {
+            auto& [count, total_ns] = services[stats.service_name];
+            count += stats.count;
+            total_ns += stats.total_ns;
+        }
+        bool first = true;
+        for (const auto& [name, totals] : services) {
+            out += fmt::format(
+                "{}\n    {{\"service\": \"{}\", \"calls\": {}, \"total_ms\": {:.3f}}}",
+                first ? "" : ",", Common::EscapeJSON(name), totals.first,
+                static_cast<double>(totals.second) / 1e6);
+            first = false;
+        }
+    }
+    out += "\n  ]\n}\n";
+    std::cout << out << std::flush;
+}
+
 static void OnStateChanged(const Network::RoomMember::State& state) {
     switch (state) {
     case Network::RoomMember::State::Idle:
@@ -194,6 +243,8 @@ int main(int argc, char** argv) {
     std::string movie_record;
     std::string movie_play;
     std::string dump_video;
+    bool headless = false;
+    u64 frame_count = 0;
 
     InitializeLogging();
 
@@ -220,12 +271,13 @@ int main(int argc, char** argv) {
         {"gdbport", required_argument, 0, 'g'},     {"install", required_argument, 0, 'i'},
         {"multiplayer", required_argument, 0, 'm'}, {"movie-record", required_argument, 0, 'r'},
         {"movie-play", required_argument, 0, 'p'},  {"dump-video", required_argument, 0, 'd'},
-        {"fullscreen", no_argument, 0, 'f'},        {"help", no_argument, 0, 'h'},
+        {"fullscreen", no_argument, 0, 'f'},        {"headless", no_argument, 0, 'H'},
+        {"frames", required_argument, 0, 'n'},      {"help", no_argument, 0, 'h'},
         {"version", no_argument, 0, 'v'},           {0, 0, 0, 0},
     };
 
     while (optind < argc) {
-        int arg = getopt_long(argc, argv, "g:i:m:r:p:fhv", long_options, &option_index);
+        int arg = getopt_long(argc, argv, "g:i:m:r:p:fHn:hv", long_options, &option_index);
         if (arg != -1) {
             switch (static_cast<char>(arg)) {
             case 'g':
@@ -295,6 +347,19 @@ int main(int argc, char** argv) {
                 fullscreen = true;
                 LOG_INFO(Frontend, "Starting in fullscreen mode...");
                 break;
+            case 'H':
+                headless = true;
+                break;
+            case 'n':
+                errno = 0;
+                frame_count = strtoull(optarg, &endarg, 0);
+                if (endarg == optarg)
+                    errno = EINVAL;
+                if (errno != 0) {
+                    perror("--frames");
+                    exit(1);
+                }
+                break;
             case 'h':
                 PrintHelp(argv[0]);
                 return 0;
@@ -329,6 +394,11 @@ int main(int argc, char** argv) {
         return -1;
     }
 
+    if (headless && frame_count == 0 && movie_play.empty()) {
+        LOG_CRITICAL(Frontend, "Headless mode needs --frames or --movie-play to know when to stop");
+        return -1;
+    }
+
     if (!movie_record.empty()) {
         Core::Movie::GetInstance().PrepareForRecording();
     }
@@ -339,6 +409,12 @@ int main(int argc, char** argv) {
     // Apply the command line arguments
     Settings::values.gdbstub_port = gdb_port;
     Settings::values.use_gdbstub = use_gdbstub;
+    if (headless) {
+        // Run as fast as possible, without an audio device
+        Settings::values.use_frame_limit_alternate = false;
+        Settings::values.frame_limit = 0;
+        Settings::values.sink_id = "null";
+    }
     Settings::Apply();
 
     // Register frontend applets
@@ -347,7 +423,8 @@ int main(int argc, char** argv) {
     // Register generic image interface
     Core::System::GetInstance().RegisterImageInterface(std::make_shared<LodePNGImageInterface>());
 
-    std::unique_ptr<EmuWindow_SDL2> emu_window{std::make_unique<EmuWindow_SDL2>(fullscreen)};
+    std::unique_ptr<EmuWindow_SDL2> emu_window{
+        std::make_unique<EmuWindow_SDL2>(fullscreen, headless)};
     Frontend::ScopeAcquireContext scope(*emu_window);
     Core::System& system{Core::System::GetInstance()};
 
@@ -400,8 +477,9 @@ int main(int argc, char** argv) {
         }
     }
 
+    std::atomic_bool movie_finished{false};
     if (!movie_play.empty()) {
-        Core::Movie::GetInstance().StartPlayback(movie_play);
+        Core::Movie::GetInstance().StartPlayback(movie_play, [&] { movie_finished = true; });
     }
     if (!movie_record.empty()) {
         Core::Movie::GetInstance().StartRecording(movie_record);
@@ -421,11 +499,29 @@ int main(int argc, char** argv) {
                       total);
         });
 
+    if (headless) {
+        if (auto* call_profiler = system.GetCallProfiler()) {
+            call_profiler->SetEnabled(true);
+        }
+    }
+    const u64 end_ticks = frame_count * GPU::frame_ticks;
+    const auto start_time = std::chrono::steady_clock::now();
+    static_cast<void>(system.GetAndResetPerfStats());
+
     while (emu_window->IsOpen()) {
         system.RunLoop();
+        if ((frame_count != 0 && system.CoreTiming().GetGlobalTicks() >= end_ticks) ||
+            (headless && movie_finished)) {
+            emu_window->Close();
+        }
     }
     render_thread.join();
 
+    if (headless) {
+        PrintBenchmarkResults(system, system.GetAndResetPerfStats(),
+                              std::chrono::steady_clock::now() - start_time);
+    }
+
     Core::Movie::GetInstance().Shutdown();
     if (system.VideoDumper().IsDumping()) {
         system.VideoDumper().StopDumping();
@@ -106,8 +106,17 @@ void Config::ReadValues() {
     Settings::values.use_cpu_jit = sdl2_config->GetBoolean("Core", "use_cpu_jit", true);
     Settings::values.cpu_clock_percentage =
         sdl2_config->GetInteger("Core", "cpu_clock_percentage", 100);
+    Settings::values.enable_rewind = sdl2_config->GetBoolean("Core", "enable_rewind", false);
+    Settings::values.rewind_interval_frames =
+        static_cast<u32>(sdl2_config->GetInteger("Core", "rewind_interval_frames", 30));
+    Settings::values.rewind_buffer_size_mb =
+        static_cast<u32>(sdl2_config->GetInteger("Core", "rewind_buffer_size_mb", 512));
+    Settings::values.movie_anchor_interval_frames =
+        static_cast<u32>(sdl2_config->GetInteger("Core", "movie_anchor_interval_frames", 0));
 
     // Renderer
+    Settings::values.renderer_backend = static_cast<Settings::RendererBackend>(
+        sdl2_config->GetInteger("Renderer", "renderer_backend", 0));
     Settings::values.use_gles = sdl2_config->GetBoolean("Renderer", "use_gles", false);
     Settings::values.use_hw_renderer = sdl2_config->GetBoolean("Renderer", "use_hw_renderer", true);
     Settings::values.use_hw_shader = sdl2_config->GetBoolean("Renderer", "use_hw_shader", true);
@@ -205,6 +214,12 @@ void Config::ReadValues() {
         "Data Storage", "nand_directory", FileUtil::GetUserPath(FileUtil::UserPath::NANDDir));
     Settings::values.sdmc_dir = sdl2_config->GetString(
         "Data Storage", "sdmc_directory", FileUtil::GetUserPath(FileUtil::UserPath::SDMCDir));
+    Settings::values.romfs_cache_size_mb =
+        static_cast<u32>(sdl2_config->GetInteger("Data Storage", "romfs_cache_size_mb", 32));
+    Settings::values.use_code_cache =
+        sdl2_config->GetBoolean("Data Storage", "use_code_cache", true);
+    Settings::values.use_save_write_back =
+        sdl2_config->GetBoolean("Data Storage", "use_save_write_back", false);
 
     // System
     Settings::values.is_new_3ds = sdl2_config->GetBoolean("System", "is_new_3ds", true);
@@ -260,6 +275,10 @@ void Config::ReadValues() {
     // Debugging
     Settings::values.record_frame_times =
         sdl2_config->GetBoolean("Debugging", "record_frame_times", false);
+    Settings::values.record_hle_call_stats =
+        sdl2_config->GetBoolean("Debugging", "record_hle_call_stats", false);
+    Settings::values.rpc_shared_memory =
+        sdl2_config->GetBoolean("Debugging", "rpc_shared_memory", false);
     Settings::values.use_gdbstub = sdl2_config->GetBoolean("Debugging", "use_gdbstub", false);
     Settings::values.gdbstub_port =
         static_cast<u16>(sdl2_config->GetInteger("Debugging", "gdbstub_port", 24689));
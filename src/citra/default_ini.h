@@ -97,7 +97,26 @@ use_cpu_jit =
 # Range is any positive integer (but we suspect 25 - 400 is a good idea) Default is 100
 cpu_clock_percentage =
 
+# Whether to keep in-memory snapshots of the recent emulation so that it can be rewound
+# 0 (default): Off, 1: On
+enable_rewind =
+
+# How many emulated frames pass between two rewind snapshots. Default is 30
+rewind_interval_frames =
+
+# Maximum amount of memory used by rewind snapshots, in MiB. Default is 512
+rewind_buffer_size_mb =
+
+# How many emulated frames pass between two savestate anchors of a recorded movie, which allow
+# seeking during playback. 0 disables anchors. Default is 0
+movie_anchor_interval_frames =
+
 [Renderer]
+# Which renderer to use. The null renderer draws nothing, and doesn't need a window when running
+# with --headless
+# 0 (default): OpenGL, 1: Null
+renderer_backend =
+
 # Whether to render using GLES or OpenGL
 # 0 (default): OpenGL, 1: GLES
 use_gles =
@@ -258,6 +277,18 @@ sdmc_directory =
 # empty (default) will use the user_path
 nand_directory =
 
+# Maximum amount of memory used to cache decrypted RomFS data of each title, in MiB. 0 disables
+# the cache. Default is 32
+romfs_cache_size_mb =
+
+# Whether to cache the decompressed and patched code of titles on disk to speed up booting.
+# 0: No, 1 (default): Yes
+use_code_cache =
+
+# Whether to buffer small writes to save data and defer flushing it for up to half a second.
+# 0 (default): No, 1: Yes
+use_save_write_back =
+
 [System]
 # The system model that Citra will try to emulate
 # 0: Old 3DS, 1: New 3DS (default)
@@ -306,6 +337,13 @@ log_filter = *:Info
 [Debugging]
 # Record frame time data, can be found in the log directory. Boolean value
 record_frame_times =
+# Record HLE service function and SVC call statistics, written to the log directory on shutdown.
+# 0 (default): Off, 1: On
+record_hle_call_stats =
+# Also serve scripting RPC requests through shared memory, for tools running on the same host.
+# The shared memory regions are named after the process ID of the emulator.
+# 0 (default): Off, 1: On
+rpc_shared_memory =
 # Port for listening to GDB connections.
 use_gdbstub=false
 gdbstub_port=24689
@@ -105,6 +105,10 @@ bool EmuWindow_SDL2::IsOpen() const {
     return is_open;
 }
 
+void EmuWindow_SDL2::Close() {
+    is_open = false;
+}
+
 void EmuWindow_SDL2::OnResize() {
     int width, height;
     SDL_GetWindowSize(render_window, &width, &height);
@@ -132,9 +136,13 @@ void EmuWindow_SDL2::Fullscreen() {
     SDL_MaximizeWindow(render_window);
 }
 
-EmuWindow_SDL2::EmuWindow_SDL2(bool fullscreen) {
+EmuWindow_SDL2::EmuWindow_SDL2(bool fullscreen, bool headless) : headless(headless) {
+    // The null renderer draws nothing, so a headless run doesn't need a window or a GL context
+    const bool use_window =
+        !headless || Settings::values.renderer_backend != Settings::RendererBackend::Null;
+
     // Initialize the window
-    if (SDL_Init(SDL_INIT_VIDEO | SDL_INIT_JOYSTICK) < 0) {
+    if (SDL_Init((use_window ? SDL_INIT_VIDEO : SDL_INIT_EVENTS) | SDL_INIT_JOYSTICK) < 0) {
         LOG_CRITICAL(Frontend, "Failed to initialize SDL2! Exiting...");
         exit(1);
     }
@@ -144,6 +152,13 @@ EmuWindow_SDL2::EmuWindow_SDL2(bool fullscreen) {
 
     SDL_SetMainReady();
 
+    if (!use_window) {
+        LOG_INFO(Frontend, "Citra Version: {} | {}-{}", Common::g_build_fullname,
+                 Common::g_scm_branch, Common::g_scm_desc);
+        Settings::LogSettings();
+        return;
+    }
+
     SDL_GL_SetAttribute(SDL_GL_CONTEXT_MAJOR_VERSION, 3);
     if (Settings::values.use_gles) {
         SDL_GL_SetAttribute(SDL_GL_CONTEXT_MINOR_VERSION, 2);
@@ -159,8 +174,8 @@ EmuWindow_SDL2::EmuWindow_SDL2(bool fullscreen) {
     SDL_GL_SetAttribute(SDL_GL_ALPHA_SIZE, 0);
     // Enable context sharing for the shared context
     SDL_GL_SetAttribute(SDL_GL_SHARE_WITH_CURRENT_CONTEXT, 1);
-    // Enable vsync
-    SDL_GL_SetSwapInterval(1);
+    // Enable vsync, unless running headless where nothing should limit the speed
+    SDL_GL_SetSwapInterval(headless ? 0 : 1);
 
     std::string window_title = fmt::format("Citra {} | {}-{}", Common::g_build_fullname,
                                            Common::g_scm_branch, Common::g_scm_desc);
@@ -169,7 +184,8 @@ EmuWindow_SDL2::EmuWindow_SDL2(bool fullscreen) {
                          SDL_WINDOWPOS_UNDEFINED, // x position
                          SDL_WINDOWPOS_UNDEFINED, // y position
                          Core::kScreenTopWidth, Core::kScreenTopHeight + Core::kScreenBottomHeight,
-                         SDL_WINDOW_OPENGL | SDL_WINDOW_RESIZABLE | SDL_WINDOW_ALLOW_HIGHDPI);
+                         SDL_WINDOW_OPENGL | SDL_WINDOW_RESIZABLE | SDL_WINDOW_ALLOW_HIGHDPI |
+                             (headless ? SDL_WINDOW_HIDDEN : 0));
 
     if (render_window == nullptr) {
         LOG_CRITICAL(Frontend, "Failed to create SDL2 window: {}", SDL_GetError());
@@ -223,8 +239,16 @@ std::unique_ptr<Frontend::GraphicsContext> EmuWindow_SDL2::CreateSharedContext()
 }
 
 void EmuWindow_SDL2::Present() {
+    if (render_window == nullptr) {
+        // Running headless without a window, there is nothing to present to
+        while (IsOpen()) {
+            VideoCore::g_renderer->TryPresent(100);
+        }
+        return;
+    }
+
     SDL_GL_MakeCurrent(render_window, window_context);
-    SDL_GL_SetSwapInterval(1);
+    SDL_GL_SetSwapInterval(headless ? 0 : 1);
     while (IsOpen()) {
         VideoCore::g_renderer->TryPresent(100);
         SDL_GL_SwapWindow(render_window);
@@ -286,8 +310,10 @@ void EmuWindow_SDL2::PollEvents() {
         }
     }
 
+    // The title bar is hidden when running headless, and reading the statistics would reset the
+    // ones of the whole run
     const u32 current_time = SDL_GetTicks();
-    if (current_time > last_time + 2000) {
+    if (!headless && current_time > last_time + 2000) {
         const auto results = Core::System::GetInstance().GetAndResetPerfStats();
         const auto title =
             fmt::format("Citra {} | {}-{} | FPS: {:.0f} ({:.0f}%)", Common::g_build_fullname,
@@ -299,13 +325,20 @@ void EmuWindow_SDL2::PollEvents() {
 }
 
 void EmuWindow_SDL2::MakeCurrent() {
-    core_context->MakeCurrent();
+    if (core_context) {
+        core_context->MakeCurrent();
+    }
 }
 
 void EmuWindow_SDL2::DoneCurrent() {
-    core_context->DoneCurrent();
+    if (core_context) {
+        core_context->DoneCurrent();
+    }
 }
 
 void EmuWindow_SDL2::OnMinimalClientAreaChangeRequest(std::pair<u32, u32> minimal_size) {
+    if (render_window == nullptr) {
+        return;
+    }
     SDL_SetWindowMinimumSize(render_window, minimal_size.first, minimal_size.second);
 }
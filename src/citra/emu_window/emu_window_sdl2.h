@@ -29,7 +29,11 @@ private:
 
 class EmuWindow_SDL2 : public Frontend::EmuWindow {
 public:
-    explicit EmuWindow_SDL2(bool fullscreen);
+    /**
+     * @param fullscreen Whether to start in fullscreen mode
+     * @param headless Whether to keep the window hidden and present without waiting for v-sync
+     */
+    explicit EmuWindow_SDL2(bool fullscreen, bool headless = false);
     ~EmuWindow_SDL2();
 
     void Present();
@@ -46,6 +50,9 @@ public:
     /// Whether the window is still open, and a close request hasn't yet been sent
     bool IsOpen() const;
 
+    /// Closes the window, as if the user requested it
+    void Close();
+
     /// Creates a new context that is shared with the current context
     std::unique_ptr<GraphicsContext> CreateSharedContext() const override;
 
@@ -83,16 +90,19 @@ private:
     /// Is the window still open?
     bool is_open = true;
 
-    /// Internal SDL2 render window
-    SDL_Window* render_window;
+    /// Whether the window is hidden, for running benchmarks
+    bool headless;
+
+    /// Internal SDL2 render window. nullptr when running headless with the null renderer.
+    SDL_Window* render_window = nullptr;
 
     /// Fake hidden window for the core context
-    SDL_Window* dummy_window;
+    SDL_Window* dummy_window = nullptr;
 
     using SDL_GLContext = void*;
 
     /// The OpenGL context associated with the window
-    SDL_GLContext window_context;
+    SDL_GLContext window_context = nullptr;
 
     /// The OpenGL context associated with the core
     std::unique_ptr<Frontend::GraphicsContext> core_context;
@@ -57,7 +57,7 @@ const std::array<std::array<int, 5>, Settings::NativeAnalog::NumAnalogs> Config:
 // This must be in alphabetical order according to action name as it must have the same order as
 // UISetting::values.shortcuts, which is alphabetically ordered.
 // clang-format off
-const std::array<UISettings::Shortcut, 23> default_hotkeys{
+const std::array<UISettings::Shortcut, 24> default_hotkeys{
     {{QStringLiteral("Advance Frame"),            QStringLiteral("Main Window"), {QStringLiteral("\\"), Qt::ApplicationShortcut}},
      {QStringLiteral("Capture Screenshot"),       QStringLiteral("Main Window"), {QStringLiteral("Ctrl+P"), Qt::ApplicationShortcut}},
      {QStringLiteral("Continue/Pause Emulation"), QStringLiteral("Main Window"), {QStringLiteral("F4"), Qt::WindowShortcut}},
@@ -71,6 +71,7 @@ const std::array<UISettings::Shortcut, 23> default_hotkeys{
      {QStringLiteral("Load from Newest Slot"),    QStringLiteral("Main Window"), {QStringLiteral("Ctrl+V"), Qt::WindowShortcut}},
      {QStringLiteral("Remove Amiibo"),            QStringLiteral("Main Window"), {QStringLiteral("F3"), Qt::ApplicationShortcut}},
      {QStringLiteral("Restart Emulation"),        QStringLiteral("Main Window"), {QStringLiteral("F6"), Qt::WindowShortcut}},
+     {QStringLiteral("Rewind"),                   QStringLiteral("Main Window"), {QStringLiteral("Ctrl+R"), Qt::WindowShortcut}},
      {QStringLiteral("Rotate Screens Upright"),   QStringLiteral("Main Window"), {QStringLiteral("F8"), Qt::WindowShortcut}},
      {QStringLiteral("Save to Oldest Slot"),      QStringLiteral("Main Window"), {QStringLiteral("Ctrl+C"), Qt::WindowShortcut}},
      {QStringLiteral("Stop Emulation"),           QStringLiteral("Main Window"), {QStringLiteral("F5"), Qt::WindowShortcut}},
@@ -294,6 +295,13 @@ void Config::ReadCoreValues() {
     Settings::values.use_cpu_jit = ReadSetting(QStringLiteral("use_cpu_jit"), true).toBool();
     Settings::values.cpu_clock_percentage =
         ReadSetting(QStringLiteral("cpu_clock_percentage"), 100).toInt();
+    Settings::values.enable_rewind = ReadSetting(QStringLiteral("enable_rewind"), false).toBool();
+    Settings::values.rewind_interval_frames =
+        ReadSetting(QStringLiteral("rewind_interval_frames"), 30).toUInt();
+    Settings::values.rewind_buffer_size_mb =
+        ReadSetting(QStringLiteral("rewind_buffer_size_mb"), 512).toUInt();
+    Settings::values.movie_anchor_interval_frames =
+        ReadSetting(QStringLiteral("movie_anchor_interval_frames"), 0).toUInt();
 
     qt_config->endGroup();
 }
@@ -313,6 +321,12 @@ void Config::ReadDataStorageValues() {
             .toString()
             .toStdString();
 
+    Settings::values.romfs_cache_size_mb =
+        ReadSetting(QStringLiteral("romfs_cache_size_mb"), 32).toUInt();
+    Settings::values.use_code_cache = ReadSetting(QStringLiteral("use_code_cache"), true).toBool();
+    Settings::values.use_save_write_back =
+        ReadSetting(QStringLiteral("use_save_write_back"), false).toBool();
+
     qt_config->endGroup();
 }
 
@@ -322,6 +336,10 @@ void Config::ReadDebuggingValues() {
     // Intentionally not using the QT default setting as this is intended to be changed in the ini
     Settings::values.record_frame_times =
         qt_config->value(QStringLiteral("record_frame_times"), false).toBool();
+    Settings::values.record_hle_call_stats =
+        qt_config->value(QStringLiteral("record_hle_call_stats"), false).toBool();
+    Settings::values.rpc_shared_memory =
+        qt_config->value(QStringLiteral("rpc_shared_memory"), false).toBool();
     Settings::values.use_gdbstub = ReadSetting(QStringLiteral("use_gdbstub"), false).toBool();
     Settings::values.gdbstub_port = ReadSetting(QStringLiteral("gdbstub_port"), 24689).toInt();
 
@@ -475,6 +493,8 @@ void Config::ReadPathValues() {
 void Config::ReadRendererValues() {
     qt_config->beginGroup(QStringLiteral("Renderer"));
 
+    Settings::values.renderer_backend = static_cast<Settings::RendererBackend>(
+        ReadSetting(QStringLiteral("renderer_backend"), 0).toInt());
     Settings::values.use_hw_renderer =
         ReadSetting(QStringLiteral("use_hw_renderer"), true).toBool();
     Settings::values.use_hw_shader = ReadSetting(QStringLiteral("use_hw_shader"), true).toBool();
@@ -854,6 +874,13 @@ void Config::SaveCoreValues() {
     WriteSetting(QStringLiteral("use_cpu_jit"), Settings::values.use_cpu_jit, true);
     WriteSetting(QStringLiteral("cpu_clock_percentage"), Settings::values.cpu_clock_percentage,
                  100);
+    WriteSetting(QStringLiteral("enable_rewind"), Settings::values.enable_rewind, false);
+    WriteSetting(QStringLiteral("rewind_interval_frames"), Settings::values.rewind_interval_frames,
+                 30);
+    WriteSetting(QStringLiteral("rewind_buffer_size_mb"), Settings::values.rewind_buffer_size_mb,
+                 512);
+    WriteSetting(QStringLiteral("movie_anchor_interval_frames"),
+                 Settings::values.movie_anchor_interval_frames, 0);
 
     qt_config->endGroup();
 }
@@ -869,6 +896,11 @@ void Config::SaveDataStorageValues() {
                  QString::fromStdString(Settings::values.sdmc_dir),
                  QString::fromStdString(FileUtil::GetUserPath(FileUtil::UserPath::SDMCDir)));
 
+    WriteSetting(QStringLiteral("romfs_cache_size_mb"), Settings::values.romfs_cache_size_mb, 32);
+    WriteSetting(QStringLiteral("use_code_cache"), Settings::values.use_code_cache, true);
+    WriteSetting(QStringLiteral("use_save_write_back"), Settings::values.use_save_write_back,
+                 false);
+
     qt_config->endGroup();
 }
 
@@ -877,6 +909,9 @@ void Config::SaveDebuggingValues() {
 
     // Intentionally not using the QT default setting as this is intended to be changed in the ini
     qt_config->setValue(QStringLiteral("record_frame_times"), Settings::values.record_frame_times);
+    qt_config->setValue(QStringLiteral("record_hle_call_stats"),
+                        Settings::values.record_hle_call_stats);
+    qt_config->setValue(QStringLiteral("rpc_shared_memory"), Settings::values.rpc_shared_memory);
     WriteSetting(QStringLiteral("use_gdbstub"), Settings::values.use_gdbstub, false);
     WriteSetting(QStringLiteral("gdbstub_port"), Settings::values.gdbstub_port, 24689);
 
@@ -987,6 +1022,8 @@ void Config::SavePathValues() {
 void Config::SaveRendererValues() {
     qt_config->beginGroup(QStringLiteral("Renderer"));
 
+    WriteSetting(QStringLiteral("renderer_backend"),
+                 static_cast<int>(Settings::values.renderer_backend), 0);
     WriteSetting(QStringLiteral("use_hw_renderer"), Settings::values.use_hw_renderer, true);
     WriteSetting(QStringLiteral("use_hw_shader"), Settings::values.use_hw_shader, true);
 #ifdef __APPLE__
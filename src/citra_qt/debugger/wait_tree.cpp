@@ -277,6 +277,9 @@ std::vector<std::unique_ptr<WaitTreeItem>> WaitTreeThread::GetChildren() const {
                                                       .arg(thread.nominal_priority)));
     list.push_back(std::make_unique<WaitTreeText>(
         tr("last running ticks = %1").arg(thread.last_running_ticks)));
+    list.push_back(std::make_unique<WaitTreeText>(tr("run ticks = %1").arg(thread.run_ticks)));
+    list.push_back(std::make_unique<WaitTreeText>(
+        tr("context switches = %1").arg(thread.context_switch_count)));
 
     if (thread.held_mutexes.empty()) {
         list.push_back(std::make_unique<WaitTreeText>(tr("not holding mutex")));
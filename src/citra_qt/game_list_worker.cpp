@@ -15,9 +15,12 @@
 #include "citra_qt/uisettings.h"
 #include "common/common_paths.h"
 #include "common/file_util.h"
+#include "common/logging/log.h"
 #include "core/hle/service/am/am.h"
 #include "core/hle/service/fs/archive.h"
+#include "core/loader/game_metadata_index.h"
 #include "core/loader/loader.h"
+#include "core/loader/smdh.h"
 
 namespace {
 bool HasSupportedFileExtension(const std::string& file_name) {
@@ -32,11 +35,11 @@ GameListWorker::GameListWorker(QVector<UISettings::GameDir>& game_dirs,
 
 GameListWorker::~GameListWorker() = default;
 
-void GameListWorker::AddFstEntriesToGameList(const std::string& dir_path, unsigned int recursion,
-                                             GameListDir* parent_dir) {
-    const auto callback = [this, recursion, parent_dir](u64* num_entries_out,
-                                                        const std::string& directory,
-                                                        const std::string& virtual_name) -> bool {
+void GameListWorker::FindGameFiles(const std::string& dir_path, unsigned int recursion,
+                                   std::vector<std::string>& game_paths) {
+    const auto callback = [this, recursion, &game_paths](u64* num_entries_out,
+                                                         const std::string& directory,
+                                                         const std::string& virtual_name) -> bool {
         if (stop_processing) {
             // Breaks the callback loop.
             return false;
@@ -45,79 +48,87 @@ void GameListWorker::AddFstEntriesToGameList(const std::string& dir_path, unsign
         const std::string physical_name = directory + DIR_SEP + virtual_name;
         const bool is_dir = FileUtil::IsDirectory(physical_name);
         if (!is_dir && HasSupportedFileExtension(physical_name)) {
-            std::unique_ptr<Loader::AppLoader> loader = Loader::GetLoader(physical_name);
-            if (!loader) {
-                return true;
-            }
+            game_paths.push_back(physical_name);
+        } else if (is_dir && recursion > 0) {
+            watch_list.append(QString::fromStdString(physical_name));
+            FindGameFiles(physical_name, recursion - 1, game_paths);
+        }
 
-            bool executable = false;
-            const auto res = loader->IsExecutable(executable);
-            if (!executable && res != Loader::ResultStatus::ErrorEncrypted) {
-                return true;
-            }
+        return true;
+    };
 
-            u64 program_id = 0;
-            loader->ReadProgramId(program_id);
-
-            u64 extdata_id = 0;
-            loader->ReadExtdataId(extdata_id);
-
-            std::vector<u8> smdh;
-            // Look for an update icon if available
-            if (!(program_id & ~0x00040000FFFFFFFF)) {
-                std::string update_path = Service::AM::GetTitleContentPath(
-                    Service::FS::MediaType::SDMC, program_id | 0x0000000E00000000);
-                if (FileUtil::Exists(update_path)) {
-                    std::unique_ptr<Loader::AppLoader> update_loader =
-                        Loader::GetLoader(update_path);
-                    if (update_loader) {
-                        update_loader->ReadIcon(smdh);
-                    }
-                }
-            }
+    FileUtil::ForeachDirectoryEntry(nullptr, dir_path, callback);
+}
 
-            if (!Loader::IsValidSMDH(smdh)) {
-                // Read the original smdh if there is no valid update smdh
-                loader->ReadIcon(smdh);
-            }
+void GameListWorker::AddFstEntriesToGameList(const std::string& dir_path, unsigned int recursion,
+                                             GameListDir* parent_dir) {
+    std::vector<std::string> game_paths;
+    FindGameFiles(dir_path, recursion, game_paths);
 
-            if (!Loader::IsValidSMDH(smdh) && UISettings::values.game_list_hide_no_icon) {
-                // Skip this invalid entry
-                return true;
-            }
+    // Only the games that changed since the last refresh are actually read
+    const std::vector<Loader::GameMetadata> games =
+        metadata_index->Get(game_paths, &stop_processing);
+    for (std::size_t i = 0; i < game_paths.size(); ++i) {
+        if (stop_processing) {
+            return;
+        }
 
-            auto it = FindMatchingCompatibilityEntry(compatibility_list, program_id);
-
-            // The game list uses this as compatibility number for untested games
-            QString compatibility(QStringLiteral("99"));
-            if (it != compatibility_list.end())
-                compatibility = it->second.first;
-
-            emit EntryReady(
-                {
-                    new GameListItemPath(QString::fromStdString(physical_name), smdh, program_id,
-                                         extdata_id),
-                    new GameListItemCompat(compatibility),
-                    new GameListItemRegion(smdh),
-                    new GameListItem(
-                        QString::fromStdString(Loader::GetFileTypeString(loader->GetFileType()))),
-                    new GameListItemSize(FileUtil::GetSize(physical_name)),
-                },
-                parent_dir);
+        const std::string& physical_name = game_paths[i];
+        const Loader::GameMetadata& game = games[i];
+        if (game.file_type == Loader::FileType::Error) {
+            continue;
+        }
 
-        } else if (is_dir && recursion > 0) {
-            watch_list.append(QString::fromStdString(physical_name));
-            AddFstEntriesToGameList(physical_name, recursion - 1, parent_dir);
+        if (!game.executable && !game.encrypted) {
+            continue;
         }
 
-        return true;
-    };
+        const u64 program_id = game.program_id;
 
-    FileUtil::ForeachDirectoryEntry(nullptr, dir_path, callback);
+        std::vector<u8> smdh;
+        // Look for an update icon if available
+        if (!(program_id & ~0x00040000FFFFFFFF)) {
+            std::string update_path = Service::AM::GetTitleContentPath(
+                Service::FS::MediaType::SDMC, program_id | 0x0000000E00000000);
+            if (FileUtil::Exists(update_path)) {
+                smdh = metadata_index->Get(update_path).smdh;
+            }
+        }
+
+        if (!Loader::IsValidSMDH(smdh)) {
+            // Read the original smdh if there is no valid update smdh
+            smdh = game.smdh;
+        }
+
+        if (!Loader::IsValidSMDH(smdh) && UISettings::values.game_list_hide_no_icon) {
+            // Skip this invalid entry
+            continue;
+        }
+
+        auto it = FindMatchingCompatibilityEntry(compatibility_list, program_id);
+
+        // The game list uses this as compatibility number for untested games
+        QString compatibility(QStringLiteral("99"));
+        if (it != compatibility_list.end())
+            compatibility = it->second.first;
+
+        emit EntryReady(
+            {
+                new GameListItemPath(QString::fromStdString(physical_name), smdh, program_id,
+                                     game.extdata_id),
+                new GameListItemCompat(compatibility),
+                new GameListItemRegion(smdh),
+                new GameListItem(QString::fromStdString(Loader::GetFileTypeString(game.file_type))),
+                new GameListItemSize(FileUtil::GetSize(physical_name)),
+            },
+            parent_dir);
+    }
 }
 
 void GameListWorker::run() {
     stop_processing = false;
+    metadata_index =
+        std::make_unique<Loader::GameMetadataIndex>(Loader::GameMetadataIndex::GetDefaultPath());
     for (UISettings::GameDir& game_dir : game_dirs) {
         if (game_dir.path == QStringLiteral("INSTALLED")) {
             QString games_path =
@@ -154,6 +165,11 @@ void GameListWorker::run() {
         }
     }
 
+    if (!metadata_index->Save()) {
+        LOG_WARNING(Frontend, "Could not save the game metadata index");
+    }
+    metadata_index.reset();
+
     emit Finished(watch_list);
 }
 
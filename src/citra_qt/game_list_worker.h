@@ -9,6 +9,7 @@
 #include <memory>
 #include <string>
 #include <unordered_map>
+#include <vector>
 #include <QList>
 #include <QObject>
 #include <QRunnable>
@@ -19,6 +20,10 @@
 
 class QStandardItem;
 
+namespace Loader {
+class GameMetadataIndex;
+}
+
 /**
  * Asynchronous worker object for populating the game list.
  * Communicates with other threads through Qt's signal/slot system.
@@ -53,6 +58,9 @@ signals:
     void Finished(QStringList watch_list);
 
 private:
+    /// Appends the paths of the files that may be games to game_paths, and watches the folders.
+    void FindGameFiles(const std::string& dir_path, unsigned int recursion,
+                       std::vector<std::string>& game_paths);
     void AddFstEntriesToGameList(const std::string& dir_path, unsigned int recursion,
                                  GameListDir* parent_dir);
 
@@ -61,4 +69,5 @@ private:
 
     QStringList watch_list;
     std::atomic_bool stop_processing;
+    std::unique_ptr<Loader::GameMetadataIndex> metadata_index;
 };
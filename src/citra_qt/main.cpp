@@ -589,6 +589,12 @@ void GMainWindow::InitializeHotkeys() {
             &QShortcut::activated, ui->action_Load_from_Newest_Slot, &QAction::trigger);
     connect(hotkey_registry.GetHotkey(main_window, QStringLiteral("Save to Oldest Slot"), this),
             &QShortcut::activated, ui->action_Save_to_Oldest_Slot, &QAction::trigger);
+    connect(hotkey_registry.GetHotkey(main_window, QStringLiteral("Rewind"), this),
+            &QShortcut::activated, this, [&] {
+                if (emu_thread && Settings::values.enable_rewind) {
+                    Core::System::GetInstance().SendSignal(Core::System::Signal::Rewind, 1);
+                }
+            });
 }
 
 void GMainWindow::ShowUpdaterWidgets() {
@@ -757,6 +763,7 @@ void GMainWindow::ConnectMenuEvents() {
     connect(ui->action_Play_Movie, &QAction::triggered, this, &GMainWindow::OnPlayMovie);
     connect(ui->action_Stop_Recording_Playback, &QAction::triggered, this,
             &GMainWindow::OnStopRecordingPlayback);
+    connect(ui->action_Seek_Movie, &QAction::triggered, this, &GMainWindow::OnSeekMovie);
     connect(ui->action_Enable_Frame_Advancing, &QAction::triggered, this, [this] {
         if (emulation_running) {
             Core::System::GetInstance().frame_limiter.SetFrameAdvancing(
@@ -1971,6 +1978,7 @@ void GMainWindow::OnPlayMovie() {
     ui->action_Record_Movie->setEnabled(false);
     ui->action_Play_Movie->setEnabled(false);
     ui->action_Stop_Recording_Playback->setEnabled(true);
+    ui->action_Seek_Movie->setEnabled(true);
 }
 
 void GMainWindow::OnStopRecordingPlayback() {
@@ -1989,6 +1997,34 @@ void GMainWindow::OnStopRecordingPlayback() {
     ui->action_Record_Movie->setEnabled(true);
     ui->action_Play_Movie->setEnabled(true);
     ui->action_Stop_Recording_Playback->setEnabled(false);
+    ui->action_Seek_Movie->setEnabled(false);
+}
+
+void GMainWindow::OnSeekMovie() {
+    const auto& movie = Core::Movie::GetInstance();
+    const u64 frame_count = movie.GetFrameCount();
+    if (frame_count == 0) {
+        QMessageBox::warning(this, tr("Seek Movie"),
+                             tr("This movie was recorded without a frame index, it doesn't "
+                                "support seeking."));
+        return;
+    }
+
+    bool ok = false;
+    const int max_frame = static_cast<int>(std::min<u64>(frame_count, INT_MAX));
+    const int frame = QInputDialog::getInt(
+        this, tr("Seek Movie"), tr("Frame to seek to (0 - %1):").arg(max_frame),
+        static_cast<int>(std::min<u64>(movie.GetCurrentFrame(), max_frame)), 0, max_frame, 1, &ok);
+    if (!ok) {
+        return;
+    }
+    // Emulation pauses with frame advancing once the frame is reached
+    ui->action_Enable_Frame_Advancing->setChecked(true);
+    ui->action_Advance_Frame->setEnabled(true);
+    Core::System::GetInstance().SendSignal(Core::System::Signal::SeekMovie,
+                                           static_cast<u32>(frame));
+    Core::System::GetInstance().frame_limiter.SetFrameAdvancing(true);
+    Core::System::GetInstance().frame_limiter.AdvanceFrame();
 }
 
 void GMainWindow::OnCaptureScreenshot() {
@@ -2360,6 +2396,7 @@ void GMainWindow::OnMoviePlaybackCompleted() {
     ui->action_Record_Movie->setEnabled(true);
     ui->action_Play_Movie->setEnabled(true);
     ui->action_Stop_Recording_Playback->setEnabled(false);
+    ui->action_Seek_Movie->setEnabled(false);
 }
 
 void GMainWindow::UpdateWindowTitle() {
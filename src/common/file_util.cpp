@@ -12,6 +12,7 @@
 #include "common/common_paths.h"
 #include "common/file_util.h"
 #include "common/logging/log.h"
+#include "common/scope_exit.h"
 #include "core/settings.h"
 
 #ifdef _WIN32
@@ -44,7 +45,9 @@
 #include <cstdlib>
 #include <cstring>
 #include <dirent.h>
+#include <fcntl.h>
 #include <pwd.h>
+#include <sys/mman.h>
 #include <unistd.h>
 #endif
 
@@ -345,6 +348,21 @@ u64 GetSize(const std::string& filename) {
     return 0;
 }
 
+s64 GetModificationTime(const std::string& filename) {
+    struct stat buf;
+#ifdef _WIN32
+    if (_wstat64(Common::UTF8ToUTF16W(filename).c_str(), &buf) == 0)
+#else
+    if (stat(filename.c_str(), &buf) == 0)
+#endif
+    {
+        return static_cast<s64>(buf.st_mtime);
+    }
+
+    LOG_ERROR(Common_Filesystem, "Stat failed {}: {}", filename, GetLastErrorMsg());
+    return 0;
+}
+
 u64 GetSize(const int fd) {
     struct stat buf;
     if (fstat(fd, &buf) != 0) {
@@ -672,6 +690,23 @@ std::string GetSysDirectory() {
     return sysDir;
 }
 
+std::string GetTempDirectory() {
+#ifdef _WIN32
+    wchar_t path[MAX_PATH + 1];
+    if (GetTempPathW(MAX_PATH + 1, path) != 0) {
+        return Common::UTF16ToUTF8(path);
+    }
+    return "." DIR_SEP;
+#else
+    const char* envvar = getenv("TMPDIR");
+    std::string path = envvar ? envvar : "/tmp";
+    if (path.empty() || path.back() != DIR_SEP_CHR) {
+        path += DIR_SEP_CHR;
+    }
+    return path;
+#endif
+}
+
 namespace {
 std::unordered_map<UserPath, std::string> g_paths;
 }
@@ -1056,4 +1091,93 @@ bool IOFile::Resize(u64 size) {
     return m_good;
 }
 
+MappedFile::MappedFile() = default;
+
+MappedFile::MappedFile(const std::string& filename) {
+#ifdef _WIN32
+    const HANDLE file =
+        CreateFileW(Common::UTF8ToUTF16W(filename).c_str(), GENERIC_READ, FILE_SHARE_READ,
+                    nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+        return;
+    }
+    SCOPE_EXIT({ CloseHandle(file); });
+
+    LARGE_INTEGER file_size;
+    if (!GetFileSizeEx(file, &file_size) || file_size.QuadPart <= 0 ||
+        static_cast<u64>(file_size.QuadPart) > std::numeric_limits<std::size_t>::max()) {
+        return;
+    }
+    mapping_handle = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (mapping_handle == nullptr) {
+        LOG_WARNING(Common_Filesystem, "Could not map {}: {}", filename, GetLastErrorMsg());
+        return;
+    }
+    data = static_cast<const u8*>(MapViewOfFile(mapping_handle, FILE_MAP_READ, 0, 0, 0));
+    if (data == nullptr) {
+        LOG_WARNING(Common_Filesystem, "Could not map {}: {}", filename, GetLastErrorMsg());
+        CloseHandle(mapping_handle);
+        mapping_handle = nullptr;
+        return;
+    }
+    size = static_cast<u64>(file_size.QuadPart);
+#else
+    const int fd = open(filename.c_str(), O_RDONLY);
+    if (fd == -1) {
+        return;
+    }
+    SCOPE_EXIT({ close(fd); });
+
+    struct stat file_info;
+    if (fstat(fd, &file_info) != 0 || file_info.st_size <= 0 ||
+        static_cast<u64>(file_info.st_size) > std::numeric_limits<std::size_t>::max()) {
+        return;
+    }
+    const std::size_t length = static_cast<std::size_t>(file_info.st_size);
+    void* const view = mmap(nullptr, length, PROT_READ, MAP_SHARED, fd, 0);
+    if (view == MAP_FAILED) {
+        LOG_WARNING(Common_Filesystem, "Could not map {}: {}", filename, GetLastErrorMsg());
+        return;
+    }
+    data = static_cast<const u8*>(view);
+    size = length;
+#endif
+}
+
+MappedFile::~MappedFile() {
+    Close();
+}
+
+MappedFile::MappedFile(MappedFile&& other) noexcept {
+    Swap(other);
+}
+
+MappedFile& MappedFile::operator=(MappedFile&& other) noexcept {
+    Swap(other);
+    return *this;
+}
+
+void MappedFile::Swap(MappedFile& other) noexcept {
+    std::swap(data, other.data);
+    std::swap(size, other.size);
+#ifdef _WIN32
+    std::swap(mapping_handle, other.mapping_handle);
+#endif
+}
+
+void MappedFile::Close() {
+    if (data == nullptr) {
+        return;
+    }
+#ifdef _WIN32
+    UnmapViewOfFile(data);
+    CloseHandle(mapping_handle);
+    mapping_handle = nullptr;
+#else
+    munmap(const_cast<u8*>(data), static_cast<std::size_t>(size));
+#endif
+    data = nullptr;
+    size = 0;
+}
+
 } // namespace FileUtil
@@ -105,6 +105,9 @@ private:
 // Overloaded GetSize, accepts FILE*
 [[nodiscard]] u64 GetSize(FILE* f);
 
+// Returns the last modification time of filename in seconds since the epoch, or 0 on failure
+[[nodiscard]] s64 GetModificationTime(const std::string& filename);
+
 // Returns true if successful, or path already exists.
 bool CreateDir(const std::string& filename);
 
@@ -192,6 +195,9 @@ const void UpdateUserPath(UserPath path, const std::string& filename);
 // Returns the path to where the sys file are
 [[nodiscard]] std::string GetSysDirectory();
 
+// Returns the directory for temporary files, with a trailing separator
+[[nodiscard]] std::string GetTempDirectory();
+
 #ifdef __APPLE__
 [[nodiscard]] std::string GetBundleDirectory();
 #endif
@@ -328,6 +334,10 @@ public:
         return nullptr != m_file;
     }
 
+    [[nodiscard]] const std::string& GetFilename() const {
+        return filename;
+    }
+
     // m_good is set to false when a read, write or other function fails
     [[nodiscard]] bool IsGood() const {
         return m_good;
@@ -379,6 +389,45 @@ private:
     friend class boost::serialization::access;
 };
 
+/**
+ * A read-only view of a whole file mapped into the address space, so that reads are served
+ * straight from the host page cache without intermediate buffers. Mapping can fail (e.g. for
+ * empty files or when the address space is exhausted), in which case callers should fall back
+ * to IOFile.
+ */
+class MappedFile : public NonCopyable {
+public:
+    MappedFile();
+    explicit MappedFile(const std::string& filename);
+    ~MappedFile();
+
+    MappedFile(MappedFile&& other) noexcept;
+    MappedFile& operator=(MappedFile&& other) noexcept;
+
+    void Swap(MappedFile& other) noexcept;
+
+    void Close();
+
+    [[nodiscard]] bool IsOpen() const {
+        return data != nullptr;
+    }
+
+    [[nodiscard]] const u8* Data() const {
+        return data;
+    }
+
+    [[nodiscard]] u64 Size() const {
+        return size;
+    }
+
+private:
+    const u8* data = nullptr;
+    u64 size = 0;
+#ifdef _WIN32
+    void* mapping_handle = nullptr;
+#endif
+};
+
 } // namespace FileUtil
 
 // To deal with Windows being dumb at unicode:
@@ -135,6 +135,38 @@ std::string ReplaceAll(std::string result, const std::string& src, const std::st
     return result;
 }
 
+std::string EscapeJSON(const std::string& str) {
+    std::string result;
+    result.reserve(str.size());
+    for (const char c : str) {
+        switch (c) {
+        case '"':
+            result += "\\\"";
+            break;
+        case '\\':
+            result += "\\\\";
+            break;
+        case '\n':
+            result += "\\n";
+            break;
+        case '\r':
+            result += "\\r";
+            break;
+        case '\t':
+            result += "\\t";
+            break;
+        default:
+            if (static_cast<unsigned char>(c) < 0x20) {
+                result += fmt::format("\\u{:04x}", static_cast<int>(c));
+            } else {
+                result += c;
+            }
+            break;
+        }
+    }
+    return result;
+}
+
 std::string UTF16ToUTF8(const std::u16string& input) {
     std::wstring_convert<std::codecvt_utf8_utf16<char16_t>, char16_t> convert;
     return convert.to_bytes(input);
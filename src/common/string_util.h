@@ -37,6 +37,9 @@ void BuildCompleteFilename(std::string& _CompleteFilename, const std::string& _P
 [[nodiscard]] std::string ReplaceAll(std::string result, const std::string& src,
                                      const std::string& dest);
 
+/// Escapes a string so it can be placed between quotes in a JSON document.
+[[nodiscard]] std::string EscapeJSON(const std::string& str);
+
 [[nodiscard]] std::string UTF16ToUTF8(const std::u16string& input);
 [[nodiscard]] std::u16string UTF8ToUTF16(const std::string& input);
 
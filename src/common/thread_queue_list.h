@@ -4,204 +4,261 @@
 
 #pragma once
 
-#include <algorithm>
 #include <array>
 #include <deque>
 #include <boost/serialization/deque.hpp>
 #include <boost/serialization/split_member.hpp>
+#include <boost/serialization/version.hpp>
+#include "common/assert.h"
+#include "common/bit_set.h"
 #include "common/common_types.h"
 
 namespace Common {
 
+/**
+ * Intrusive links used by ThreadQueueList. Types stored in a ThreadQueueList must derive from
+ * ThreadQueueListNode<T> so that queue operations never need to allocate. An element can be
+ * linked into at most one queue at a time.
+ */
+template <class T>
+class ThreadQueueListNode {
+public:
+    /// Returns whether this element is currently linked into a queue.
+    [[nodiscard]] bool IsQueued() const {
+        return queued;
+    }
+
+private:
+    template <class, unsigned int>
+    friend struct ThreadQueueList;
+
+    T* prev_in_queue = nullptr;
+    T* next_in_queue = nullptr;
+    bool queued = false;
+};
+
+/**
+ * Multi-level FIFO queue of elements ordered by priority, where lower priority values are served
+ * first. A bitmap of non-empty levels allows finding the best element in constant time, and each
+ * level is an intrusive doubly-linked list so insertion and removal are also constant time.
+ */
 template <class T, unsigned int N>
 struct ThreadQueueList {
-    // TODO(yuriks): If performance proves to be a problem, the std::deques can be replaced with
-    //               (dynamically resizable) circular buffers to remove their overhead when
-    //               inserting and popping.
-
     using Priority = unsigned int;
+    using Node = ThreadQueueListNode<T>;
 
     // Number of priority levels. (Valid levels are [0..NUM_QUEUES).)
     static constexpr Priority NUM_QUEUES = N;
-
-    ThreadQueueList() {
-        first = nullptr;
-    }
+    static_assert(NUM_QUEUES <= 64, "Priority bitmap only supports up to 64 levels");
 
     // Only for debugging, returns priority level.
-    [[nodiscard]] Priority contains(const T& uid) const {
+    [[nodiscard]] Priority contains(const T* element) const {
         for (Priority i = 0; i < NUM_QUEUES; ++i) {
-            const Queue& cur = queues[i];
-            if (std::find(cur.data.cbegin(), cur.data.cend(), uid) != cur.data.cend()) {
-                return i;
+            for (const T* cur = queues[i].head; cur != nullptr; cur = ToNode(cur)->next_in_queue) {
+                if (cur == element) {
+                    return i;
+                }
             }
         }
 
         return -1;
     }
 
-    [[nodiscard]] T get_first() const {
-        const Queue* cur = first;
-        while (cur != nullptr) {
-            if (!cur->data.empty()) {
-                return cur->data.front();
-            }
-            cur = cur->next_nonempty;
+    [[nodiscard]] T* get_first() const {
+        if (nonempty_mask == 0) {
+            return nullptr;
         }
-
-        return T();
+        return queues[LeastSignificantSetBit(nonempty_mask)].head;
     }
 
-    T pop_first() {
-        Queue* cur = first;
-        while (cur != nullptr) {
-            if (!cur->data.empty()) {
-                auto tmp = std::move(cur->data.front());
-                cur->data.pop_front();
-                return tmp;
-            }
-            cur = cur->next_nonempty;
+    T* pop_first() {
+        if (nonempty_mask == 0) {
+            return nullptr;
         }
-
-        return T();
+        return PopFront(static_cast<Priority>(LeastSignificantSetBit(nonempty_mask)));
     }
 
-    T pop_first_better(Priority priority) {
-        Queue* cur = first;
-        Queue* stop = &queues[priority];
-        while (cur < stop) {
-            if (!cur->data.empty()) {
-                auto tmp = std::move(cur->data.front());
-                cur->data.pop_front();
-                return tmp;
-            }
-            cur = cur->next_nonempty;
+    T* pop_first_better(Priority priority) {
+        const u64 better_mask = nonempty_mask & ((u64{1} << priority) - 1);
+        if (better_mask == 0) {
+            return nullptr;
         }
-
-        return T();
+        return PopFront(static_cast<Priority>(LeastSignificantSetBit(better_mask)));
     }
 
-    void push_front(Priority priority, const T& thread_id) {
-        Queue* cur = &queues[priority];
-        cur->data.push_front(thread_id);
+    void push_front(Priority priority, T* element) {
+        Node* const node = ToNode(element);
+        ASSERT_MSG(!node->queued, "Element is already queued");
+        Queue& cur = queues[priority];
+
+        node->prev_in_queue = nullptr;
+        node->next_in_queue = cur.head;
+        node->queued = true;
+        if (cur.head != nullptr) {
+            ToNode(cur.head)->prev_in_queue = element;
+        } else {
+            cur.tail = element;
+        }
+        cur.head = element;
+        nonempty_mask |= u64{1} << priority;
     }
 
-    void push_back(Priority priority, const T& thread_id) {
-        Queue* cur = &queues[priority];
-        cur->data.push_back(thread_id);
+    void push_back(Priority priority, T* element) {
+        Node* const node = ToNode(element);
+        ASSERT_MSG(!node->queued, "Element is already queued");
+        Queue& cur = queues[priority];
+
+        node->prev_in_queue = cur.tail;
+        node->next_in_queue = nullptr;
+        node->queued = true;
+        if (cur.tail != nullptr) {
+            ToNode(cur.tail)->next_in_queue = element;
+        } else {
+            cur.head = element;
+        }
+        cur.tail = element;
+        nonempty_mask |= u64{1} << priority;
     }
 
-    void move(const T& thread_id, Priority old_priority, Priority new_priority) {
-        remove(old_priority, thread_id);
-        prepare(new_priority);
-        push_back(new_priority, thread_id);
+    void move(T* element, Priority old_priority, Priority new_priority) {
+        remove(old_priority, element);
+        push_back(new_priority, element);
     }
 
-    void remove(Priority priority, const T& thread_id) {
-        Queue* const cur = &queues[priority];
-        const auto iter = std::remove(cur->data.begin(), cur->data.end(), thread_id);
-        cur->data.erase(iter, cur->data.end());
+    /// Unlinks the element from the given level. Does nothing if the element isn't queued.
+    void remove(Priority priority, T* element) {
+        Node* const node = ToNode(element);
+        if (!node->queued) {
+            return;
+        }
+        Queue& cur = queues[priority];
+
+        if (node->prev_in_queue != nullptr) {
+            ToNode(node->prev_in_queue)->next_in_queue = node->next_in_queue;
+        } else {
+            ASSERT_MSG(cur.head == element, "Element is queued at a different priority");
+            cur.head = node->next_in_queue;
+        }
+        if (node->next_in_queue != nullptr) {
+            ToNode(node->next_in_queue)->prev_in_queue = node->prev_in_queue;
+        } else {
+            cur.tail = node->prev_in_queue;
+        }
+
+        node->prev_in_queue = nullptr;
+        node->next_in_queue = nullptr;
+        node->queued = false;
+        if (cur.head == nullptr) {
+            nonempty_mask &= ~(u64{1} << priority);
+        }
     }
 
     void rotate(Priority priority) {
-        Queue* cur = &queues[priority];
-
-        if (cur->data.size() > 1) {
-            cur->data.push_back(std::move(cur->data.front()));
-            cur->data.pop_front();
+        Queue& cur = queues[priority];
+        if (cur.head != nullptr && cur.head != cur.tail) {
+            push_back(priority, PopFront(priority));
         }
     }
 
     void clear() {
-        queues.fill(Queue());
-        first = nullptr;
+        for (Queue& cur : queues) {
+            while (cur.head != nullptr) {
+                Node* const node = ToNode(cur.head);
+                cur.head = node->next_in_queue;
+                node->prev_in_queue = nullptr;
+                node->next_in_queue = nullptr;
+                node->queued = false;
+            }
+            cur.tail = nullptr;
+        }
+        nonempty_mask = 0;
     }
 
     [[nodiscard]] bool empty(Priority priority) const {
-        const Queue* cur = &queues[priority];
-        return cur->data.empty();
-    }
-
-    void prepare(Priority priority) {
-        Queue* cur = &queues[priority];
-        if (cur->next_nonempty == UnlinkedTag())
-            link(priority);
+        return (nonempty_mask & (u64{1} << priority)) == 0;
     }
 
 private:
     struct Queue {
-        // Points to the next active priority, skipping over ones that have never been used.
-        Queue* next_nonempty = UnlinkedTag();
-        // Double-ended queue of threads in this priority level
-        std::deque<T> data;
+        T* head = nullptr;
+        T* tail = nullptr;
     };
 
-    /// Special tag used to mark priority levels that have never been used.
-    static Queue* UnlinkedTag() {
-        return reinterpret_cast<Queue*>(1);
+    static Node* ToNode(T* element) {
+        return static_cast<Node*>(element);
     }
 
-    void link(Priority priority) {
-        Queue* cur = &queues[priority];
-
-        for (int i = priority - 1; i >= 0; --i) {
-            if (queues[i].next_nonempty != UnlinkedTag()) {
-                cur->next_nonempty = queues[i].next_nonempty;
-                queues[i].next_nonempty = cur;
-                return;
-            }
-        }
-
-        cur->next_nonempty = first;
-        first = cur;
+    static const Node* ToNode(const T* element) {
+        return static_cast<const Node*>(element);
     }
 
-    // The first queue that's ever been used.
-    Queue* first;
-    // The priority level queues of thread ids.
-    std::array<Queue, NUM_QUEUES> queues;
-
-    s64 ToIndex(const Queue* q) const {
-        if (q == nullptr) {
-            return -2;
-        } else if (q == UnlinkedTag()) {
-            return -1;
-        } else {
-            return q - queues.data();
-        }
+    T* PopFront(Priority priority) {
+        T* const element = queues[priority].head;
+        remove(priority, element);
+        return element;
     }
 
-    Queue* ToPointer(s64 idx) {
-        if (idx == -1) {
-            return UnlinkedTag();
-        } else if (idx < 0) {
-            return nullptr;
-        } else {
-            return &queues[idx];
-        }
-    }
+    // Bit i is set when the level i queue is non-empty.
+    u64 nonempty_mask = 0;
+    // The priority level queues.
+    std::array<Queue, NUM_QUEUES> queues{};
 
     friend class boost::serialization::access;
     template <class Archive>
     void save(Archive& ar, const unsigned int file_version) const {
-        const s64 idx = ToIndex(first);
-        ar << idx;
-        for (std::size_t i = 0; i < NUM_QUEUES; i++) {
-            const s64 idx1 = ToIndex(queues[i].next_nonempty);
-            ar << idx1;
-            ar << queues[i].data;
+        ar << nonempty_mask;
+        for (Priority i = 0; i < NUM_QUEUES; ++i) {
+            if (empty(i)) {
+                continue;
+            }
+            u32 count = 0;
+            for (const T* cur = queues[i].head; cur != nullptr; cur = ToNode(cur)->next_in_queue) {
+                ++count;
+            }
+            ar << count;
+            for (T* cur = queues[i].head; cur != nullptr; cur = ToNode(cur)->next_in_queue) {
+                ar << cur;
+            }
         }
     }
 
     template <class Archive>
     void load(Archive& ar, const unsigned int file_version) {
-        s64 idx;
-        ar >> idx;
-        first = ToPointer(idx);
-        for (std::size_t i = 0; i < NUM_QUEUES; i++) {
-            ar >> idx;
-            queues[i].next_nonempty = ToPointer(idx);
-            ar >> queues[i].data;
+        clear();
+        if (file_version == 0) {
+            LoadLegacy(ar);
+            return;
+        }
+
+        u64 mask;
+        ar >> mask;
+        for (Priority i = 0; i < NUM_QUEUES; ++i) {
+            if ((mask & (u64{1} << i)) == 0) {
+                continue;
+            }
+            u32 count;
+            ar >> count;
+            for (u32 j = 0; j < count; ++j) {
+                T* element;
+                ar >> element;
+                push_back(i, element);
+            }
+        }
+    }
+
+    /// Version 0 stored a deque of element pointers per level, preceded by links between the
+    /// non-empty levels that the bitmap made unnecessary.
+    template <class Archive>
+    void LoadLegacy(Archive& ar) {
+        s64 link;
+        ar >> link;
+        for (Priority i = 0; i < NUM_QUEUES; ++i) {
+            ar >> link;
+            std::deque<T*> elements;
+            ar >> elements;
+            for (T* element : elements) {
+                push_back(i, element);
+            }
         }
     }
 
@@ -209,3 +266,15 @@ private:
 };
 
 } // namespace Common
+
+namespace boost::serialization {
+
+// BOOST_CLASS_VERSION doesn't support class templates
+template <class T, unsigned int N>
+struct version<Common::ThreadQueueList<T, N>> {
+    using tag = mpl::integral_c_tag;
+    using type = mpl::int_<1>;
+    BOOST_STATIC_CONSTANT(int, value = version::type::value);
+};
+
+} // namespace boost::serialization
@@ -0,0 +1,96 @@
+// Copyright 2020 Citra Emulator Project
+// Licensed under GPLv2 or any later version
+// Refer to the license.txt file included.
+
+#pragma once
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include "common/thread.h"
+
+namespace Common {
+
+/**
+ * A fixed number of threads running queued tasks in submission order. Tasks still queued when
+ * the worker is destroyed are dropped; the ones already running are waited for.
+ */
+class ThreadWorker {
+public:
+    /**
+     * @param num_threads Number of threads to start, at least one.
+     * @param name Name given to the threads.
+     */
+    ThreadWorker(std::size_t num_threads, std::string name) : name(std::move(name)) {
+        num_threads = std::max<std::size_t>(num_threads, 1);
+        threads.reserve(num_threads);
+        for (std::size_t i = 0; i < num_threads; ++i) {
+            threads.emplace_back([this] { WorkerLoop(); });
+        }
+    }
+
+    ~ThreadWorker() {
+        {
+            std::lock_guard lock{mutex};
+            stop = true;
+            tasks.clear();
+        }
+        cv.notify_all();
+        for (auto& thread : threads) {
+            thread.join();
+        }
+    }
+
+    ThreadWorker(const ThreadWorker&) = delete;
+    ThreadWorker& operator=(const ThreadWorker&) = delete;
+
+    /// Queues a task. The future reports a broken promise if the task is dropped.
+    template <typename F>
+    std::future<std::invoke_result_t<F>> Submit(F&& func) {
+        using Result = std::invoke_result_t<F>;
+        auto task = std::make_shared<std::packaged_task<Result()>>(std::forward<F>(func));
+        std::future<Result> future = task->get_future();
+        {
+            std::lock_guard lock{mutex};
+            tasks.emplace_back([task] { (*task)(); });
+        }
+        cv.notify_one();
+        return future;
+    }
+
+private:
+    void WorkerLoop() {
+        SetCurrentThreadName(name.c_str());
+        std::unique_lock lock{mutex};
+        while (true) {
+            cv.wait(lock, [this] { return stop || !tasks.empty(); });
+            if (stop) {
+                return;
+            }
+            std::function<void()> task = std::move(tasks.front());
+            tasks.pop_front();
+            lock.unlock();
+            task();
+            lock.lock();
+        }
+    }
+
+    const std::string name;
+    std::mutex mutex;
+    std::condition_variable cv;
+    std::deque<std::function<void()>> tasks;
+    bool stop = false;
+    std::vector<std::thread> threads;
+};
+
+} // namespace Common
@@ -3,9 +3,13 @@
 // Refer to the license.txt file included.
 
 #include <algorithm>
+#include <cstring>
+#include <thread>
 #include <zstd.h>
 
 #include "common/assert.h"
+#include "common/file_util.h"
+#include "common/thread_worker.h"
 #include "common/zstd_compression.h"
 
 namespace Common::Compression {
@@ -48,4 +52,241 @@ std::vector<u8> DecompressDataZSTD(const std::vector<u8>& compressed) {
     return decompressed;
 }
 
+struct ZSTDDecompressStreamBuf::Impl {
+    explicit Impl(FileUtil::IOFile& file) : file(file) {}
+
+    ~Impl() {
+        ZSTD_freeDStream(stream);
+    }
+
+    FileUtil::IOFile& file;
+    ZSTD_DStream* stream = ZSTD_createDStream();
+    std::vector<u8> input = std::vector<u8>(ZSTD_DStreamInSize());
+    ZSTD_inBuffer in{input.data(), 0, 0};
+    bool failed = false;
+};
+
+ZSTDDecompressStreamBuf::ZSTDDecompressStreamBuf(FileUtil::IOFile& file)
+    : impl(std::make_unique<Impl>(file)), get_area(ZSTD_DStreamOutSize()) {
+    impl->failed = impl->stream == nullptr || ZSTD_isError(ZSTD_initDStream(impl->stream));
+    setg(get_area.data(), get_area.data(), get_area.data());
+}
+
+ZSTDDecompressStreamBuf::~ZSTDDecompressStreamBuf() = default;
+
+ZSTDDecompressStreamBuf::int_type ZSTDDecompressStreamBuf::underflow() {
+    if (gptr() == egptr()) {
+        const std::size_t size = Decompress(get_area.data(), get_area.size());
+        setg(get_area.data(), get_area.data(), get_area.data() + size);
+        if (size == 0) {
+            return traits_type::eof();
+        }
+    }
+    return traits_type::to_int_type(*gptr());
+}
+
+std::streamsize ZSTDDecompressStreamBuf::xsgetn(char_type* s, std::streamsize count) {
+    // Serve what was already decompressed, then decompress the rest directly to the destination
+    const std::size_t buffered =
+        std::min(static_cast<std::size_t>(egptr() - gptr()), static_cast<std::size_t>(count));
+    std::memcpy(s, gptr(), buffered);
+    gbump(static_cast<int>(buffered));
+
+    std::size_t total = buffered;
+    while (total < static_cast<std::size_t>(count)) {
+        const std::size_t remaining = static_cast<std::size_t>(count) - total;
+        if (remaining < get_area.size()) {
+            // Small reads go through the get area so that the rest of the output is kept.
+            if (traits_type::eq_int_type(underflow(), traits_type::eof())) {
+                break;
+            }
+            const std::size_t size =
+                std::min(static_cast<std::size_t>(egptr() - gptr()), remaining);
+            std::memcpy(s + total, gptr(), size);
+            gbump(static_cast<int>(size));
+            total += size;
+            continue;
+        }
+        const std::size_t size = Decompress(s + total, remaining);
+        if (size == 0) {
+            break;
+        }
+        total += size;
+    }
+    return static_cast<std::streamsize>(total);
+}
+
+std::size_t ZSTDDecompressStreamBuf::Decompress(char_type* data, std::size_t size) {
+    ZSTD_outBuffer out{data, size, 0};
+    while (!impl->failed) {
+        // This also flushes output held by the decoder when all the input was consumed.
+        if (ZSTD_isError(ZSTD_decompressStream(impl->stream, &out, &impl->in))) {
+            impl->failed = true;
+            break;
+        }
+        if (out.pos != 0) {
+            break;
+        }
+        if (impl->in.pos == impl->in.size) {
+            const std::size_t read = impl->file.ReadBytes(impl->input.data(), impl->input.size());
+            if (read == 0 || read > impl->input.size()) {
+                break;
+            }
+            impl->in = ZSTD_inBuffer{impl->input.data(), read, 0};
+        }
+    }
+    return out.pos;
+}
+
+/**
+ * Compresses a chunk like CompressDataZSTD, with a context kept by the calling thread so that
+ * worker threads don't set up a new one for every chunk.
+ */
+static std::vector<u8> CompressChunk(const u8* source, std::size_t source_size,
+                                     s32 compression_level) {
+    thread_local std::unique_ptr<ZSTD_CCtx, decltype(&ZSTD_freeCCtx)> context{ZSTD_createCCtx(),
+                                                                               ZSTD_freeCCtx};
+    if (!context) {
+        return {};
+    }
+    compression_level = std::clamp(compression_level, ZSTD_minCLevel(), ZSTD_maxCLevel());
+
+    std::vector<u8> compressed(ZSTD_compressBound(source_size));
+    const std::size_t compressed_size =
+        ZSTD_compressCCtx(context.get(), compressed.data(), compressed.size(), source, source_size,
+                          compression_level);
+    if (ZSTD_isError(compressed_size)) {
+        return {};
+    }
+    compressed.resize(compressed_size);
+    return compressed;
+}
+
+/// Returns how many chunks are compressed or decompressed at the same time.
+static std::size_t GetMaxChunksInFlight() {
+    return std::max(std::thread::hardware_concurrency(), 1U);
+}
+
+ZSTDChunkedCompressStreamBuf::ZSTDChunkedCompressStreamBuf(FileUtil::IOFile& file,
+                                                           std::size_t chunk_size,
+                                                           s32 compression_level)
+    : file(file), chunk_size(chunk_size), compression_level(compression_level),
+      max_chunks_in_flight(GetMaxChunksInFlight()), put_area(chunk_size),
+      workers(std::make_unique<ThreadWorker>(max_chunks_in_flight, "ZSTDCompress")) {
+    setp(put_area.data(), put_area.data() + put_area.size());
+}
+
+ZSTDChunkedCompressStreamBuf::~ZSTDChunkedCompressStreamBuf() = default;
+
+std::optional<std::vector<ZSTDChunk>> ZSTDChunkedCompressStreamBuf::Finish() {
+    if (pptr() != pbase()) {
+        SubmitChunk();
+    }
+    while (!chunks_in_flight.empty()) {
+        WriteOldestChunk();
+    }
+    if (failed) {
+        return std::nullopt;
+    }
+    return chunks;
+}
+
+ZSTDChunkedCompressStreamBuf::int_type ZSTDChunkedCompressStreamBuf::overflow(int_type ch) {
+    SubmitChunk();
+    if (failed) {
+        return traits_type::eof();
+    }
+    if (!traits_type::eq_int_type(ch, traits_type::eof())) {
+        *pptr() = traits_type::to_char_type(ch);
+        pbump(1);
+    }
+    return traits_type::not_eof(ch);
+}
+
+void ZSTDChunkedCompressStreamBuf::SubmitChunk() {
+    while (chunks_in_flight.size() >= max_chunks_in_flight) {
+        WriteOldestChunk();
+    }
+
+    put_area.resize(static_cast<std::size_t>(pptr() - pbase()));
+    const auto size = static_cast<u32>(put_area.size());
+    chunks_in_flight.emplace_back(
+        size, workers->Submit([data = std::move(put_area), level = compression_level] {
+            return CompressChunk(reinterpret_cast<const u8*>(data.data()), data.size(), level);
+        }));
+
+    put_area = std::vector<char_type>(chunk_size);
+    setp(put_area.data(), put_area.data() + put_area.size());
+}
+
+void ZSTDChunkedCompressStreamBuf::WriteOldestChunk() {
+    auto [size, future] = std::move(chunks_in_flight.front());
+    chunks_in_flight.pop_front();
+
+    const std::vector<u8> compressed = future.get();
+    if (failed) {
+        return;
+    }
+    const u64 offset = file.Tell();
+    if (compressed.empty() ||
+        file.WriteBytes(compressed.data(), compressed.size()) != compressed.size()) {
+        failed = true;
+        return;
+    }
+    chunks.push_back({offset, static_cast<u32>(compressed.size()), size});
+}
+
+ZSTDChunkedDecompressStreamBuf::ZSTDChunkedDecompressStreamBuf(FileUtil::IOFile& file,
+                                                               std::vector<ZSTDChunk> chunks)
+    : file(file), chunks(std::move(chunks)), max_chunks_in_flight(GetMaxChunksInFlight()),
+      workers(std::make_unique<ThreadWorker>(max_chunks_in_flight, "ZSTDDecompress")) {
+    setg(nullptr, nullptr, nullptr);
+    Prefetch();
+}
+
+ZSTDChunkedDecompressStreamBuf::~ZSTDChunkedDecompressStreamBuf() = default;
+
+ZSTDChunkedDecompressStreamBuf::int_type ZSTDChunkedDecompressStreamBuf::underflow() {
+    if (gptr() != egptr()) {
+        return traits_type::to_int_type(*gptr());
+    }
+    if (chunks_in_flight.empty()) {
+        return traits_type::eof();
+    }
+
+    current_chunk = chunks_in_flight.front().get();
+    chunks_in_flight.pop_front();
+    Prefetch();
+
+    if (current_chunk.empty()) {
+        // Either the chunk was empty or it failed to decompress, neither of which is expected
+        chunks_in_flight.clear();
+        return traits_type::eof();
+    }
+    char_type* const begin = reinterpret_cast<char_type*>(current_chunk.data());
+    setg(begin, begin, begin + current_chunk.size());
+    return traits_type::to_int_type(*gptr());
+}
+
+void ZSTDChunkedDecompressStreamBuf::Prefetch() {
+    while (chunks_in_flight.size() < max_chunks_in_flight && next_chunk < chunks.size()) {
+        const ZSTDChunk& chunk = chunks[next_chunk++];
+        std::vector<u8> compressed(chunk.compressed_size);
+        if (!file.Seek(static_cast<s64>(chunk.offset), SEEK_SET) ||
+            file.ReadBytes(compressed.data(), compressed.size()) != compressed.size()) {
+            // Stop at the failed chunk, the reader will see the stream end early
+            next_chunk = chunks.size();
+            return;
+        }
+        chunks_in_flight.push_back(
+            workers->Submit([compressed = std::move(compressed), size = chunk.size] {
+                std::vector<u8> decompressed = DecompressDataZSTD(compressed);
+                if (decompressed.size() != size) {
+                    return std::vector<u8>{};
+                }
+                return decompressed;
+            }));
+    }
+}
+
 } // namespace Common::Compression
@@ -4,10 +4,23 @@
 
 #pragma once
 
+#include <deque>
+#include <future>
+#include <memory>
+#include <optional>
+#include <streambuf>
 #include <vector>
 
 #include "common/common_types.h"
 
+namespace Common {
+class ThreadWorker;
+}
+
+namespace FileUtil {
+class IOFile;
+}
+
 namespace Common::Compression {
 
 /**
@@ -42,4 +55,114 @@ namespace Common::Compression {
  */
 [[nodiscard]] std::vector<u8> DecompressDataZSTD(const std::vector<u8>& compressed);
 
+/**
+ * Stream buffer that reads Zstandard compressed data from a file and decompresses it as it is
+ * consumed, so that neither the compressed nor the uncompressed data have to be held in memory as
+ * a whole.
+ */
+class ZSTDDecompressStreamBuf final : public std::streambuf {
+public:
+    /// @param file The file to read the compressed data from, starting at its current position.
+    explicit ZSTDDecompressStreamBuf(FileUtil::IOFile& file);
+
+    ~ZSTDDecompressStreamBuf() override;
+
+protected:
+    int_type underflow() override;
+    std::streamsize xsgetn(char_type* s, std::streamsize count) override;
+
+private:
+    /// Decompresses up to `size` bytes to `data`. Returns the amount written, 0 at end of stream.
+    std::size_t Decompress(char_type* data, std::size_t size);
+
+    struct Impl;
+    std::unique_ptr<Impl> impl;
+    std::vector<char_type> get_area;
+};
+
+/// Location of an independently compressed chunk of data in a file.
+struct ZSTDChunk {
+    u64 offset;          ///< Offset of the compressed data in the file
+    u32 compressed_size; ///< Size of the compressed data
+    u32 size;            ///< Size of the data once decompressed
+};
+
+/**
+ * Stream buffer that splits everything written to it into chunks of a fixed size, and compresses
+ * each of them as a separate Zstandard frame on a fixed set of worker threads. The chunks are
+ * written to a file one after the other, in order. As chunks are independent, they can later be
+ * decompressed in parallel or individually.
+ */
+class ZSTDChunkedCompressStreamBuf final : public std::streambuf {
+public:
+    /**
+     * @param file The file to write the compressed chunks to, starting at its current position.
+     * @param chunk_size The size of the chunks before compression.
+     * @param compression_level the used compression level. Should be between 1 and 22.
+     */
+    ZSTDChunkedCompressStreamBuf(FileUtil::IOFile& file, std::size_t chunk_size,
+                                 s32 compression_level);
+
+    ~ZSTDChunkedCompressStreamBuf() override;
+
+    /**
+     * Compresses the remaining data and waits for every chunk to be written. Must be called once
+     * everything was written.
+     * @return the location of every chunk in the file, or std::nullopt if compressing or writing
+     * failed at any point.
+     */
+    std::optional<std::vector<ZSTDChunk>> Finish();
+
+protected:
+    int_type overflow(int_type ch) override;
+
+private:
+    /// Starts compressing the contents of the put area, and gives it a new buffer.
+    void SubmitChunk();
+    /// Waits for the oldest chunk being compressed and writes it to the file.
+    void WriteOldestChunk();
+
+    FileUtil::IOFile& file;
+    const std::size_t chunk_size;
+    const s32 compression_level;
+    const std::size_t max_chunks_in_flight;
+
+    std::vector<char_type> put_area;
+    std::deque<std::pair<u32, std::future<std::vector<u8>>>> chunks_in_flight;
+    std::vector<ZSTDChunk> chunks;
+    bool failed = false;
+    std::unique_ptr<ThreadWorker> workers;
+};
+
+/**
+ * Stream buffer that reads data written by ZSTDChunkedCompressStreamBuf. Chunks are read from the
+ * file on the calling thread and decompressed ahead of time on a fixed set of worker threads.
+ */
+class ZSTDChunkedDecompressStreamBuf final : public std::streambuf {
+public:
+    /**
+     * @param file The file to read the compressed chunks from.
+     * @param chunks The chunks to read, in order.
+     */
+    ZSTDChunkedDecompressStreamBuf(FileUtil::IOFile& file, std::vector<ZSTDChunk> chunks);
+
+    ~ZSTDChunkedDecompressStreamBuf() override;
+
+protected:
+    int_type underflow() override;
+
+private:
+    /// Starts decompressing chunks until enough of them are in flight.
+    void Prefetch();
+
+    FileUtil::IOFile& file;
+    const std::vector<ZSTDChunk> chunks;
+    const std::size_t max_chunks_in_flight;
+    std::size_t next_chunk = 0;
+
+    std::deque<std::future<std::vector<u8>>> chunks_in_flight;
+    std::vector<u8> current_chunk;
+    std::unique_ptr<ThreadWorker> workers;
+};
+
 } // namespace Common::Compression
@@ -25,8 +25,10 @@
 #include "core/dumping/ffmpeg_backend.h"
 #endif
 #include "core/custom_tex_cache.h"
+#include "core/file_sys/disk_archive.h"
 #include "core/gdbstub/gdbstub.h"
 #include "core/global.h"
+#include "core/hle/call_profiler.h"
 #include "core/hle/kernel/client_port.h"
 #include "core/hle/kernel/kernel.h"
 #include "core/hle/kernel/process.h"
@@ -43,6 +45,7 @@
 #include "core/hw/lcd.h"
 #include "core/loader/loader.h"
 #include "core/movie.h"
+#include "core/rewind.h"
 #include "core/rpc/rpc_server.h"
 #include "core/settings.h"
 #include "network/network.h"
@@ -137,10 +140,44 @@ System::ResultStatus System::RunLoop(bool tight_loop) {
         frame_limiter.WaitOnce();
         return ResultStatus::Success;
     }
+    case Signal::Rewind: {
+        if (!rewind_buffer) {
+            return ResultStatus::Success;
+        }
+        try {
+            if (!rewind_buffer->Rewind(param)) {
+                LOG_WARNING(Core, "No rewind snapshot to restore");
+            }
+        } catch (const std::exception& e) {
+            LOG_ERROR(Core, "Error rewinding: {}", e.what());
+            status_details = e.what();
+            return ResultStatus::ErrorSavestate;
+        }
+        frame_limiter.WaitOnce();
+        return ResultStatus::Success;
+    }
+    case Signal::SeekMovie: {
+        try {
+            if (!Movie::GetInstance().SeekToFrame(param)) {
+                LOG_WARNING(Core, "No movie anchor to seek to frame {}", param);
+            }
+        } catch (const std::exception& e) {
+            LOG_ERROR(Core, "Error seeking movie: {}", e.what());
+            status_details = e.what();
+            return ResultStatus::ErrorSavestate;
+        }
+        frame_limiter.WaitOnce();
+        return ResultStatus::Success;
+    }
     default:
         break;
     }
 
+    if (rewind_buffer) {
+        rewind_buffer->Update();
+    }
+    Movie::GetInstance().Update();
+
     // All cores should have executed the same amount of ticks. If this is not the case an event was
     // scheduled with a cycles_into_future smaller then the current downcount.
     // So we have to get those cores to the same global time first
@@ -309,6 +346,14 @@ System::ResultStatus System::Load(Frontend::EmuWindow& emu_window, const std::st
                   static_cast<u32>(load_result));
     }
     perf_stats = std::make_unique<PerfStats>(title_id);
+    call_profiler = std::make_unique<HLE::CallProfiler>(title_id);
+    // A new boot never rewinds into the previous one
+    rewind_buffer.reset();
+    if (Settings::values.enable_rewind) {
+        rewind_buffer = std::make_unique<RewindBuffer>(
+            *this, Settings::values.rewind_interval_frames,
+            static_cast<std::size_t>(Settings::values.rewind_buffer_size_mb) * 1024 * 1024);
+    }
     custom_tex_cache = std::make_unique<Core::CustomTexCache>();
 
     if (Settings::values.custom_textures) {
@@ -527,12 +572,18 @@ void System::Shutdown(bool is_deserializing) {
     telemetry_session->AddField(performance, "Shutdown_Frametime", perf_results.frametime * 1000.0);
     telemetry_session->AddField(performance, "Mean_Frametime_MS", perf_stats->GetMeanFrametime());
 
+    // Write back buffered save data before the services are torn down
+    FileSys::DiskFile::WriteBackAll();
+
     // Shutdown emulation session
     VideoCore::Shutdown();
     HW::Shutdown();
     if (!is_deserializing) {
         GDBStub::Shutdown();
         perf_stats.reset();
+        call_profiler.reset();
+        rewind_buffer.reset();
+        snapshot_base.reset();
         cheat_engine.reset();
         app_loader.reset();
     }
@@ -598,11 +649,19 @@ void System::serialize(Archive& ar, const unsigned int file_version) {
         auto system_mode = this->app_loader->LoadKernelSystemMode();
         auto n3ds_mode = this->app_loader->LoadKernelN3dsMode();
         Init(*m_emu_window, *system_mode.first, *n3ds_mode.first, num_cores);
+        // The memory was recreated, so it needs the base to load incremental savestates
+        memory->SetSnapshotBase(snapshot_base.get());
     }
 
-    // flush on save, don't flush on load
-    bool should_flush = !Archive::is_loading::value;
-    Memory::RasterizerClearAll(should_flush);
+    if (Archive::is_saving::value && saving_incremental_state) {
+        // Rewind snapshots are taken during play, evicting the whole cache every time would
+        // stutter. The memory only needs to contain what the rasterizer cached.
+        Memory::RasterizerFlushAll();
+    } else {
+        // flush on save, don't flush on load
+        bool should_flush = !Archive::is_loading::value;
+        Memory::RasterizerClearAll(should_flush);
+    }
     ar&* timing.get();
     for (u32 i = 0; i < num_cores; i++) {
         ar&* cpu_cores[i].get();
@@ -632,6 +691,7 @@ void System::serialize(Archive& ar, const unsigned int file_version) {
     if (Archive::is_loading::value) {
         Service::GSP::SetGlobalModule(*this);
         memory->SetDSP(*dsp_core);
+        memory->SetSnapshotBase(nullptr);
         cheat_engine->Connect();
         VideoCore::g_renderer->Sync();
     }
@@ -53,6 +53,10 @@ namespace Cheats {
 class CheatEngine;
 }
 
+namespace HLE {
+class CallProfiler;
+}
+
 namespace VideoDumper {
 class Backend;
 }
@@ -61,12 +65,15 @@ class RendererBase;
 
 namespace Core {
 
+class RewindBuffer;
 class Timing;
 
 class System {
 public:
     /**
-     * Gets the instance of the System singleton class.
+     * Gets the instance of the System singleton class. Only one System may run at a time, as parts
+     * of the emulated console state, such as the renderer, the GPU and HW registers and the movie,
+     * are process-wide.
      * @returns Reference to the instance of the System singleton class.
      */
     [[nodiscard]] static System& GetInstance() {
@@ -120,7 +127,7 @@ public:
     /// Shutdown and then load again
     void Reset();
 
-    enum class Signal : u32 { None, Shutdown, Reset, Save, Load };
+    enum class Signal : u32 { None, Shutdown, Reset, Save, Load, Rewind, SeekMovie };
 
     bool SendSignal(Signal signal, u32 param = 0);
 
@@ -261,6 +268,27 @@ public:
     /// Gets a const reference to the video dumper backend
     [[nodiscard]] const VideoDumper::Backend& VideoDumper() const;
 
+    /**
+     * Gets the HLE call profiler of the running application.
+     * @returns A pointer to the profiler, or nullptr if no application is running.
+     */
+    [[nodiscard]] HLE::CallProfiler* GetCallProfiler() const {
+        return call_profiler.get();
+    }
+
+    /// Gets the RPC server, or nullptr if the system isn't running.
+    [[nodiscard]] RPC::RPCServer* GetRPCServer() const {
+        return rpc_server.get();
+    }
+
+    /**
+     * Gets the rewind buffer of the running application.
+     * @returns A pointer to the buffer, or nullptr if rewind is disabled or nothing is running.
+     */
+    [[nodiscard]] RewindBuffer* GetRewindBuffer() const {
+        return rewind_buffer.get();
+    }
+
     std::unique_ptr<PerfStats> perf_stats;
     FrameLimiter frame_limiter;
 
@@ -305,6 +333,36 @@ public:
 
     void LoadState(u32 slot);
 
+    /**
+     * Takes a copy of the emulated RAM that following incremental savestates are relative to.
+     * Replaces any previous base, which invalidates the incremental states made against it.
+     */
+    void CreateSnapshotBase();
+
+    /// Returns the base of incremental savestates, or nullptr if there is none.
+    [[nodiscard]] std::shared_ptr<const Memory::SnapshotBase> GetSnapshotBase() const {
+        return snapshot_base;
+    }
+
+    /// Makes a base returned by GetSnapshotBase current again, to load states made against it.
+    void SetSnapshotBase(std::shared_ptr<const Memory::SnapshotBase> base) {
+        snapshot_base = std::move(base);
+    }
+
+    /// Returns an id for a snapshot base that isn't used by any other base.
+    [[nodiscard]] u64 NewSnapshotBaseId() {
+        return next_snapshot_base_id++;
+    }
+
+    /**
+     * Serializes the emulated state into a buffer, only storing the memory pages that changed
+     * since the snapshot base was taken. The buffer is not compressed.
+     */
+    [[nodiscard]] std::vector<u8> SaveIncrementalState() const;
+
+    /// Restores a state created by SaveIncrementalState against the current snapshot base.
+    void LoadIncrementalState(const std::vector<u8>& state);
+
 private:
     /**
      * Initialize the emulated system.
@@ -351,6 +409,12 @@ private:
     /// Custom texture cache system
     std::unique_ptr<Core::CustomTexCache> custom_tex_cache;
 
+    /// HLE service function and SVC call statistics
+    std::unique_ptr<HLE::CallProfiler> call_profiler;
+
+    /// In-memory snapshots used to rewind emulation
+    std::unique_ptr<RewindBuffer> rewind_buffer;
+
     /// Image interface
     std::shared_ptr<Frontend::ImageInterface> registered_image_interface;
 
@@ -363,6 +427,12 @@ private:
     std::unique_ptr<Kernel::KernelSystem> kernel;
     std::unique_ptr<Timing> timing;
 
+    /// Base of incremental savestates. Kept when a savestate is loaded.
+    std::shared_ptr<const Memory::SnapshotBase> snapshot_base;
+    /// Whether SaveIncrementalState is serializing, so the rasterizer cache is only flushed
+    mutable bool saving_incremental_state = false;
+    u64 next_snapshot_base_id = 1;
+
 private:
     static System s_instance;
 
@@ -3,14 +3,22 @@
 // Refer to the license.txt file included.
 
 #include <algorithm>
+#include <condition_variable>
 #include <cstdio>
+#include <cstring>
+#include <iterator>
 #include <memory>
+#include <thread>
+#include <unordered_set>
+#include <utility>
 #include "common/archives.h"
 #include "common/common_types.h"
 #include "common/file_util.h"
 #include "common/logging/log.h"
+#include "common/thread.h"
 #include "core/file_sys/disk_archive.h"
 #include "core/file_sys/errors.h"
+#include "core/settings.h"
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 // FileSys namespace
@@ -20,11 +28,90 @@ SERIALIZE_EXPORT_IMPL(FileSys::DiskDirectory)
 
 namespace FileSys {
 
+/// Writes larger than this are not buffered, and adjacent writes are coalesced up to this size
+constexpr std::size_t MaxWriteBackSize = 1024 * 1024;
+/// Maximum time buffered writes and deferred flushes may wait before being written back
+constexpr auto WriteBackTimeout = std::chrono::milliseconds(500);
+
+/// Background thread writing back the files whose write-back timeout expired. The thread only
+/// runs while there are dirty files.
+class WriteBackFlusher {
+public:
+    static WriteBackFlusher& Get() {
+        // Never destroyed, as files can be destroyed after function-local statics at exit
+        static auto* flusher = new WriteBackFlusher;
+        return *flusher;
+    }
+
+    void Register(const DiskFile* file) {
+        std::lock_guard lock{mutex};
+        files.insert(file);
+        if (!running) {
+            if (thread.joinable()) {
+                thread.join(); // It already returned, or is about to
+            }
+            running = true;
+            thread = std::thread(&WriteBackFlusher::Run, this);
+        }
+    }
+
+    void Unregister(const DiskFile* file) {
+        std::lock_guard lock{mutex};
+        files.erase(file);
+    }
+
+    void WriteBackAll() {
+        std::lock_guard lock{mutex};
+        for (const DiskFile* file : files) {
+            std::lock_guard file_lock{file->write_back.mutex};
+            file->WriteBack();
+            file->write_back.dirty_since = {};
+        }
+        files.clear();
+        // Let the thread see there is nothing left to do
+        cv.notify_all();
+    }
+
+private:
+    void Run() {
+        Common::SetCurrentThreadName("SaveWriteBack");
+        std::unique_lock lock{mutex};
+        while (!files.empty()) {
+            cv.wait_for(lock, WriteBackTimeout / 2);
+            const auto now = DiskFile::Clock::now();
+            for (auto itr = files.begin(); itr != files.end();) {
+                itr = (*itr)->WriteBackIfExpired(now) ? files.erase(itr) : std::next(itr);
+            }
+        }
+        running = false;
+    }
+
+    std::mutex mutex;
+    std::condition_variable cv;
+    std::unordered_set<const DiskFile*> files;
+    std::thread thread;
+    bool running = false;
+};
+
+DiskFile::~DiskFile() {
+    WriteBackFlusher::Get().Unregister(this);
+    std::lock_guard lock{write_back.mutex};
+    if (file && file->IsOpen()) {
+        WriteBack();
+    }
+}
+
 ResultVal<std::size_t> DiskFile::Read(const u64 offset, const std::size_t length,
                                       u8* buffer) const {
     if (!mode.read_flag)
         return ERROR_INVALID_OPEN_FLAGS;
 
+    std::lock_guard lock{write_back.mutex};
+    WriteBackData();
+    if (TakeWriteBackError()) {
+        // The buffered writes were lost, the data read would be stale
+        return ResultCode(-1); // TODO: Find the error code of a failed media access
+    }
     file->Seek(offset, SEEK_SET);
     return MakeResult<std::size_t>(file->ReadBytes(buffer, length));
 }
@@ -34,25 +121,139 @@ ResultVal<std::size_t> DiskFile::Write(const u64 offset, const std::size_t lengt
     if (!mode.write_flag)
         return ERROR_INVALID_OPEN_FLAGS;
 
-    file->Seek(offset, SEEK_SET);
-    std::size_t written = file->WriteBytes(buffer, length);
-    if (flush)
-        file->Flush();
-    return MakeResult<std::size_t>(written);
+    bool became_dirty = false;
+    {
+        std::lock_guard lock{write_back.mutex};
+        // Buffered writes were reported as successful, so their errors are returned now
+        if (TakeWriteBackError()) {
+            return ERROR_INSUFFICIENT_SPACE;
+        }
+        write_back.write_end = std::max<u64>(write_back.write_end, offset + length);
+        if (!Settings::values.use_save_write_back || length >= MaxWriteBackSize ||
+            write_back.write_through) {
+            WriteBackData();
+            if (TakeWriteBackError()) {
+                return ERROR_INSUFFICIENT_SPACE;
+            }
+            file->Seek(offset, SEEK_SET);
+            std::size_t written = file->WriteBytes(buffer, length);
+            if (flush || write_back.flush_pending) {
+                file->Flush();
+                write_back.flush_pending = false;
+            }
+            return MakeResult<std::size_t>(written);
+        }
+
+        // Only writes extending or overlapping the buffered ones can be coalesced with them
+        const u64 buffer_end = write_back.offset + write_back.data.size();
+        if (write_back.data.empty() || offset < write_back.offset || offset > buffer_end ||
+            offset + length - write_back.offset > MaxWriteBackSize) {
+            WriteBackData();
+            if (TakeWriteBackError()) {
+                return ERROR_INSUFFICIENT_SPACE;
+            }
+            write_back.offset = offset;
+        }
+        const std::size_t buffer_offset = static_cast<std::size_t>(offset - write_back.offset);
+        write_back.data.resize(std::max(write_back.data.size(), buffer_offset + length));
+        std::memcpy(write_back.data.data() + buffer_offset, buffer, length);
+        write_back.flush_pending |= flush;
+        became_dirty = MarkDirty();
+    }
+
+    if (became_dirty) {
+        WriteBackFlusher::Get().Register(this);
+    }
+    return MakeResult<std::size_t>(length);
 }
 
 u64 DiskFile::GetSize() const {
-    return file->GetSize();
+    std::lock_guard lock{write_back.mutex};
+    return std::max(file->GetSize(), write_back.write_end);
 }
 
 bool DiskFile::SetSize(const u64 size) const {
+    std::lock_guard lock{write_back.mutex};
+    WriteBackData();
+    const bool success = !TakeWriteBackError();
     file->Resize(size);
     file->Flush();
-    return true;
+    write_back.flush_pending = false;
+    write_back.write_end = size;
+    return success;
 }
 
 bool DiskFile::Close() const {
-    return file->Close();
+    std::lock_guard lock{write_back.mutex};
+    WriteBack();
+    const bool success = !TakeWriteBackError();
+    return file->Close() && success;
+}
+
+void DiskFile::Flush() const {
+    {
+        std::lock_guard lock{write_back.mutex};
+        if (!Settings::values.use_save_write_back) {
+            WriteBackData();
+            file->Flush();
+            write_back.flush_pending = false;
+            return;
+        }
+        write_back.flush_pending = true;
+        if (!MarkDirty()) {
+            return;
+        }
+    }
+    WriteBackFlusher::Get().Register(this);
+}
+
+void DiskFile::WriteBackAll() {
+    WriteBackFlusher::Get().WriteBackAll();
+}
+
+void DiskFile::WriteBackData() const {
+    if (write_back.data.empty()) {
+        return;
+    }
+    file->Seek(write_back.offset, SEEK_SET);
+    if (file->WriteBytes(write_back.data.data(), write_back.data.size()) !=
+        write_back.data.size()) {
+        LOG_ERROR(Service_FS, "Could not write back {} bytes to {}", write_back.data.size(),
+                  file->GetFilename());
+        write_back.error_pending = true;
+        write_back.write_through = true;
+    }
+    write_back.data.clear();
+}
+
+void DiskFile::WriteBack() const {
+    WriteBackData();
+    if (write_back.flush_pending) {
+        file->Flush();
+        write_back.flush_pending = false;
+    }
+}
+
+bool DiskFile::MarkDirty() const {
+    if (write_back.dirty_since != Clock::time_point{}) {
+        return false;
+    }
+    write_back.dirty_since = Clock::now();
+    return true;
+}
+
+bool DiskFile::TakeWriteBackError() const {
+    return std::exchange(write_back.error_pending, false);
+}
+
+bool DiskFile::WriteBackIfExpired(Clock::time_point now) const {
+    std::lock_guard lock{write_back.mutex};
+    if (write_back.IsDirty() && now - write_back.dirty_since < WriteBackTimeout) {
+        return false;
+    }
+    WriteBack();
+    write_back.dirty_since = {};
+    return true;
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -4,8 +4,10 @@
 
 #pragma once
 
+#include <chrono>
 #include <cstddef>
 #include <memory>
+#include <mutex>
 #include <string>
 #include <vector>
 #include <boost/serialization/base_object.hpp>
@@ -31,6 +33,7 @@ public:
         delay_generator = std::move(delay_generator_);
         mode.hex = mode_.hex;
     }
+    ~DiskFile() override;
 
     ResultVal<std::size_t> Read(u64 offset, std::size_t length, u8* buffer) const override;
     ResultVal<std::size_t> Write(u64 offset, std::size_t length, bool flush,
@@ -38,20 +41,66 @@ public:
     u64 GetSize() const override;
     bool SetSize(u64 size) const override;
     bool Close() const override;
+    void Flush() const override;
 
-    void Flush() const override {
-        file->Flush();
-    }
+    /// Writes back the buffered writes and deferred flushes of every open file.
+    static void WriteBackAll();
 
 protected:
     Mode mode;
     std::unique_ptr<FileUtil::IOFile> file;
 
 private:
+    friend class WriteBackFlusher;
+    using Clock = std::chrono::steady_clock;
+
+    /**
+     * Small writes are coalesced in memory and host flushes are deferred when save write-back is
+     * enabled, until the file is closed, read or the write-back timeout expires.
+     */
+    struct WriteBackState {
+        std::mutex mutex;
+        /// Adjacent writes waiting to be written to the host file, starting at offset
+        u64 offset = 0;
+        std::vector<u8> data;
+        /// Whether the guest asked for a flush since the last host flush
+        bool flush_pending = false;
+        /// When the file started having buffered writes or a pending flush
+        Clock::time_point dirty_since;
+        /// End of the furthest write, as the host file size doesn't include unflushed data
+        u64 write_end = 0;
+        /// Set when writing back to the host file failed, until the error is returned to the guest
+        bool error_pending = false;
+        /// Set once writing back failed, so that the errors of later writes are returned directly
+        bool write_through = false;
+
+        bool IsDirty() const {
+            return !data.empty() || flush_pending;
+        }
+    };
+
     DiskFile() = default;
 
+    /// Writes the buffered writes to the host file. write_back.mutex must be held.
+    void WriteBackData() const;
+    /// Writes back everything, including deferred flushes. write_back.mutex must be held.
+    void WriteBack() const;
+    /// Marks the file dirty. Returns whether it was clean. write_back.mutex must be held.
+    bool MarkDirty() const;
+    /// Returns whether writing back failed since the last call. write_back.mutex must be held.
+    bool TakeWriteBackError() const;
+    /// Writes back the file if it has been dirty for too long. Returns whether it's clean.
+    bool WriteBackIfExpired(Clock::time_point now) const;
+
+    mutable WriteBackState write_back;
+
     template <class Archive>
     void serialize(Archive& ar, const unsigned int) {
+        if (Archive::is_saving::value) {
+            // The host file is not part of the state, so it must be up-to-date
+            std::lock_guard lock{write_back.mutex};
+            WriteBack();
+        }
         ar& boost::serialization::base_object<FileBackend>(*this);
         ar& mode.hex;
         ar& file;
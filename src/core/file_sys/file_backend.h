@@ -31,6 +31,17 @@ public:
      */
     virtual ResultVal<std::size_t> Read(u64 offset, std::size_t length, u8* buffer) const = 0;
 
+    /**
+     * Get a pointer to data of the file that can be read in place, avoiding the copy to an
+     * intermediate buffer made by Read. The pointer stays valid for the lifetime of the backend.
+     * @param offset Offset in bytes of the data
+     * @param length Length in bytes of the data
+     * @return Pointer to the data, or nullptr if it must be read with Read
+     */
+    virtual const u8* GetDataPointer(u64 offset, std::size_t length) const {
+        return nullptr;
+    }
+
     /**
      * Write data to the file
      * @param offset Offset in bytes to start writing data to
@@ -4,11 +4,14 @@
 
 #include <algorithm>
 #include <cstring>
+#include <fmt/format.h>
 #include "common/alignment.h"
 #include "common/archives.h"
 #include "common/assert.h"
+#include "common/common_funcs.h"
 #include "common/common_paths.h"
 #include "common/file_util.h"
+#include "common/hash.h"
 #include "common/string_util.h"
 #include "common/swap.h"
 #include "core/file_sys/layered_fs.h"
@@ -68,6 +71,16 @@ void LayeredFS::Load() {
 
     ASSERT_MSG(header.header_length == sizeof(header), "Header size is incorrect");
 
+    // Dumping needs the directory tree, which is not cached
+    u64 cache_key{};
+    if (load_relocations) {
+        cache_key = GetCacheKey();
+        if (LoadCache(cache_key)) {
+            LOG_INFO(Service_FS, "LayeredFS loaded from cache");
+            return;
+        }
+    }
+
     // TODO: is root always the first directory in table?
     root.parent = &root;
     LoadDirectory(root, 0);
@@ -78,6 +91,10 @@ void LayeredFS::Load() {
     }
 
     RebuildMetadata();
+
+    if (load_relocations) {
+        SaveCache(cache_key);
+    }
 }
 
 LayeredFS::~LayeredFS() = default;
@@ -483,6 +500,238 @@ void LayeredFS::RebuildMetadata() {
                 header.file_metadata_table.length);
 }
 
+constexpr u32 CacheMagic = 0x43534C46; // "FLSC"
+constexpr u32 CacheVersion = 2;
+
+struct CacheHeader {
+    u32_le magic;
+    u32_le version;
+    u64_le key;
+    u64_le metadata_size;
+    u64_le data_size;
+    u64_le file_count;
+};
+static_assert(sizeof(CacheHeader) == 0x28, "Size of CacheHeader is not correct");
+
+struct CacheFileEntry {
+    u64_le data_offset;
+    u64_le original_offset;
+    u64_le size;
+    u32_le type;
+    u32_le path_length;
+    u32_le replace_file_path_length;
+    INSERT_PADDING_WORDS(1);
+};
+static_assert(sizeof(CacheFileEntry) == 0x28, "Size of CacheFileEntry is not correct");
+
+/// Returns the manifest line identifying a version of a file: its path, size and modification time
+static std::string GetManifestLine(const std::string& path, u64 size) {
+    return fmt::format("{}|{}|{}", path, size, FileUtil::GetModificationTime(path));
+}
+
+/// Adds the path, size and modification time of every file under the directory to the manifest.
+static void AddToManifest(const FileUtil::FSTEntry& entry, std::vector<std::string>& manifest) {
+    for (const auto& child : entry.children) {
+        if (child.isDirectory) {
+            AddToManifest(child, manifest);
+        } else {
+            manifest.push_back(GetManifestLine(child.physicalName, child.size));
+        }
+    }
+}
+
+u64 LayeredFS::GetCacheKey() const {
+    // The base RomFS is identified by its metadata, which covers every file name, offset and size
+    std::vector<u8> base_metadata(header.file_data_offset);
+    romfs->ReadFile(0, base_metadata.size(), base_metadata.data());
+    u64 key = Common::ComputeHash64(base_metadata.data(), base_metadata.size()) ^ romfs->GetSize();
+
+    // The metadata doesn't cover the contents of the base files, which patched files are built from
+    std::vector<std::string> manifest;
+    const std::string base_path = romfs->GetFilePath();
+    if (!base_path.empty()) {
+        manifest.push_back(GetManifestLine(base_path, FileUtil::GetSize(base_path)));
+    }
+    for (std::string path : {patch_path, patch_ext_path}) {
+        // ScanDirectoryTree expects a path without trailing '/'
+        while (!path.empty() && (path.back() == '/' || path.back() == '\\')) {
+            path.pop_back();
+        }
+        if (FileUtil::IsDirectory(path)) {
+            FileUtil::FSTEntry entry;
+            FileUtil::ScanDirectoryTree(path, entry, 256);
+            AddToManifest(entry, manifest);
+        }
+    }
+    // Directory enumeration order is not guaranteed to be stable
+    std::sort(manifest.begin(), manifest.end());
+    const std::string joined = fmt::format("{}", fmt::join(manifest, "\n"));
+    return Common::CityHash64WithSeed(joined.data(), joined.size(), key);
+}
+
+std::string LayeredFS::GetCachePath() const {
+    const u64 path_hash = Common::ComputeHash64(patch_path.data(), patch_path.size());
+    return fmt::format("{}layered_fs/{:016X}.bin",
+                       FileUtil::GetUserPath(FileUtil::UserPath::CacheDir), path_hash);
+}
+
+/**
+ * Checks that the sizes and offsets of a cached file are consistent with the cache and the base
+ * RomFS.
+ * @param data_size Size of the file data of the rebuilt RomFS
+ * @param remaining_size Size of the cache following the entry
+ * @param romfs_size Size of the base RomFS
+ */
+static bool IsValidCacheEntry(const CacheFileEntry& entry, u64 data_size, u64 remaining_size,
+                              u64 romfs_size) {
+    if (entry.data_offset > data_size || entry.size > data_size - entry.data_offset) {
+        return false;
+    }
+    const u64 stored_size = static_cast<u64>(entry.path_length) + entry.replace_file_path_length +
+                            (entry.type == 2 ? entry.size : 0);
+    if (stored_size > remaining_size) {
+        return false;
+    }
+    switch (entry.type) {
+    case 0: // The file is read from the base RomFS
+        return entry.original_offset <= romfs_size &&
+               entry.size <= romfs_size - entry.original_offset;
+    case 1: // The file is read from a replacement file
+        return entry.replace_file_path_length != 0;
+    case 2: // The patched file is stored in the cache
+        return true;
+    default: // Removed files have no data
+        return false;
+    }
+}
+
+bool LayeredFS::LoadCache(u64 key) {
+    FileUtil::IOFile file(GetCachePath(), "rb");
+    if (!file.IsOpen()) {
+        return false;
+    }
+
+    CacheHeader cache_header;
+    if (file.ReadBytes(&cache_header, sizeof(cache_header)) != sizeof(cache_header) ||
+        cache_header.magic != CacheMagic || cache_header.version != CacheVersion ||
+        cache_header.key != key) {
+        LOG_INFO(Service_FS, "LayeredFS cache is outdated, rebuilding");
+        return false;
+    }
+
+    // The sizes are checked before allocating anything, so a corrupted cache can't exhaust memory
+    const u64 cache_size = file.GetSize();
+    if (cache_header.metadata_size > cache_size ||
+        cache_header.file_count > cache_size / sizeof(CacheFileEntry)) {
+        LOG_WARNING(Service_FS, "LayeredFS cache is corrupted, rebuilding");
+        return false;
+    }
+
+    std::vector<u8> cached_metadata(cache_header.metadata_size);
+    if (file.ReadBytes(cached_metadata.data(), cached_metadata.size()) !=
+        cached_metadata.size()) {
+        return false;
+    }
+
+    std::vector<std::unique_ptr<File>> files;
+    std::map<u64, File*> offset_map;
+    for (u64 i = 0; i < cache_header.file_count; ++i) {
+        CacheFileEntry entry;
+        if (file.ReadBytes(&entry, sizeof(entry)) != sizeof(entry)) {
+            return false;
+        }
+
+        if (!IsValidCacheEntry(entry, cache_header.data_size, cache_size - file.Tell(),
+                               romfs->GetSize())) {
+            LOG_WARNING(Service_FS, "LayeredFS cache entry {} is invalid, rebuilding", i);
+            return false;
+        }
+
+        auto cached_file = std::make_unique<File>();
+        cached_file->parent = nullptr;
+        cached_file->path.resize(entry.path_length);
+        cached_file->relocation.type = static_cast<int>(entry.type);
+        cached_file->relocation.original_offset = entry.original_offset;
+        cached_file->relocation.size = entry.size;
+        cached_file->relocation.replace_file_path.resize(entry.replace_file_path_length);
+        if (entry.type == 2) {
+            cached_file->relocation.patched_file.resize(entry.size);
+        }
+
+        auto& relocation = cached_file->relocation;
+        if (file.ReadBytes(cached_file->path.data(), cached_file->path.size()) !=
+                cached_file->path.size() ||
+            file.ReadBytes(relocation.replace_file_path.data(),
+                           relocation.replace_file_path.size()) !=
+                relocation.replace_file_path.size() ||
+            file.ReadBytes(relocation.patched_file.data(), relocation.patched_file.size()) !=
+                relocation.patched_file.size()) {
+            return false;
+        }
+
+        // Replacement files may have changed size without the directory listing changing
+        if (entry.type == 1 && FileUtil::GetSize(relocation.replace_file_path) != entry.size) {
+            LOG_INFO(Service_FS, "LayeredFS replacement file {} changed, rebuilding",
+                     relocation.replace_file_path);
+            return false;
+        }
+
+        offset_map.emplace(entry.data_offset, cached_file.get());
+        files.push_back(std::move(cached_file));
+    }
+
+    metadata = std::move(cached_metadata);
+    cached_files = std::move(files);
+    data_offset_map = std::move(offset_map);
+    current_data_offset = cache_header.data_size;
+    return true;
+}
+
+void LayeredFS::SaveCache(u64 key) const {
+    const std::string path = GetCachePath();
+    if (!FileUtil::CreateFullPath(path)) {
+        LOG_ERROR(Service_FS, "Could not create LayeredFS cache path {}", path);
+        return;
+    }
+
+    FileUtil::IOFile file(path, "wb");
+    if (!file.IsOpen()) {
+        LOG_ERROR(Service_FS, "Could not open LayeredFS cache {}", path);
+        return;
+    }
+
+    CacheHeader cache_header{};
+    cache_header.magic = CacheMagic;
+    cache_header.version = CacheVersion;
+    cache_header.key = key;
+    cache_header.metadata_size = metadata.size();
+    cache_header.data_size = current_data_offset;
+    cache_header.file_count = data_offset_map.size();
+    file.WriteObject(cache_header);
+    file.WriteBytes(metadata.data(), metadata.size());
+
+    for (const auto& [data_offset, cached_file] : data_offset_map) {
+        const auto& relocation = cached_file->relocation;
+        CacheFileEntry entry{};
+        entry.data_offset = data_offset;
+        entry.original_offset = relocation.original_offset;
+        entry.size = relocation.size;
+        entry.type = static_cast<u32>(relocation.type);
+        entry.path_length = static_cast<u32>(cached_file->path.size());
+        entry.replace_file_path_length = static_cast<u32>(relocation.replace_file_path.size());
+        file.WriteObject(entry);
+        file.WriteString(cached_file->path);
+        file.WriteString(relocation.replace_file_path);
+        file.WriteBytes(relocation.patched_file.data(), relocation.patched_file.size());
+    }
+
+    if (!file.IsGood()) {
+        LOG_ERROR(Service_FS, "Could not write LayeredFS cache {}", path);
+        file.Close();
+        FileUtil::Delete(path);
+    }
+}
+
 std::size_t LayeredFS::GetSize() const {
     return metadata.size() + current_data_offset;
 }
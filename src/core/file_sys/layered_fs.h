@@ -41,6 +41,10 @@ static_assert(sizeof(RomFSHeader) == 0x28, "Size of RomFSHeader is not correct")
  * patch_ext_path: Path for RomFS extensions. Files present in this path:
  *  - When with an extension of ".stub", remove the corresponding file in the RomFS.
  *  - When with an extension of ".ips" or ".bps", patch the file in the RomFS.
+ *
+ * The rebuilt metadata and data layout are cached on disk, keyed on the base RomFS metadata and
+ * the paths, sizes and modification times of the ROM file and the mod files, so that the tree only
+ * has to be rebuilt when any of them changes.
  */
 class LayeredFS : public RomFSReader {
 public:
@@ -98,6 +102,17 @@ private:
 
     void RebuildMetadata();
 
+    // Returns the key identifying the base RomFS and the mod files, used to validate the cache
+    u64 GetCacheKey() const;
+
+    std::string GetCachePath() const;
+
+    // Loads the rebuilt metadata and data layout from the cache. Returns false if the cache is
+    // missing or outdated, in which case nothing is changed.
+    bool LoadCache(u64 key);
+
+    void SaveCache(u64 key) const;
+
     void Load();
 
     std::shared_ptr<RomFSReader> romfs;
@@ -112,6 +127,9 @@ private:
     std::map<u64, File*> data_offset_map; // assigned data offset -> file
     std::vector<u8> metadata;             // Includes header, hash table and metadata
 
+    // Files loaded from the cache, which are not part of the directory tree
+    std::vector<std::unique_ptr<File>> cached_files;
+
     // Used for rebuilding header
     std::vector<u32_le> directory_hash_table;
     std::vector<u32_le> file_hash_table;
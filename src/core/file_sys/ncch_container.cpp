@@ -3,20 +3,22 @@
 // Refer to the license.txt file included.
 
 #include <cinttypes>
+#include <cstddef>
 #include <cstring>
 #include <memory>
-#include <cryptopp/aes.h>
-#include <cryptopp/modes.h>
 #include <cryptopp/sha.h>
 #include "common/common_types.h"
+#include "common/hash.h"
 #include "common/logging/log.h"
 #include "core/core.h"
 #include "core/file_sys/layered_fs.h"
 #include "core/file_sys/ncch_container.h"
 #include "core/file_sys/patch.h"
 #include "core/file_sys/seed_db.h"
+#include "core/hw/aes/cipher.h"
 #include "core/hw/aes/key.h"
 #include "core/loader/loader.h"
+#include "core/settings.h"
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 // FileSys namespace
@@ -34,28 +36,17 @@ u64 GetModId(u64 program_id) {
     return program_id;
 }
 
-/**
- * Get the decompressed size of an LZSS compressed ExeFS file
- * @param buffer Buffer of compressed file
- * @param size Size of compressed buffer
- * @return Size of decompressed buffer
- */
-static u32 LZSS_GetDecompressedSize(const u8* buffer, u32 size) {
+u32 LZSS_GetDecompressedSize(const u8* buffer, u32 size) {
     u32 offset_size;
     std::memcpy(&offset_size, buffer + size - sizeof(u32), sizeof(u32));
     return offset_size + size;
 }
 
-/**
- * Decompress ExeFS file (compressed with LZSS)
- * @param compressed Compressed buffer
- * @param compressed_size Size of compressed buffer
- * @param decompressed Decompressed buffer
- * @param decompressed_size Size of decompressed buffer
- * @return True on success, otherwise false
- */
-static bool LZSS_Decompress(const u8* compressed, u32 compressed_size, u8* decompressed,
-                            u32 decompressed_size) {
+bool LZSS_Decompress(const u8* compressed, u32 compressed_size, u8* decompressed,
+                     u32 decompressed_size) {
+    if (compressed_size < 8 || decompressed_size < compressed_size)
+        return false;
+
     const u8* footer = compressed + compressed_size - 8;
 
     u32 buffer_top_and_bottom;
@@ -64,51 +55,58 @@ static bool LZSS_Decompress(const u8* compressed, u32 compressed_size, u8* decom
     u32 out = decompressed_size;
     u32 index = compressed_size - ((buffer_top_and_bottom >> 24) & 0xFF);
     u32 stop_index = compressed_size - (buffer_top_and_bottom & 0xFFFFFF);
+    if (index > compressed_size || stop_index > compressed_size)
+        return false;
 
-    memset(decompressed, 0, decompressed_size);
-    memcpy(decompressed, compressed, compressed_size);
+    std::memcpy(decompressed, compressed, compressed_size);
+    std::memset(decompressed + compressed_size, 0, decompressed_size - compressed_size);
 
+    // The data is decompressed backwards, from the end of the buffer. Bounds are checked once per
+    // token rather than once per byte.
     while (index > stop_index) {
         u8 control = compressed[--index];
 
-        for (unsigned i = 0; i < 8; i++) {
-            if (index <= stop_index)
-                break;
-            if (index <= 0)
-                break;
-            if (out <= 0)
-                break;
-
-            if (control & 0x80) {
-                // Check if compression is out of bounds
-                if (index < 2)
-                    return false;
-                index -= 2;
-
-                u32 segment_offset = compressed[index] | (compressed[index + 1] << 8);
-                u32 segment_size = ((segment_offset >> 12) & 15) + 3;
-                segment_offset &= 0x0FFF;
-                segment_offset += 2;
-
-                // Check if compression is out of bounds
-                if (out < segment_size)
-                    return false;
-
-                for (unsigned j = 0; j < segment_size; j++) {
-                    // Check if compression is out of bounds
-                    if (out + segment_offset >= decompressed_size)
-                        return false;
-
-                    u8 data = decompressed[out + segment_offset];
-                    decompressed[--out] = data;
+        for (unsigned i = 0; i < 8 && index > stop_index && out > 0; i++, control <<= 1) {
+            if ((control & 0x80) == 0) {
+                decompressed[--out] = compressed[--index];
+                continue;
+            }
+
+            // Check if compression is out of bounds
+            if (index < 2)
+                return false;
+            index -= 2;
+
+            u32 segment_offset = compressed[index] | (compressed[index + 1] << 8);
+            const u32 segment_size = ((segment_offset >> 12) & 15) + 3;
+            segment_offset &= 0x0FFF;
+            segment_offset += 2;
+
+            // Check if compression is out of bounds
+            if (out < segment_size || out + segment_offset >= decompressed_size)
+                return false;
+
+            out -= segment_size;
+            u8* dest = decompressed + out;
+            const u8* src = dest + segment_offset + 1;
+            if (segment_offset + 1 >= segment_size) {
+                // The source doesn't overlap the destination, so it can be copied by words
+                u32 j = 0;
+                for (; j + sizeof(u64) <= segment_size; j += sizeof(u64)) {
+                    u64 word;
+                    std::memcpy(&word, src + j, sizeof(u64));
+                    std::memcpy(dest + j, &word, sizeof(u64));
+                }
+                for (; j < segment_size; j++) {
+                    dest[j] = src[j];
                 }
             } else {
-                // Check if compression is out of bounds
-                if (out < 1)
-                    return false;
-                decompressed[--out] = compressed[--index];
+                // Overlapping segments repeat a pattern, which must be copied byte by byte in the
+                // same order as the data is produced
+                for (u32 j = segment_size; j-- > 0;) {
+                    dest[j] = src[j];
+                }
             }
-            control <<= 1;
         }
     }
     return true;
@@ -347,10 +345,9 @@ Loader::ResultStatus NCCHContainer::Load() {
                         LOG_ERROR(Service_FS, "Failed to decrypt");
                         return Loader::ResultStatus::ErrorEncrypted;
                     }
-                    CryptoPP::byte* data = reinterpret_cast<CryptoPP::byte*>(&exheader_header);
-                    CryptoPP::CTR_Mode<CryptoPP::AES>::Decryption(
-                        primary_key.data(), primary_key.size(), exheader_ctr.data())
-                        .ProcessData(data, data, sizeof(exheader_header));
+                    HW::AES::TransformCTR(primary_key, exheader_ctr, 0,
+                                          reinterpret_cast<u8*>(&exheader_header),
+                                          sizeof(exheader_header));
                 }
             }
 
@@ -419,10 +416,8 @@ Loader::ResultStatus NCCHContainer::Load() {
                 return Loader::ResultStatus::Error;
 
             if (is_encrypted) {
-                CryptoPP::byte* data = reinterpret_cast<CryptoPP::byte*>(&exefs_header);
-                CryptoPP::CTR_Mode<CryptoPP::AES>::Decryption(primary_key.data(),
-                                                              primary_key.size(), exefs_ctr.data())
-                    .ProcessData(data, data, sizeof(exefs_header));
+                HW::AES::TransformCTR(primary_key, exefs_ctr, 0,
+                                      reinterpret_cast<u8*>(&exefs_header), sizeof(exefs_header));
             }
 
             exefs_file = FileUtil::IOFile(filepath, "rb");
@@ -439,6 +434,11 @@ Loader::ResultStatus NCCHContainer::Load() {
     if (!(has_exefs || has_romfs || is_tainted))
         return Loader::ResultStatus::Error;
 
+    // Map the ExeFS once, so its sections can be read without copying them to a temporary buffer
+    if (exefs_file.IsOpen()) {
+        exefs_mapping = FileUtil::MappedFile(exefs_file.GetFilename());
+    }
+
     is_loaded = true;
     return Loader::ResultStatus::Success;
 }
@@ -524,6 +524,21 @@ Loader::ResultStatus NCCHContainer::LoadSectionExeFS(const char* name, std::vect
                 (section.offset + exefs_offset + sizeof(ExeFs_Header) + ncch_offset);
             exefs_file.Seek(section_offset, SEEK_SET);
 
+            // Read the section straight from the mapped file when possible
+            const u8* mapped_section = nullptr;
+            const u64 mapping_size = exefs_mapping.Size();
+            if (exefs_mapping.IsOpen() && static_cast<u64>(section_offset) <= mapping_size &&
+                section.size <= mapping_size - section_offset) {
+                mapped_section = exefs_mapping.Data() + section_offset;
+            }
+            const auto read_section = [&](u8* dest) {
+                if (mapped_section != nullptr) {
+                    std::memcpy(dest, mapped_section, section.size);
+                    return true;
+                }
+                return exefs_file.ReadBytes(dest, section.size) == section.size;
+            };
+
             std::array<u8, 16> key;
             if (strcmp(section.name, "icon") == 0 || strcmp(section.name, "banner") == 0) {
                 key = primary_key;
@@ -531,39 +546,42 @@ Loader::ResultStatus NCCHContainer::LoadSectionExeFS(const char* name, std::vect
                 key = secondary_key;
             }
 
-            CryptoPP::CTR_Mode<CryptoPP::AES>::Decryption dec(key.data(), key.size(),
-                                                              exefs_ctr.data());
-            dec.Seek(section.offset + sizeof(ExeFs_Header));
+            const u64 crypto_offset = section.offset + sizeof(ExeFs_Header);
 
             if (strcmp(section.name, ".code") == 0 && is_compressed) {
                 // Section is compressed, read compressed .code section...
+                const u8* compressed = mapped_section;
                 std::unique_ptr<u8[]> temp_buffer;
-                try {
-                    temp_buffer.reset(new u8[section.size]);
-                } catch (std::bad_alloc&) {
-                    return Loader::ResultStatus::ErrorMemoryAllocationFailed;
-                }
+                if (compressed == nullptr || is_encrypted) {
+                    try {
+                        temp_buffer.reset(new u8[section.size]);
+                    } catch (std::bad_alloc&) {
+                        return Loader::ResultStatus::ErrorMemoryAllocationFailed;
+                    }
 
-                if (exefs_file.ReadBytes(&temp_buffer[0], section.size) != section.size)
-                    return Loader::ResultStatus::Error;
+                    if (!read_section(&temp_buffer[0]))
+                        return Loader::ResultStatus::Error;
 
-                if (is_encrypted) {
-                    dec.ProcessData(&temp_buffer[0], &temp_buffer[0], section.size);
+                    if (is_encrypted) {
+                        HW::AES::TransformCTR(key, exefs_ctr, crypto_offset, &temp_buffer[0],
+                                              section.size);
+                    }
+                    compressed = &temp_buffer[0];
                 }
 
                 // Decompress .code section...
-                u32 decompressed_size = LZSS_GetDecompressedSize(&temp_buffer[0], section.size);
+                u32 decompressed_size = LZSS_GetDecompressedSize(compressed, section.size);
                 buffer.resize(decompressed_size);
-                if (!LZSS_Decompress(&temp_buffer[0], section.size, buffer.data(),
-                                     decompressed_size))
+                if (!LZSS_Decompress(compressed, section.size, buffer.data(), decompressed_size))
                     return Loader::ResultStatus::ErrorInvalidFormat;
             } else {
                 // Section is uncompressed...
                 buffer.resize(section.size);
-                if (exefs_file.ReadBytes(buffer.data(), section.size) != section.size)
+                if (!read_section(buffer.data()))
                     return Loader::ResultStatus::Error;
                 if (is_encrypted) {
-                    dec.ProcessData(buffer.data(), buffer.data(), section.size);
+                    HW::AES::TransformCTR(key, exefs_ctr, crypto_offset, buffer.data(),
+                                          section.size);
                 }
             }
 
@@ -573,10 +591,11 @@ Loader::ResultStatus NCCHContainer::LoadSectionExeFS(const char* name, std::vect
     return Loader::ResultStatus::ErrorNotUsed;
 }
 
-Loader::ResultStatus NCCHContainer::ApplyCodePatch(std::vector<u8>& code) const {
+Loader::ResultStatus NCCHContainer::ReadCodePatch(std::vector<u8>& patch,
+                                                 CodePatchFunction& patch_fn) const {
     struct PatchLocation {
         std::string path;
-        bool (*patch_fn)(const std::vector<u8>& patch, std::vector<u8>& code);
+        CodePatchFunction patch_fn;
     };
 
     const auto mods_path =
@@ -596,19 +615,129 @@ Loader::ResultStatus NCCHContainer::ApplyCodePatch(std::vector<u8>& code) const
         if (!file)
             continue;
 
-        std::vector<u8> patch(file.GetSize());
+        patch.resize(file.GetSize());
         if (file.ReadBytes(patch.data(), patch.size()) != patch.size())
             return Loader::ResultStatus::Error;
 
         LOG_INFO(Service_FS, "File {} patching code.bin", info.path);
-        if (!info.patch_fn(patch, code))
-            return Loader::ResultStatus::Error;
-
+        patch_fn = info.patch_fn;
         return Loader::ResultStatus::Success;
     }
     return Loader::ResultStatus::ErrorNotUsed;
 }
 
+Loader::ResultStatus NCCHContainer::ApplyCodePatch(std::vector<u8>& code) const {
+    std::vector<u8> patch;
+    CodePatchFunction patch_fn;
+    const Loader::ResultStatus result = ReadCodePatch(patch, patch_fn);
+    if (result != Loader::ResultStatus::Success)
+        return result;
+
+    if (!patch_fn(patch, code))
+        return Loader::ResultStatus::Error;
+
+    return Loader::ResultStatus::Success;
+}
+
+namespace {
+
+constexpr u32 CodeCacheMagic = 0x45444F43; // "CODE"
+constexpr u32 CodeCacheVersion = 1;
+
+struct CodeCacheHeader {
+    u32_le magic;
+    u32_le version;
+    u64_le program_id;
+    u64_le exefs_hash;
+    u64_le patch_hash;
+    u32_le bss_size;
+    u32_le code_size;
+};
+static_assert(sizeof(CodeCacheHeader) == 0x28, "CodeCacheHeader has incorrect size.");
+
+bool operator==(const CodeCacheHeader& lhs, const CodeCacheHeader& rhs) {
+    return std::memcmp(&lhs, &rhs, offsetof(CodeCacheHeader, code_size)) == 0;
+}
+
+bool LoadCachedCode(const std::string& path, const CodeCacheHeader& expected,
+                    std::vector<u8>& code) {
+    FileUtil::IOFile file(path, "rb");
+    CodeCacheHeader header;
+    if (!file.IsOpen() || file.ReadBytes(&header, sizeof(header)) != sizeof(header) ||
+        !(header == expected)) {
+        return false;
+    }
+
+    std::vector<u8> cached_code(header.code_size);
+    if (file.ReadBytes(cached_code.data(), cached_code.size()) != cached_code.size()) {
+        return false;
+    }
+    code = std::move(cached_code);
+    return true;
+}
+
+void SaveCachedCode(const std::string& path, CodeCacheHeader header, const std::vector<u8>& code) {
+    if (!FileUtil::CreateFullPath(path)) {
+        LOG_ERROR(Service_FS, "Could not create code cache path {}", path);
+        return;
+    }
+
+    header.code_size = static_cast<u32>(code.size());
+    FileUtil::IOFile file(path, "wb");
+    if (file.WriteObject(header) != 1 || file.WriteBytes(code.data(), code.size()) != code.size()) {
+        LOG_ERROR(Service_FS, "Could not write code cache {}", path);
+        file.Close();
+        FileUtil::Delete(path);
+    }
+}
+
+} // Anonymous namespace
+
+Loader::ResultStatus NCCHContainer::LoadPatchedCode(std::vector<u8>& code, u32 bss_size) {
+    Loader::ResultStatus result = Load();
+    if (result != Loader::ResultStatus::Success)
+        return result;
+
+    std::vector<u8> patch;
+    CodePatchFunction patch_fn = nullptr;
+    result = ReadCodePatch(patch, patch_fn);
+    if (result != Loader::ResultStatus::Success && result != Loader::ResultStatus::ErrorNotUsed)
+        return result;
+
+    // Overrides replace sections without updating the ExeFS header, so they can't be cached
+    const bool use_cache = Settings::values.use_code_cache && has_exefs && !is_tainted;
+    CodeCacheHeader cache_header{};
+    std::string cache_path;
+    if (use_cache) {
+        cache_header.magic = CodeCacheMagic;
+        cache_header.version = CodeCacheVersion;
+        cache_header.program_id = ncch_header.program_id;
+        cache_header.exefs_hash = Common::ComputeStructHash64(exefs_header);
+        cache_header.patch_hash = Common::ComputeHash64(patch.data(), patch.size());
+        cache_header.bss_size = bss_size;
+        cache_path = fmt::format("{}code/{:016X}.bin",
+                                 FileUtil::GetUserPath(FileUtil::UserPath::CacheDir),
+                                 ncch_header.program_id);
+        if (LoadCachedCode(cache_path, cache_header, code)) {
+            LOG_INFO(Service_FS, "Loaded code from cache {}", cache_path);
+            return Loader::ResultStatus::Success;
+        }
+    }
+
+    result = LoadSectionExeFS(".code", code);
+    if (result != Loader::ResultStatus::Success)
+        return result;
+
+    code.resize(code.size() + bss_size, 0);
+    if (patch_fn != nullptr && !patch_fn(patch, code))
+        return Loader::ResultStatus::Error;
+
+    if (use_cache) {
+        SaveCachedCode(cache_path, cache_header, code);
+    }
+    return Loader::ResultStatus::Success;
+}
+
 Loader::ResultStatus NCCHContainer::LoadOverrideExeFSSection(const char* name,
                                                              std::vector<u8>& buffer) {
     std::string override_name;
@@ -228,6 +228,25 @@ static_assert(sizeof(ExHeader_Header) == 0x800, "ExHeader structure size is wron
 
 namespace FileSys {
 
+/**
+ * Get the decompressed size of an LZSS compressed ExeFS file
+ * @param buffer Buffer of compressed file
+ * @param size Size of compressed buffer
+ * @return Size of decompressed buffer
+ */
+u32 LZSS_GetDecompressedSize(const u8* buffer, u32 size);
+
+/**
+ * Decompress ExeFS file (compressed with LZSS)
+ * @param compressed Compressed buffer
+ * @param compressed_size Size of compressed buffer
+ * @param decompressed Decompressed buffer
+ * @param decompressed_size Size of decompressed buffer
+ * @return True on success, otherwise false
+ */
+bool LZSS_Decompress(const u8* compressed, u32 compressed_size, u8* decompressed,
+                     u32 decompressed_size);
+
 /**
  * Helper which implements an interface to deal with NCCH containers which can
  * contain ExeFS archives or RomFS archives for games or other applications.
@@ -323,6 +342,17 @@ public:
      */
     Loader::ResultStatus ApplyCodePatch(std::vector<u8>& code) const;
 
+    /**
+     * Load the .code section with the .bss appended and the code patch applied. Unless ExeFS
+     * overrides are in use, the result is cached on disk, keyed on the title ID, the ExeFS header
+     * (which holds the section hashes) and the patch, so later boots skip decompression and
+     * patching.
+     * @param code Buffer to load the code into
+     * @param bss_size Size of the .bss to allocate after the code, in bytes
+     * @return ResultStatus result of function
+     */
+    Loader::ResultStatus LoadPatchedCode(std::vector<u8>& code, u32 bss_size);
+
     /**
      * Checks whether the NCCH container contains an ExeFS
      * @return bool check result
@@ -346,6 +376,16 @@ public:
     ExHeader_Header exheader_header;
 
 private:
+    using CodePatchFunction = bool (*)(const std::vector<u8>& patch, std::vector<u8>& code);
+
+    /**
+     * Read the patch for .code (if it exists).
+     * @param patch Buffer to read the patch into
+     * @param patch_fn Set to the function applying the patch
+     * @return ResultStatus success if a patch was found, ErrorNotUsed if no patch was found
+     */
+    Loader::ResultStatus ReadCodePatch(std::vector<u8>& patch, CodePatchFunction& patch_fn) const;
+
     bool has_header = false;
     bool has_exheader = false;
     bool has_exefs = false;
@@ -370,6 +410,7 @@ private:
     std::string filepath;
     FileUtil::IOFile file;
     FileUtil::IOFile exefs_file;
+    FileUtil::MappedFile exefs_mapping;
 };
 
 } // namespace FileSys
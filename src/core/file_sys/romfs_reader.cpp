@@ -1,25 +1,279 @@
 #include <algorithm>
-#include <cryptopp/aes.h>
-#include <cryptopp/modes.h>
+#include <chrono>
+#include <cstring>
+#include <list>
+#include <string>
+#include <unordered_map>
 #include "common/archives.h"
+#include "common/logging/log.h"
+#include "common/thread_worker.h"
 #include "core/file_sys/romfs_reader.h"
+#include "core/hw/aes/cipher.h"
+#include "core/settings.h"
 
 SERIALIZE_EXPORT_IMPL(FileSys::DirectRomFSReader)
 
 namespace FileSys {
 
+/// Reads spanning more blocks than this are read directly, so that they don't flush the cache
+constexpr std::size_t MaxCachedReadBlocks = 4;
+/// Number of blocks read ahead after a sequential read
+constexpr std::size_t ReadAheadBlocks = 4;
+
+static std::size_t GetCacheBudget() {
+    return static_cast<std::size_t>(Settings::values.romfs_cache_size_mb) * 1024 * 1024;
+}
+
+/// The cache of decrypted blocks of a RomFS and the thread reading ahead into it, shared by all
+/// the readers of that RomFS.
+class DirectRomFSReader::SharedCache {
+public:
+    explicit SharedCache(std::size_t budget) : budget(budget) {}
+
+    ~SharedCache() {
+        if (stats.hits + stats.misses != 0) {
+            LOG_DEBUG(Service_FS, "RomFS cache: {} hits, {} misses, {} blocks read ahead",
+                      stats.hits, stats.misses, stats.read_ahead_blocks);
+        }
+    }
+
+    /// Returns the cache of the RomFS at the specified offset of a file, creating it if no reader
+    /// uses it yet.
+    static std::shared_ptr<SharedCache> Get(const std::string& path, u64 file_offset) {
+        static std::mutex registry_mutex;
+        static std::unordered_map<std::string, std::weak_ptr<SharedCache>> registry;
+
+        std::lock_guard lock{registry_mutex};
+        for (auto itr = registry.begin(); itr != registry.end();) {
+            itr = itr->second.expired() ? registry.erase(itr) : std::next(itr);
+        }
+        auto& entry = registry[fmt::format("{}:{}", path, file_offset)];
+        std::shared_ptr<SharedCache> shared_cache = entry.lock();
+        if (!shared_cache) {
+            shared_cache = std::make_shared<SharedCache>(GetCacheBudget());
+            entry = shared_cache;
+        }
+        return shared_cache;
+    }
+
+    std::size_t GetBudget() const {
+        return budget;
+    }
+
+    /// Returns the specified block if it is cached, counting a hit or a miss.
+    Block Find(u64 index) {
+        std::lock_guard lock{mutex};
+        const auto itr = cache.find(index);
+        if (itr == cache.end()) {
+            ++stats.misses;
+            return nullptr;
+        }
+        ++stats.hits;
+        lru.splice(lru.begin(), lru, itr->second);
+        return itr->second->second;
+    }
+
+    bool Contains(u64 index) const {
+        std::lock_guard lock{mutex};
+        return cache.count(index) != 0;
+    }
+
+    /// Inserts a block, evicting the least recently used ones over the budget.
+    void Insert(u64 index, Block block, bool read_ahead) {
+        std::lock_guard lock{mutex};
+        if (cache.count(index) != 0) {
+            return; // Read meanwhile
+        }
+        if (read_ahead) {
+            ++stats.read_ahead_blocks;
+        }
+        size += block->size();
+        lru.emplace_front(index, std::move(block));
+        cache.emplace(index, lru.begin());
+
+        while (size > budget && lru.size() > 1) {
+            const auto& [evicted_index, evicted_block] = lru.back();
+            size -= evicted_block->size();
+            cache.erase(evicted_index);
+            lru.pop_back();
+        }
+    }
+
+    CacheStats GetStats() const {
+        std::lock_guard lock{mutex};
+        return stats;
+    }
+
+    /// Returns the thread reading ahead for the readers of the RomFS, starting it if needed.
+    Common::ThreadWorker& GetReadAheadWorker() {
+        std::lock_guard lock{mutex};
+        if (!read_ahead_worker) {
+            read_ahead_worker = std::make_unique<Common::ThreadWorker>(1, "RomFSReadAhead");
+        }
+        return *read_ahead_worker;
+    }
+
+private:
+    const std::size_t budget;
+
+    mutable std::mutex mutex;
+    std::size_t size = 0;
+    /// Cached blocks, the most recently used first
+    std::list<std::pair<u64, Block>> lru;
+    std::unordered_map<u64, std::list<std::pair<u64, Block>>::iterator> cache;
+    CacheStats stats;
+
+    std::unique_ptr<Common::ThreadWorker> read_ahead_worker;
+};
+
+DirectRomFSReader::DirectRomFSReader() = default;
+
+DirectRomFSReader::DirectRomFSReader(FileUtil::IOFile&& file, std::size_t file_offset,
+                                     std::size_t data_size)
+    : is_encrypted(false), file(std::move(file)), file_offset(file_offset), data_size(data_size) {
+    Open();
+}
+
+DirectRomFSReader::DirectRomFSReader(FileUtil::IOFile&& file, std::size_t file_offset,
+                                     std::size_t data_size, const std::array<u8, 16>& key,
+                                     const std::array<u8, 16>& ctr, std::size_t crypto_offset)
+    : is_encrypted(true), file(std::move(file)), key(key), ctr(ctr), file_offset(file_offset),
+      crypto_offset(crypto_offset), data_size(data_size) {
+    Open();
+}
+
+DirectRomFSReader::~DirectRomFSReader() {
+    WaitForReadAhead();
+}
+
 std::size_t DirectRomFSReader::ReadFile(std::size_t offset, std::size_t length, u8* buffer) {
-    if (length == 0)
+    if (length == 0 || offset >= data_size)
         return 0; // Crypto++ does not like zero size buffer
-    file.Seek(file_offset + offset, SEEK_SET);
-    std::size_t read_length = std::min(length, static_cast<std::size_t>(data_size) - offset);
-    read_length = file.ReadBytes(buffer, read_length);
-    if (is_encrypted) {
-        CryptoPP::CTR_Mode<CryptoPP::AES>::Decryption d(key.data(), key.size(), ctr.data());
-        d.Seek(crypto_offset + offset);
-        d.ProcessData(buffer, buffer, read_length);
+    length = std::min(length, static_cast<std::size_t>(data_size) - offset);
+
+    // The mapping is backed by the host page cache already, caching it again would only add a copy
+    if (const u8* data = GetDataPointer(offset, length)) {
+        std::memcpy(buffer, data, length);
+        return length;
+    }
+
+    const u64 first_block = offset / BlockSize;
+    const u64 last_block = (offset + length - 1) / BlockSize;
+    if (!shared_cache || shared_cache->GetBudget() == 0 ||
+        last_block - first_block >= MaxCachedReadBlocks) {
+        std::lock_guard lock{file_mutex};
+        return ReadDirect(offset, length, buffer);
+    }
+
+    std::size_t read_length = 0;
+    for (u64 index = first_block; index <= last_block; ++index) {
+        const Block block = GetBlock(index);
+        const std::size_t block_offset = offset + read_length - index * BlockSize;
+        if (block_offset >= block->size()) {
+            break; // The file is shorter than expected
+        }
+        const std::size_t copy_length =
+            std::min(length - read_length, block->size() - block_offset);
+        std::memcpy(buffer + read_length, block->data() + block_offset, copy_length);
+        read_length += copy_length;
+    }
+
+    // Games streaming assets read the RomFS in order, so the next blocks will likely be needed soon
+    const u64 previous_next_block = next_sequential_block.exchange(last_block + 1);
+    if (first_block == previous_next_block || first_block + 1 == previous_next_block) {
+        StartReadAhead(last_block);
+    }
+    return read_length;
+}
+
+DirectRomFSReader::CacheStats DirectRomFSReader::GetCacheStats() const {
+    return shared_cache ? shared_cache->GetStats() : CacheStats{};
+}
+
+const u8* DirectRomFSReader::GetDataPointer(std::size_t offset, std::size_t length) {
+    if (is_encrypted || offset > data_size || length > data_size - offset) {
+        return nullptr;
+    }
+    std::size_t mapped_length = length;
+    const u8* data = GetMappedRange(offset, mapped_length);
+    return mapped_length == length ? data : nullptr;
+}
+
+void DirectRomFSReader::Open() {
+    mapping = FileUtil::MappedFile(file.GetFilename());
+    if (!mapping.IsOpen()) {
+        LOG_DEBUG(Service_FS, "Could not map {}, reading it through stdio", file.GetFilename());
+    }
+    shared_cache = SharedCache::Get(file.GetFilename(), file_offset);
+}
+
+const u8* DirectRomFSReader::GetMappedRange(std::size_t offset, std::size_t& length) const {
+    const u64 start = file_offset + offset;
+    if (!mapping.IsOpen() || start >= mapping.Size()) {
+        return nullptr;
+    }
+    length = static_cast<std::size_t>(std::min<u64>(length, mapping.Size() - start));
+    return mapping.Data() + start;
+}
+
+std::size_t DirectRomFSReader::ReadDirect(std::size_t offset, std::size_t length, u8* buffer) {
+    std::size_t read_length = length;
+    if (const u8* data = GetMappedRange(offset, read_length)) {
+        std::memcpy(buffer, data, read_length);
+    } else {
+        file.Seek(file_offset + offset, SEEK_SET);
+        read_length = file.ReadBytes(buffer, length);
+    }
+    if (is_encrypted && read_length != 0) {
+        HW::AES::TransformCTR(key, ctr, crypto_offset + offset, buffer, read_length);
     }
     return read_length;
 }
 
+DirectRomFSReader::Block DirectRomFSReader::GetBlock(u64 index) {
+    if (Block block = shared_cache->Find(index)) {
+        return block;
+    }
+    Block block = LoadBlock(index);
+    shared_cache->Insert(index, block, false);
+    return block;
+}
+
+DirectRomFSReader::Block DirectRomFSReader::LoadBlock(u64 index) {
+    const std::size_t offset = static_cast<std::size_t>(index * BlockSize);
+    auto block = std::make_shared<std::vector<u8>>(
+        std::min(BlockSize, static_cast<std::size_t>(data_size) - offset));
+    std::lock_guard lock{file_mutex};
+    block->resize(ReadDirect(offset, block->size(), block->data()));
+    return block;
+}
+
+void DirectRomFSReader::StartReadAhead(u64 last_index) {
+    std::lock_guard lock{read_ahead_mutex};
+    if (read_ahead.valid() &&
+        read_ahead.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+        return;
+    }
+
+    const u64 block_count = (data_size + BlockSize - 1) / BlockSize;
+    const u64 end_index = std::min<u64>(last_index + 1 + ReadAheadBlocks, block_count);
+    if (last_index + 1 >= end_index) {
+        return;
+    }
+    read_ahead = shared_cache->GetReadAheadWorker().Submit([this, last_index, end_index] {
+        for (u64 index = last_index + 1; index < end_index; ++index) {
+            if (!shared_cache->Contains(index)) {
+                shared_cache->Insert(index, LoadBlock(index), true);
+            }
+        }
+    });
+}
+
+void DirectRomFSReader::WaitForReadAhead() {
+    std::lock_guard lock{read_ahead_mutex};
+    if (read_ahead.valid()) {
+        read_ahead.wait();
+    }
+}
+
 } // namespace FileSys
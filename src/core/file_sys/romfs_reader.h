@@ -1,6 +1,12 @@
 #pragma once
 
 #include <array>
+#include <atomic>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
 #include <boost/serialization/array.hpp>
 #include <boost/serialization/base_object.hpp>
 #include <boost/serialization/export.hpp>
@@ -19,6 +25,21 @@ public:
     virtual std::size_t GetSize() const = 0;
     virtual std::size_t ReadFile(std::size_t offset, std::size_t length, u8* buffer) = 0;
 
+    /**
+     * Returns a pointer to the specified range if it can be read in place, so callers can copy it
+     * straight to its destination. The pointer stays valid for the lifetime of the reader.
+     * @return Pointer to the data, or nullptr if the range must be read with ReadFile
+     */
+    virtual const u8* GetDataPointer(std::size_t offset, std::size_t length) {
+        return nullptr;
+    }
+
+    /// Returns the path of the host file the RomFS is read from, or an empty string if there is
+    /// none. Used to tell when data derived from the RomFS is outdated.
+    virtual std::string GetFilePath() const {
+        return {};
+    }
+
 private:
     template <class Archive>
     void serialize(Archive& ar, const unsigned int file_version) {}
@@ -26,21 +47,30 @@ private:
 };
 
 /**
- * A RomFS reader that directly reads the RomFS file.
+ * A RomFS reader that directly reads the RomFS file. The file is memory mapped when possible, so
+ * unencrypted data is copied once from the mapping. Small encrypted reads are served from an LRU
+ * cache of decrypted, aligned blocks, and the blocks following sequential reads are read ahead on
+ * a background thread. The cache, its budget and the read-ahead thread are shared by all the
+ * readers of the same RomFS, as the archives of a title open a reader for every file.
  */
 class DirectRomFSReader : public RomFSReader {
 public:
-    DirectRomFSReader(FileUtil::IOFile&& file, std::size_t file_offset, std::size_t data_size)
-        : is_encrypted(false), file(std::move(file)), file_offset(file_offset),
-          data_size(data_size) {}
+    /// Size of the cached blocks. Reads of more than a few blocks bypass the cache.
+    static constexpr std::size_t BlockSize = 0x10000;
+
+    struct CacheStats {
+        u64 hits = 0;
+        u64 misses = 0;
+        u64 read_ahead_blocks = 0;
+    };
+
+    DirectRomFSReader(FileUtil::IOFile&& file, std::size_t file_offset, std::size_t data_size);
 
     DirectRomFSReader(FileUtil::IOFile&& file, std::size_t file_offset, std::size_t data_size,
                       const std::array<u8, 16>& key, const std::array<u8, 16>& ctr,
-                      std::size_t crypto_offset)
-        : is_encrypted(true), file(std::move(file)), key(key), ctr(ctr), file_offset(file_offset),
-          crypto_offset(crypto_offset), data_size(data_size) {}
+                      std::size_t crypto_offset);
 
-    ~DirectRomFSReader() override = default;
+    ~DirectRomFSReader() override;
 
     std::size_t GetSize() const override {
         return data_size;
@@ -48,19 +78,66 @@ public:
 
     std::size_t ReadFile(std::size_t offset, std::size_t length, u8* buffer) override;
 
+    const u8* GetDataPointer(std::size_t offset, std::size_t length) override;
+
+    std::string GetFilePath() const override {
+        return file.GetFilename();
+    }
+
+    /// Returns the statistics of the block cache shared by the readers of this RomFS.
+    CacheStats GetCacheStats() const;
+
 private:
+    using Block = std::shared_ptr<const std::vector<u8>>;
+    class SharedCache;
+
+    /// Maps the file, falling back to reading it with IOFile if that fails, and finds the cache
+    /// of the RomFS.
+    void Open();
+
+    /// Returns the mapped range of the RomFS, clamped to the end of the file. Returns nullptr if
+    /// the file isn't mapped or the range is out of the file.
+    const u8* GetMappedRange(std::size_t offset, std::size_t& length) const;
+
+    /// Reads and decrypts the specified range of the RomFS. Must be called with file_mutex held.
+    std::size_t ReadDirect(std::size_t offset, std::size_t length, u8* buffer);
+
+    /// Returns the specified block, from the cache if possible.
+    Block GetBlock(u64 index);
+
+    /// Reads the specified block from the file.
+    Block LoadBlock(u64 index);
+
+    /// Starts reading ahead the blocks after the specified one, unless that is already underway.
+    void StartReadAhead(u64 last_index);
+
+    void WaitForReadAhead();
+
     bool is_encrypted;
     FileUtil::IOFile file;
+    FileUtil::MappedFile mapping;
     std::array<u8, 16> key;
     std::array<u8, 16> ctr;
     u64 file_offset;
     u64 crypto_offset;
     u64 data_size;
 
-    DirectRomFSReader() = default;
+    /// Guards the file, which is also read by the read-ahead thread
+    std::mutex file_mutex;
+
+    std::shared_ptr<SharedCache> shared_cache;
+
+    /// Block following the last read, used to detect sequential reads
+    std::atomic<u64> next_sequential_block{0};
+    /// Guards read_ahead
+    std::mutex read_ahead_mutex;
+    std::future<void> read_ahead;
+
+    DirectRomFSReader();
 
     template <class Archive>
     void serialize(Archive& ar, const unsigned int) {
+        WaitForReadAhead();
         ar& boost::serialization::base_object<RomFSReader>(*this);
         ar& is_encrypted;
         ar& file;
@@ -69,6 +146,9 @@ private:
         ar& file_offset;
         ar& crypto_offset;
         ar& data_size;
+        if (Archive::is_loading::value) {
+            Open();
+        }
     }
     friend class boost::serialization::access;
 };
@@ -0,0 +1,157 @@
+// Copyright 2020 Citra Emulator Project
+// Licensed under GPLv2 or any later version
+// Refer to the license.txt file included.
+
+#include <algorithm>
+#include <ctime>
+#include <fmt/chrono.h>
+#include <fmt/format.h>
+#include "common/file_util.h"
+#include "common/logging/log.h"
+#include "common/string_util.h"
+#include "core/hle/call_profiler.h"
+#include "core/hle/service/service.h"
+#include "core/settings.h"
+
+namespace HLE {
+
+/// Returns the histogram bucket for a call that took the specified number of nanoseconds.
+static std::size_t GetHistogramBucket(u64 ns) {
+    std::size_t bucket = 0;
+    while (ns > 1 && bucket < CallProfiler::NumHistogramBuckets - 1) {
+        ns >>= 1;
+        ++bucket;
+    }
+    return bucket;
+}
+
+/// Quotes a string so it can be used as a CSV field, even if it contains commas or quotes.
+static std::string QuoteCSV(const std::string& str) {
+    return fmt::format("\"{}\"", Common::ReplaceAll(str, "\"", "\"\""));
+}
+
+CallProfiler::CallProfiler(u64 title_id)
+    : enabled(Settings::values.record_hle_call_stats), title_id(title_id) {}
+
+CallProfiler::~CallProfiler() {
+    if (!IsEnabled() || title_id == 0) {
+        return;
+    }
+
+    const std::time_t t = std::time(nullptr);
+    const std::string& path = FileUtil::GetUserPath(FileUtil::UserPath::LogDir);
+    // %F Date format expanded is "%Y-%m-%d"
+    const std::string filename =
+        fmt::format("{}/{:%F-%H-%M}_{:016X}_hle_calls", path, *std::localtime(&t), title_id);
+    if (!DumpCSV(filename + ".csv") || !DumpJSON(filename + ".json")) {
+        LOG_ERROR(Service, "Could not write HLE call statistics to {}", filename);
+    }
+}
+
+void CallProfiler::RecordServiceCall(const Service::ServiceFrameworkBase& service, u32 header,
+                                     Clock::duration duration) {
+    const u64 ns =
+        static_cast<u64>(std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count());
+
+    std::lock_guard lock{mutex};
+    auto [itr, inserted] = service_calls.try_emplace(ServiceKey{&service, header});
+    ServiceCallStats& stats = itr->second;
+    if (inserted) {
+        // Names are only looked up the first time, as they don't change.
+        stats.service_name = service.GetServiceName();
+        stats.function_name = service.GetFunctionName(header);
+        stats.header = header;
+    }
+    ++stats.count;
+    stats.total_ns += ns;
+    stats.max_ns = std::max(stats.max_ns, ns);
+    ++stats.histogram[GetHistogramBucket(ns)];
+}
+
+void CallProfiler::RecordSVCCall(u32 id, const char* name) {
+    if (id >= NumSVCs) {
+        return;
+    }
+
+    std::lock_guard lock{mutex};
+    ++svc_counts[id];
+    svc_names[id] = name;
+}
+
+std::vector<CallProfiler::ServiceCallStats> CallProfiler::GetServiceCallStats() const {
+    std::vector<ServiceCallStats> result;
+    {
+        std::lock_guard lock{mutex};
+        result.reserve(service_calls.size());
+        for (const auto& [key, stats] : service_calls) {
+            result.push_back(stats);
+        }
+    }
+    std::sort(result.begin(), result.end(),
+              [](const auto& lhs, const auto& rhs) { return lhs.total_ns > rhs.total_ns; });
+    return result;
+}
+
+std::vector<CallProfiler::SVCCallStats> CallProfiler::GetSVCCallStats() const {
+    std::vector<SVCCallStats> result;
+    {
+        std::lock_guard lock{mutex};
+        for (u32 id = 0; id < NumSVCs; ++id) {
+            if (svc_counts[id] != 0) {
+                result.push_back({id, svc_names[id] ? svc_names[id] : "", svc_counts[id]});
+            }
+        }
+    }
+    std::sort(result.begin(), result.end(),
+              [](const auto& lhs, const auto& rhs) { return lhs.count > rhs.count; });
+    return result;
+}
+
+void CallProfiler::Reset() {
+    std::lock_guard lock{mutex};
+    service_calls.clear();
+    svc_counts.fill(0);
+}
+
+bool CallProfiler::DumpCSV(const std::string& path) const {
+    std::string out = "type,service,function,header,count,total_ns,max_ns,histogram\n";
+    for (const auto& stats : GetServiceCallStats()) {
+        out += fmt::format("service,{},{},0x{:08X},{},{},{},{}\n", QuoteCSV(stats.service_name),
+                           QuoteCSV(stats.function_name), stats.header, stats.count,
+                           stats.total_ns, stats.max_ns, fmt::join(stats.histogram, " "));
+    }
+    for (const auto& stats : GetSVCCallStats()) {
+        out += fmt::format("svc,,{},0x{:02X},{},,,\n", QuoteCSV(stats.name), stats.id,
+                           stats.count);
+    }
+
+    FileUtil::IOFile file(path, "w");
+    return file.IsOpen() && file.WriteString(out) == out.size();
+}
+
+bool CallProfiler::DumpJSON(const std::string& path) const {
+    std::string out = fmt::format("{{\n  \"title_id\": \"{:016X}\",\n  \"services\": [", title_id);
+    bool first = true;
+    for (const auto& stats : GetServiceCallStats()) {
+        out += fmt::format("{}\n    {{\"service\": \"{}\", \"function\": \"{}\", \"header\": {}, "
+                           "\"count\": {}, \"total_ns\": {}, \"max_ns\": {}, "
+                           "\"histogram\": [{}]}}",
+                           first ? "" : ",", Common::EscapeJSON(stats.service_name),
+                           Common::EscapeJSON(stats.function_name), stats.header, stats.count,
+                           stats.total_ns, stats.max_ns, fmt::join(stats.histogram, ", "));
+        first = false;
+    }
+    out += "\n  ],\n  \"svcs\": [";
+    first = true;
+    for (const auto& stats : GetSVCCallStats()) {
+        out += fmt::format("{}\n    {{\"id\": {}, \"name\": \"{}\", \"count\": {}}}",
+                           first ? "" : ",", stats.id, Common::EscapeJSON(stats.name), stats.count);
+        first = false;
+    }
+    out += "\n  ]\n}\n";
+
+    FileUtil::IOFile file(path, "w");
+    return file.IsOpen() && file.WriteString(out) == out.size();
+}
+
+} // namespace HLE
@@ -0,0 +1,119 @@
+// Copyright 2020 Citra Emulator Project
+// Licensed under GPLv2 or any later version
+// Refer to the license.txt file included.
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "common/common_types.h"
+
+namespace Service {
+class ServiceFrameworkBase;
+}
+
+namespace HLE {
+
+/**
+ * Collects call counts and host time statistics for HLE service functions and SVCs, so that the
+ * functions dominating emulation time can be found without attaching a profiler. Recording is
+ * cheap enough to be left enabled, and does nothing but a flag check when disabled. All public
+ * functions of this class are thread-safe.
+ */
+class CallProfiler {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    /// Number of buckets of the host time histograms. Bucket i counts calls that took
+    /// [2^i, 2^(i+1)) nanoseconds, and the last bucket also counts anything longer.
+    static constexpr std::size_t NumHistogramBuckets = 32;
+
+    /// Maximum number of SVC ids tracked.
+    static constexpr std::size_t NumSVCs = 0x80;
+
+    struct ServiceCallStats {
+        std::string service_name;
+        std::string function_name; ///< Only implemented functions are recorded
+        u32 header = 0;
+        u64 count = 0;
+        u64 total_ns = 0;
+        u64 max_ns = 0;
+        std::array<u64, NumHistogramBuckets> histogram{};
+    };
+
+    struct SVCCallStats {
+        u32 id = 0;
+        std::string name;
+        u64 count = 0;
+    };
+
+    explicit CallProfiler(u64 title_id);
+    ~CallProfiler();
+
+    bool IsEnabled() const {
+        return enabled.load(std::memory_order_relaxed);
+    }
+
+    void SetEnabled(bool value) {
+        enabled.store(value, std::memory_order_relaxed);
+    }
+
+    /**
+     * Records a call to an HLE service function.
+     * @param service The service that handled the request
+     * @param header The command header of the request
+     * @param duration Host time spent handling the request
+     */
+    void RecordServiceCall(const Service::ServiceFrameworkBase& service, u32 header,
+                           Clock::duration duration);
+
+    /**
+     * Records a call to an SVC.
+     * @param id The SVC id
+     * @param name The SVC name. Must outlive the profiler.
+     */
+    void RecordSVCCall(u32 id, const char* name);
+
+    /// Returns the statistics of every service function called so far, most expensive first.
+    std::vector<ServiceCallStats> GetServiceCallStats() const;
+
+    /// Returns the statistics of every SVC called so far, most called first.
+    std::vector<SVCCallStats> GetSVCCallStats() const;
+
+    /// Clears all the recorded statistics.
+    void Reset();
+
+    /// Writes the recorded statistics to the specified file as CSV. Returns false on failure.
+    bool DumpCSV(const std::string& path) const;
+
+    /// Writes the recorded statistics to the specified file as JSON. Returns false on failure.
+    bool DumpJSON(const std::string& path) const;
+
+private:
+    using ServiceKey = std::pair<const Service::ServiceFrameworkBase*, u32>;
+
+    struct ServiceKeyHash {
+        std::size_t operator()(const ServiceKey& key) const {
+            return std::hash<const void*>{}(key.first) ^ (std::hash<u32>{}(key.second) << 1);
+        }
+    };
+
+    mutable std::mutex mutex;
+    std::atomic_bool enabled;
+
+    /// Title ID for the game that is running. 0 if there is no game running yet
+    u64 title_id;
+
+    std::unordered_map<ServiceKey, ServiceCallStats, ServiceKeyHash> service_calls;
+    std::array<u64, NumSVCs> svc_counts{};
+    std::array<const char*, NumSVCs> svc_names{};
+};
+
+} // namespace HLE
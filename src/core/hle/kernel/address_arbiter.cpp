@@ -18,58 +18,117 @@
 
 namespace Kernel {
 
+bool AddressArbiter::WaitsBefore(const WaitingThread& lhs, const WaitingThread& rhs) {
+    if (lhs.thread->current_priority != rhs.thread->current_priority) {
+        return lhs.thread->current_priority < rhs.thread->current_priority;
+    }
+    return lhs.sequence < rhs.sequence;
+}
+
+void AddressArbiter::InsertWaitingThread(WaitList& list, WaitingThread waiting_thread) {
+    auto itr = std::upper_bound(list.begin(), list.end(), waiting_thread, WaitsBefore);
+    list.insert(itr, std::move(waiting_thread));
+}
+
+void AddressArbiter::RemoveWaitingThread(const Thread& thread) {
+    auto itr = waiting_threads.find(thread.wait_address);
+    if (itr == waiting_threads.end()) {
+        return;
+    }
+    WaitList& list = itr->second;
+    list.erase(std::remove_if(list.begin(), list.end(),
+                              [&thread](const auto& waiting_thread) {
+                                  return waiting_thread.thread.get() == &thread;
+                              }),
+               list.end());
+    if (list.empty()) {
+        waiting_threads.erase(itr);
+    }
+}
+
+void AddressArbiter::ReorderWaitingThread(const Thread& thread) {
+    auto itr = waiting_threads.find(thread.wait_address);
+    if (itr == waiting_threads.end()) {
+        return;
+    }
+    WaitList& list = itr->second;
+    auto waiting_itr = std::find_if(list.begin(), list.end(), [&thread](const auto& waiting_thread) {
+        return waiting_thread.thread.get() == &thread;
+    });
+    if (waiting_itr == list.end()) {
+        return;
+    }
+    WaitingThread waiting_thread = std::move(*waiting_itr);
+    list.erase(waiting_itr);
+    InsertWaitingThread(list, std::move(waiting_thread));
+}
+
+void AddressArbiter::OnLoad() {
+    for (auto& [address, list] : waiting_threads) {
+        std::sort(list.begin(), list.end(), WaitsBefore);
+        for (auto& waiting_thread : list) {
+            waiting_thread.thread->waiting_arbiter = this;
+        }
+    }
+}
+
 void AddressArbiter::WaitThread(std::shared_ptr<Thread> thread, VAddr wait_address) {
     thread->wait_address = wait_address;
+    thread->waiting_arbiter = this;
     thread->status = ThreadStatus::WaitArb;
-    waiting_threads.emplace_back(std::move(thread));
+    InsertWaitingThread(waiting_threads[wait_address], {next_wait_sequence++, std::move(thread)});
 }
 
 void AddressArbiter::ResumeAllThreads(VAddr address) {
-    // Determine which threads are waiting on this address, those should be woken up.
-    auto itr = std::stable_partition(waiting_threads.begin(), waiting_threads.end(),
-                                     [address](const auto& thread) {
-                                         ASSERT_MSG(thread->status == ThreadStatus::WaitArb,
-                                                    "Inconsistent AddressArbiter state");
-                                         return thread->wait_address != address;
-                                     });
-
-    // Wake up all the found threads
-    std::for_each(itr, waiting_threads.end(), [](auto& thread) { thread->ResumeFromWait(); });
-
-    // Remove the woken up threads from the wait list.
-    waiting_threads.erase(itr, waiting_threads.end());
+    auto itr = waiting_threads.find(address);
+    if (itr == waiting_threads.end()) {
+        return;
+    }
+
+    // Take the list out first, as waking threads up must not observe it half-processed. The list
+    // is kept in priority order, so threads are woken up in the same order as they would be one
+    // by one.
+    WaitList list = std::move(itr->second);
+    waiting_threads.erase(itr);
+    for (auto& waiting_thread : list) {
+        ASSERT_MSG(waiting_thread.thread->status == ThreadStatus::WaitArb,
+                   "Inconsistent AddressArbiter state");
+        waiting_thread.thread->waiting_arbiter = nullptr;
+        waiting_thread.thread->ResumeFromWait();
+    }
 }
 
 std::shared_ptr<Thread> AddressArbiter::ResumeHighestPriorityThread(VAddr address) {
-    // Determine which threads are waiting on this address, those should be considered for wakeup.
-    auto matches_start = std::stable_partition(
-        waiting_threads.begin(), waiting_threads.end(), [address](const auto& thread) {
-            ASSERT_MSG(thread->status == ThreadStatus::WaitArb,
-                       "Inconsistent AddressArbiter state");
-            return thread->wait_address != address;
-        });
-
-    // Iterate through threads, find highest priority thread that is waiting to be arbitrated.
-    // Note: The real kernel will pick the first thread in the list if more than one have the
-    // same highest priority value. Lower priority values mean higher priority.
-    auto itr = std::min_element(matches_start, waiting_threads.end(),
-                                [](const auto& lhs, const auto& rhs) {
-                                    return lhs->current_priority < rhs->current_priority;
-                                });
-
-    if (itr == waiting_threads.end())
+    auto itr = waiting_threads.find(address);
+    if (itr == waiting_threads.end()) {
         return nullptr;
+    }
 
-    auto thread = *itr;
-    thread->ResumeFromWait();
+    // The lists are kept ordered by priority. Note: The real kernel will pick the first thread in
+    // the list if more than one have the same highest priority value, which is the one that
+    // started waiting first. Lower priority values mean higher priority.
+    WaitList& list = itr->second;
+    auto thread = std::move(list.front().thread);
+    list.pop_front();
+    if (list.empty()) {
+        waiting_threads.erase(itr);
+    }
 
-    waiting_threads.erase(itr);
+    ASSERT_MSG(thread->status == ThreadStatus::WaitArb, "Inconsistent AddressArbiter state");
+    thread->waiting_arbiter = nullptr;
+    thread->ResumeFromWait();
     return thread;
 }
 
 AddressArbiter::AddressArbiter(KernelSystem& kernel)
     : Object(kernel), kernel(kernel), timeout_callback(std::make_shared<Callback>(*this)) {}
-AddressArbiter::~AddressArbiter() {}
+AddressArbiter::~AddressArbiter() {
+    for (auto& [address, list] : waiting_threads) {
+        for (auto& waiting_thread : list) {
+            waiting_thread.thread->waiting_arbiter = nullptr;
+        }
+    }
+}
 
 std::shared_ptr<AddressArbiter> KernelSystem::CreateAddressArbiter(std::string name) {
     auto address_arbiter{std::make_shared<AddressArbiter>(*this)};
@@ -101,8 +160,8 @@ void AddressArbiter::WakeUp(ThreadWakeupReason reason, std::shared_ptr<Thread> t
                             std::shared_ptr<WaitObject> object) {
     ASSERT(reason == ThreadWakeupReason::Timeout);
     // Remove the newly-awakened thread from the Arbiter's waiting list.
-    waiting_threads.erase(std::remove(waiting_threads.begin(), waiting_threads.end(), thread),
-                          waiting_threads.end());
+    RemoveWaitingThread(*thread);
+    thread->waiting_arbiter = nullptr;
 };
 
 ResultCode AddressArbiter::ArbitrateAddress(std::shared_ptr<Thread> thread, ArbitrationType type,
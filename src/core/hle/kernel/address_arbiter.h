@@ -4,12 +4,16 @@
 
 #pragma once
 
+#include <deque>
 #include <memory>
+#include <unordered_map>
 #include <vector>
 #include <boost/serialization/base_object.hpp>
+#include <boost/serialization/deque.hpp>
 #include <boost/serialization/export.hpp>
 #include <boost/serialization/shared_ptr.hpp>
 #include <boost/serialization/string.hpp>
+#include <boost/serialization/unordered_map.hpp>
 #include <boost/serialization/vector.hpp>
 #include <boost/serialization/version.hpp>
 #include "common/common_types.h"
@@ -59,6 +63,9 @@ public:
     ResultCode ArbitrateAddress(std::shared_ptr<Thread> thread, ArbitrationType type, VAddr address,
                                 s32 value, u64 nanoseconds);
 
+    /// Moves a thread waiting on this arbiter to its place for its new current priority.
+    void ReorderWaitingThread(const Thread& thread);
+
     class Callback;
 
 private:
@@ -74,8 +81,36 @@ private:
     /// the resumed thread.
     std::shared_ptr<Thread> ResumeHighestPriorityThread(VAddr address);
 
-    /// Threads waiting for the address arbiter to be signaled.
-    std::vector<std::shared_ptr<Thread>> waiting_threads;
+    struct WaitingThread {
+        u64 sequence; ///< Order in which the thread started waiting on this arbiter
+        std::shared_ptr<Thread> thread;
+
+    private:
+        template <class Archive>
+        void serialize(Archive& ar, const unsigned int) {
+            ar& sequence;
+            ar& thread;
+        }
+        friend class boost::serialization::access;
+    };
+    using WaitList = std::deque<WaitingThread>;
+
+    /// Orders waiting threads by current priority, ties broken by the order they started waiting.
+    static bool WaitsBefore(const WaitingThread& lhs, const WaitingThread& rhs);
+
+    /// Inserts the thread in the wait list, keeping it ordered by priority and then by sequence.
+    static void InsertWaitingThread(WaitList& list, WaitingThread waiting_thread);
+
+    /// Removes the thread from the wait list of its arbitration address, if it is there.
+    void RemoveWaitingThread(const Thread& thread);
+
+    /// Threads waiting for the address arbiter to be signaled, keyed by arbitration address.
+    /// Each list is ordered by current priority, ties broken by the order in which threads
+    /// started waiting.
+    std::unordered_map<VAddr, WaitList> waiting_threads;
+
+    /// Sequence number to assign to the next waiting thread.
+    u64 next_wait_sequence = 0;
 
     std::shared_ptr<Callback> timeout_callback;
 
@@ -101,16 +136,35 @@ private:
             ar& boost::serialization::base_object<WakeupCallback>(x);
         }
         ar& name;
-        ar& waiting_threads;
+        if (file_version > 2) {
+            ar& waiting_threads;
+            ar& next_wait_sequence;
+        } else {
+            // Older versions kept every waiting thread in a single list, in waiting order.
+            std::vector<std::shared_ptr<Thread>> threads;
+            ar& threads;
+            waiting_threads.clear();
+            next_wait_sequence = 0;
+            for (auto& thread : threads) {
+                const VAddr address = thread->wait_address;
+                waiting_threads[address].push_back({next_wait_sequence++, std::move(thread)});
+            }
+        }
         if (file_version > 1) {
             ar& timeout_callback;
         }
+        if (Archive::is_loading::value) {
+            OnLoad();
+        }
     }
+
+    /// Orders the loaded wait lists by current priority and points their threads back to this.
+    void OnLoad();
 };
 
 } // namespace Kernel
 
 BOOST_CLASS_EXPORT_KEY(Kernel::AddressArbiter)
 BOOST_CLASS_EXPORT_KEY(Kernel::AddressArbiter::Callback)
-BOOST_CLASS_VERSION(Kernel::AddressArbiter, 2)
+BOOST_CLASS_VERSION(Kernel::AddressArbiter, 3)
 CONSTRUCT_KERNEL_OBJECT(Kernel::AddressArbiter)
@@ -89,6 +89,26 @@ public:
         return DynamicObjectCast<T>(GetGeneric(handle));
     }
 
+    /**
+     * Looks up a handle without taking a new reference to the object. The returned pointer is
+     * borrowed from the table (or the kernel, for pseudo-handles) and is only valid until the
+     * handle is closed, which makes it suitable for use within the SVC that received the handle.
+     * Callers that need to keep the object around must use `GetGeneric()` instead.
+     * @return Pointer to the looked-up object, or `nullptr` if the handle is not valid.
+     */
+    Object* GetGenericBorrowed(Handle handle) const;
+
+    /**
+     * Looks up a handle while verifying its type, without taking a new reference to the object.
+     * See `GetGenericBorrowed()` for the lifetime of the returned pointer.
+     * @return Pointer to the looked-up object, or `nullptr` if the handle is not valid or its
+     *         type differs from the requested one.
+     */
+    template <class T>
+    T* GetBorrowed(Handle handle) const {
+        return DynamicObjectCast<T>(GetGenericBorrowed(handle));
+    }
+
     /// Closes all handles held in this table.
     void Clear();
 
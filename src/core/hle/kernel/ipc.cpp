@@ -3,6 +3,7 @@
 // Refer to the license.txt file included.
 
 #include <algorithm>
+#include <cstring>
 #include "common/alignment.h"
 #include "common/memory_ref.h"
 #include "core/core.h"
@@ -18,6 +19,36 @@
 
 namespace Kernel {
 
+/**
+ * Returns the source memory backing a page-aligned mapped buffer, if its pages can be mapped
+ * directly into the target process instead of being copied. This requires the whole range to be
+ * plain memory belonging to a single VMA.
+ */
+static MemoryRef GetRemappableBuffer(const Process& process, VAddr address, u32 size) {
+    if ((address & Memory::PAGE_MASK) != 0 || (size & Memory::PAGE_MASK) != 0) {
+        return nullptr;
+    }
+
+    const auto vma_itr = process.vm_manager.FindVMA(address);
+    if (vma_itr == process.vm_manager.vma_map.end()) {
+        return nullptr;
+    }
+    const VirtualMemoryArea& vma = vma_itr->second;
+    if (vma.type != VMAType::BackingMemory || address + size > vma.base + vma.size) {
+        return nullptr;
+    }
+
+    // Pages cached by the rasterizer have to go through the copy path so they get flushed.
+    const auto& page_table = *process.vm_manager.page_table;
+    for (VAddr page = address; page < address + size; page += Memory::PAGE_SIZE) {
+        if (page_table.attributes[page >> Memory::PAGE_BITS] != Memory::PageType::Memory) {
+            return nullptr;
+        }
+    }
+
+    return vma.backing_memory + (address - vma.base);
+}
+
 ResultCode TranslateCommandBuffer(Kernel::KernelSystem& kernel, Memory::MemorySystem& memory,
                                   std::shared_ptr<Thread> src_thread,
                                   std::shared_ptr<Thread> dst_thread, VAddr src_address,
@@ -28,9 +59,12 @@ ResultCode TranslateCommandBuffer(Kernel::KernelSystem& kernel, Memory::MemorySy
     auto dst_process = dst_thread->owner_process.lock();
     ASSERT(src_process && dst_process);
 
+    std::array<u32, IPC::COMMAND_BUFFER_LENGTH> cmd_buf;
+
     IPC::Header header;
     // TODO(Subv): Replace by Memory::Read32 when possible.
     memory.ReadBlock(*src_process, src_address, &header.raw, sizeof(header.raw));
+    cmd_buf[0] = header.raw;
 
     std::size_t untranslated_size = 1u + header.normal_params_size;
     std::size_t command_size = untranslated_size + header.translate_params_size;
@@ -38,8 +72,9 @@ ResultCode TranslateCommandBuffer(Kernel::KernelSystem& kernel, Memory::MemorySy
     // Note: The real kernel does not check that the command length fits into the IPC buffer area.
     ASSERT(command_size <= IPC::COMMAND_BUFFER_LENGTH);
 
-    std::array<u32, IPC::COMMAND_BUFFER_LENGTH> cmd_buf;
-    memory.ReadBlock(*src_process, src_address, cmd_buf.data(), command_size * sizeof(u32));
+    // The header was already read above, only fetch the parameters that follow it.
+    memory.ReadBlock(*src_process, src_address + sizeof(u32), cmd_buf.data() + 1,
+                     (command_size - 1) * sizeof(u32));
 
     const bool should_record = kernel.GetIPCRecorder().IsEnabled();
 
@@ -100,9 +135,7 @@ ResultCode TranslateCommandBuffer(Kernel::KernelSystem& kernel, Memory::MemorySy
         case IPC::DescriptorType::StaticBuffer: {
             IPC::StaticBufferDescInfo bufferInfo{descriptor};
             VAddr static_buffer_src_address = cmd_buf[i];
-
-            std::vector<u8> data(bufferInfo.size);
-            memory.ReadBlock(*src_process, static_buffer_src_address, data.data(), data.size());
+            const u32 data_size = bufferInfo.size;
 
             // Grab the address that the target thread set up to receive the response static buffer
             // and write our data there. The static buffers area is located right after the command
@@ -123,10 +156,10 @@ ResultCode TranslateCommandBuffer(Kernel::KernelSystem& kernel, Memory::MemorySy
 
             // Note: The real kernel doesn't seem to have any error recovery mechanisms for this
             // case.
-            ASSERT_MSG(target_buffer.descriptor.size >= data.size(),
-                       "Static buffer data is too big");
+            ASSERT_MSG(target_buffer.descriptor.size >= data_size, "Static buffer data is too big");
 
-            memory.WriteBlock(*dst_process, target_buffer.address, data.data(), data.size());
+            memory.CopyBlock(*dst_process, *src_process, target_buffer.address,
+                             static_buffer_src_address, data_size);
 
             cmd_buf[i++] = target_buffer.address;
             break;
@@ -164,11 +197,18 @@ ResultCode TranslateCommandBuffer(Kernel::KernelSystem& kernel, Memory::MemorySy
                 ASSERT(found != mapped_buffer_context.end());
 
                 if (permissions != IPC::MappedBufferPermissions::R) {
-                    // Copy the modified buffer back into the target process
-                    // NOTE: As this is a reply the "source" is the destination and the
-                    //       "target" is the source.
-                    memory.CopyBlock(*dst_process, *src_process, found->source_address,
-                                     found->target_address, size);
+                    if (found->buffer) {
+                        // Copy the modified buffer back into the target process
+                        // NOTE: As this is a reply the "source" is the destination and the
+                        //       "target" is the source.
+                        memory.CopyBlock(*dst_process, *src_process, found->source_address,
+                                         found->target_address, size);
+                    } else {
+                        // The pages were shared, so the data is already in place. Only make sure
+                        // the rasterizer doesn't keep stale copies of them.
+                        Memory::RasterizerFlushVirtualRegion(found->source_address, size,
+                                                             Memory::FlushMode::Invalidate);
+                    }
                 }
 
                 VAddr prev_reserve = page_start - Memory::PAGE_SIZE;
@@ -184,6 +224,7 @@ ResultCode TranslateCommandBuffer(Kernel::KernelSystem& kernel, Memory::MemorySy
                     page_start - Memory::PAGE_SIZE, (num_pages + 2) * Memory::PAGE_SIZE);
                 ASSERT(result == RESULT_SUCCESS);
 
+                kernel.ReleaseIPCBuffer(std::move(found->buffer));
                 mapped_buffer_context.erase(found);
 
                 i += 1;
@@ -194,23 +235,39 @@ ResultCode TranslateCommandBuffer(Kernel::KernelSystem& kernel, Memory::MemorySy
 
             // TODO(Subv): Perform permission checks.
 
-            // Reserve a page of memory before the mapped buffer
-            std::shared_ptr<BackingMem> reserve_buffer =
-                std::make_shared<BufferMem>(Memory::PAGE_SIZE);
+            // Reserve a page of memory before the mapped buffer. The contents of the guard pages
+            // are never used, so every mapping shares the same one.
+            std::shared_ptr<BackingMem> reserve_buffer = kernel.GetIPCReservePage();
             dst_process->vm_manager.MapBackingMemoryToBase(
                 Memory::IPC_MAPPING_VADDR, Memory::IPC_MAPPING_SIZE, reserve_buffer,
                 Memory::PAGE_SIZE, Kernel::MemoryState::Reserved);
 
-            std::shared_ptr<BackingMem> buffer =
-                std::make_shared<BufferMem>(num_pages * Memory::PAGE_SIZE);
-            memory.ReadBlock(*src_process, source_address, buffer->GetPtr() + page_offset, size);
+            // Page-aligned buffers the target may write to are shared with it directly. Otherwise,
+            // the data is copied into a pooled buffer so the target can't see the rest of the
+            // pages, and can't modify read-only buffers.
+            std::shared_ptr<BackingMem> buffer = nullptr;
+            MemoryRef buffer_memory = nullptr;
+            if (permissions != IPC::MappedBufferPermissions::R) {
+                buffer_memory = GetRemappableBuffer(*src_process, source_address, size);
+            }
+            if (!buffer_memory) {
+                const std::size_t buffer_size = num_pages * Memory::PAGE_SIZE;
+                auto buffer_mem = kernel.AcquireIPCBuffer(buffer_size);
+                u8* data = buffer_mem->GetPtr();
+                std::memset(data, 0, page_offset);
+                memory.ReadBlock(*src_process, source_address, data + page_offset, size);
+                std::memset(data + page_offset + size, 0, buffer_size - page_offset - size);
+                buffer = std::move(buffer_mem);
+                buffer_memory = buffer;
+            }
 
             // Map the page(s) into the target process' address space.
-            target_address =
-                dst_process->vm_manager
-                    .MapBackingMemoryToBase(Memory::IPC_MAPPING_VADDR, Memory::IPC_MAPPING_SIZE,
-                                            buffer, buffer->GetSize(), Kernel::MemoryState::Shared)
-                    .Unwrap();
+            target_address = dst_process->vm_manager
+                                 .MapBackingMemoryToBase(Memory::IPC_MAPPING_VADDR,
+                                                         Memory::IPC_MAPPING_SIZE, buffer_memory,
+                                                         num_pages * Memory::PAGE_SIZE,
+                                                         Kernel::MemoryState::Shared)
+                                 .Unwrap();
 
             cmd_buf[i++] = target_address + page_offset;
 
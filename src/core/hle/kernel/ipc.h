@@ -20,6 +20,8 @@ namespace Kernel {
 class KernelSystem;
 
 struct MappedBufferContext {
+    // Note: buffer is null when the source pages were mapped directly into the target process
+    // instead of being copied.
     IPC::MappedBufferPermissions permissions;
     u32 size;
     VAddr source_address;
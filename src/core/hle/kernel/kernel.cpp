@@ -37,6 +37,7 @@ KernelSystem::KernelSystem(Memory::MemorySystem& memory, Core::Timing& timing,
     }
     timer_manager = std::make_unique<TimerManager>(timing);
     ipc_recorder = std::make_unique<IPCDebugger::Recorder>();
+    ipc_reserve_page = std::make_shared<BufferMem>(Memory::PAGE_SIZE);
     stored_processes.assign(num_cores, nullptr);
 
     next_thread_id = 1;
@@ -144,6 +145,33 @@ const IPCDebugger::Recorder& KernelSystem::GetIPCRecorder() const {
     return *ipc_recorder;
 }
 
+std::shared_ptr<BackingMem> KernelSystem::GetIPCReservePage() const {
+    return ipc_reserve_page;
+}
+
+std::shared_ptr<BufferMem> KernelSystem::AcquireIPCBuffer(std::size_t size) {
+    auto& buffers = ipc_buffer_pool[size];
+    if (buffers.empty()) {
+        return std::make_shared<BufferMem>(size);
+    }
+    auto buffer = std::move(buffers.back());
+    buffers.pop_back();
+    return buffer;
+}
+
+void KernelSystem::ReleaseIPCBuffer(std::shared_ptr<BackingMem> buffer) {
+    // Only a few buffers of each size are kept, requests rarely have more in flight at once.
+    constexpr std::size_t MaxPooledBuffersPerSize = 4;
+    auto buffer_mem = std::dynamic_pointer_cast<BufferMem>(std::move(buffer));
+    if (!buffer_mem || buffer_mem.use_count() != 1) {
+        return;
+    }
+    auto& buffers = ipc_buffer_pool[buffer_mem->GetSize()];
+    if (buffers.size() < MaxPooledBuffersPerSize) {
+        buffers.push_back(std::move(buffer_mem));
+    }
+}
+
 void KernelSystem::AddNamedPort(std::string name, std::shared_ptr<ClientPort> port) {
     named_ports.emplace(std::move(name), std::move(port));
 }
@@ -211,6 +211,12 @@ public:
     std::shared_ptr<Process> GetProcessById(u32 process_id) const;
 
     std::shared_ptr<Process> GetCurrentProcess() const;
+
+    /// Returns the current process without taking a new reference to it. The pointer is only valid
+    /// until the current process changes.
+    Process* GetCurrentProcessBorrowed() const {
+        return current_process.get();
+    }
     void SetCurrentProcess(std::shared_ptr<Process> process);
     void SetCurrentProcessForCPU(std::shared_ptr<Process> process, u32 core_id);
 
@@ -237,6 +243,18 @@ public:
     IPCDebugger::Recorder& GetIPCRecorder();
     const IPCDebugger::Recorder& GetIPCRecorder() const;
 
+    /// Returns the page used to back the reserved guard pages around IPC mapped buffers.
+    std::shared_ptr<BackingMem> GetIPCReservePage() const;
+
+    /**
+     * Returns a buffer of the given size to back a copied IPC mapped buffer, reusing one released
+     * by an earlier request when possible. Its contents are unspecified.
+     */
+    std::shared_ptr<BufferMem> AcquireIPCBuffer(std::size_t size);
+
+    /// Returns a buffer from AcquireIPCBuffer to the pool, if nothing else references it anymore.
+    void ReleaseIPCBuffer(std::shared_ptr<BackingMem> buffer);
+
     std::shared_ptr<MemoryRegionInfo> GetMemoryRegion(MemoryRegion region);
 
     void HandleSpecialMapping(VMManager& address_space, const AddressMapping& mapping);
@@ -297,6 +315,11 @@ private:
 
     std::unique_ptr<IPCDebugger::Recorder> ipc_recorder;
 
+    std::shared_ptr<BackingMem> ipc_reserve_page;
+
+    /// Released IPC mapped buffers, keyed by size.
+    std::unordered_map<std::size_t, std::vector<std::shared_ptr<BufferMem>>> ipc_buffer_pool;
+
     u32 next_thread_id;
 
     friend class boost::serialization::access;
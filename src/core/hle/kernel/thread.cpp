@@ -4,7 +4,6 @@
 
 #include <algorithm>
 #include <list>
-#include <unordered_map>
 #include <vector>
 #include <boost/serialization/string.hpp>
 #include "common/archives.h"
@@ -16,6 +15,7 @@
 #include "core/arm/arm_interface.h"
 #include "core/arm/skyeye_common/armstate.h"
 #include "core/core.h"
+#include "core/hle/kernel/address_arbiter.h"
 #include "core/hle/kernel/errors.h"
 #include "core/hle/kernel/handle_table.h"
 #include "core/hle/kernel/kernel.h"
@@ -41,6 +41,11 @@ void Thread::serialize(Archive& ar, const unsigned int file_version) {
     ar& nominal_priority;
     ar& current_priority;
     ar& last_running_ticks;
+    if (file_version > 0) {
+        ar& last_scheduled_ticks;
+        ar& run_ticks;
+        ar& context_switch_count;
+    }
     ar& processor_id;
     ar& tls_address;
     ar& held_mutexes;
@@ -59,6 +64,16 @@ void Thread::serialize(Archive& ar, const unsigned int file_version) {
     ar& wait_address;
     ar& name;
     ar& wakeup_callback;
+    if (file_version > 0) {
+        ar& wakeup_slot;
+        ar& wakeup_scheduled;
+    } else if (Archive::is_loading::value) {
+        // Older versions used the thread ID as the userdata of wakeup events, so keep it as the
+        // slot for the events still queued. Whether one is queued is unknown, but unscheduling
+        // an event that doesn't exist is harmless.
+        wakeup_slot = thread_id;
+        wakeup_scheduled = status != ThreadStatus::Dead;
+    }
 }
 
 SERIALIZE_IMPL(Thread)
@@ -82,8 +97,12 @@ Thread* ThreadManager::GetCurrentThread() const {
 
 void Thread::Stop() {
     // Cancel any outstanding wakeup events for this thread
-    thread_manager.kernel.timing.UnscheduleEvent(thread_manager.ThreadWakeupEventType, thread_id);
-    thread_manager.wakeup_callback_table.erase(thread_id);
+    if (wakeup_scheduled) {
+        thread_manager.kernel.timing.UnscheduleEvent(thread_manager.ThreadWakeupEventType,
+                                                     wakeup_slot);
+        wakeup_scheduled = false;
+    }
+    thread_manager.FreeWakeupSlot(this);
 
     // Clean up thread from ready queue
     // This is only needed when the thread is termintated forcefully (SVC TerminateProcess)
@@ -122,6 +141,8 @@ void ThreadManager::SwitchContext(Thread* new_thread) {
     if (previous_thread) {
         previous_process = previous_thread->owner_process.lock();
         previous_thread->last_running_ticks = cpu->GetTimer().GetTicks();
+        previous_thread->run_ticks +=
+            previous_thread->last_running_ticks - previous_thread->last_scheduled_ticks;
         cpu->SaveContext(previous_thread->context);
 
         if (previous_thread->status == ThreadStatus::Running) {
@@ -138,7 +159,16 @@ void ThreadManager::SwitchContext(Thread* new_thread) {
                    "Thread must be ready to become running.");
 
         // Cancel any outstanding wakeup events for this thread
-        timing.UnscheduleEvent(ThreadWakeupEventType, new_thread->thread_id);
+        if (new_thread->wakeup_scheduled) {
+            timing.UnscheduleEvent(ThreadWakeupEventType, new_thread->wakeup_slot);
+            new_thread->wakeup_scheduled = false;
+        }
+
+        if (new_thread != previous_thread) {
+            ++new_thread->context_switch_count;
+            ++context_switch_count;
+        }
+        new_thread->last_scheduled_ticks = cpu->GetTimer().GetTicks();
 
         current_thread = SharedFrom(new_thread);
 
@@ -191,12 +221,14 @@ void ThreadManager::ExitCurrentThread() {
                       thread_list.end());
 }
 
-void ThreadManager::ThreadWakeupCallback(u64 thread_id, s64 cycles_late) {
-    std::shared_ptr<Thread> thread = SharedFrom(wakeup_callback_table.at(thread_id));
+void ThreadManager::ThreadWakeupCallback(u64 wakeup_slot, s64 cycles_late) {
+    std::shared_ptr<Thread> thread =
+        wakeup_slot < wakeup_slots.size() ? SharedFrom(wakeup_slots[wakeup_slot]) : nullptr;
     if (thread == nullptr) {
-        LOG_CRITICAL(Kernel, "Callback fired for invalid thread {:08X}", thread_id);
+        LOG_CRITICAL(Kernel, "Callback fired for invalid wakeup slot {}", wakeup_slot);
         return;
     }
+    thread->wakeup_scheduled = false;
 
     if (thread->status == ThreadStatus::WaitSynchAny ||
         thread->status == ThreadStatus::WaitSynchAll || thread->status == ThreadStatus::WaitArb ||
@@ -220,8 +252,13 @@ void Thread::WakeAfterDelay(s64 nanoseconds) {
     if (nanoseconds == -1)
         return;
 
-    thread_manager.kernel.timing.ScheduleEvent(nsToCycles(nanoseconds),
-                                               thread_manager.ThreadWakeupEventType, thread_id);
+    Core::Timing& timing = thread_manager.kernel.timing;
+    if (wakeup_scheduled) {
+        timing.UnscheduleEvent(thread_manager.ThreadWakeupEventType, wakeup_slot);
+    }
+    timing.ScheduleEvent(nsToCycles(nanoseconds), thread_manager.ThreadWakeupEventType,
+                         wakeup_slot);
+    wakeup_scheduled = true;
 }
 
 void Thread::ResumeFromWait() {
@@ -348,7 +385,6 @@ ResultVal<std::shared_ptr<Thread>> KernelSystem::CreateThread(
     auto thread{std::make_shared<Thread>(*this, processor_id)};
 
     thread_managers[processor_id]->thread_list.push_back(thread);
-    thread_managers[processor_id]->ready_queue.prepare(priority);
 
     thread->thread_id = NewThreadId();
     thread->status = ThreadStatus::Dormant;
@@ -360,7 +396,7 @@ ResultVal<std::shared_ptr<Thread>> KernelSystem::CreateThread(
     thread->wait_objects.clear();
     thread->wait_address = 0;
     thread->name = std::move(name);
-    thread_managers[processor_id]->wakeup_callback_table[thread->thread_id] = thread.get();
+    thread->wakeup_slot = thread_managers[processor_id]->AllocateWakeupSlot(thread.get());
     thread->owner_process = owner_process;
 
     // Find the next available TLS index, and mark it as used
@@ -415,12 +451,14 @@ void Thread::SetPriority(u32 priority) {
     ASSERT_MSG(priority <= ThreadPrioLowest && priority >= ThreadPrioHighest,
                "Invalid priority value.");
     // If thread was ready, adjust queues
+    const bool reorder_arbiter = status == ThreadStatus::WaitArb && waiting_arbiter &&
+                                 priority != current_priority;
     if (status == ThreadStatus::Ready)
         thread_manager.ready_queue.move(this, current_priority, priority);
-    else
-        thread_manager.ready_queue.prepare(priority);
 
     nominal_priority = current_priority = priority;
+    if (reorder_arbiter)
+        waiting_arbiter->ReorderWaitingThread(*this);
 }
 
 void Thread::UpdatePriority() {
@@ -434,11 +472,13 @@ void Thread::UpdatePriority() {
 
 void Thread::BoostPriority(u32 priority) {
     // If thread was ready, adjust queues
+    const bool reorder_arbiter = status == ThreadStatus::WaitArb && waiting_arbiter &&
+                                 priority != current_priority;
     if (status == ThreadStatus::Ready)
         thread_manager.ready_queue.move(this, current_priority, priority);
-    else
-        thread_manager.ready_queue.prepare(priority);
     current_priority = priority;
+    if (reorder_arbiter)
+        waiting_arbiter->ReorderWaitingThread(*this);
 }
 
 std::shared_ptr<Thread> SetupMainThread(KernelSystem& kernel, u32 entry_point, u32 priority,
@@ -500,10 +540,30 @@ VAddr Thread::GetCommandBufferAddress() const {
     return GetTLSAddress() + command_header_offset;
 }
 
+u32 ThreadManager::AllocateWakeupSlot(Thread* thread) {
+    if (free_wakeup_slots.empty()) {
+        wakeup_slots.push_back(thread);
+        return static_cast<u32>(wakeup_slots.size() - 1);
+    }
+    const u32 slot = free_wakeup_slots.back();
+    free_wakeup_slots.pop_back();
+    wakeup_slots[slot] = thread;
+    return slot;
+}
+
+void ThreadManager::FreeWakeupSlot(Thread* thread) {
+    const u32 slot = thread->wakeup_slot;
+    if (slot >= wakeup_slots.size() || wakeup_slots[slot] != thread) {
+        return;
+    }
+    wakeup_slots[slot] = nullptr;
+    free_wakeup_slots.push_back(slot);
+}
+
 ThreadManager::ThreadManager(Kernel::KernelSystem& kernel, u32 core_id) : kernel(kernel) {
     ThreadWakeupEventType = kernel.timing.RegisterEvent(
         "ThreadWakeupCallback_" + std::to_string(core_id),
-        [this](u64 thread_id, s64 cycle_late) { ThreadWakeupCallback(thread_id, cycle_late); });
+        [this](u64 wakeup_slot, s64 cycle_late) { ThreadWakeupCallback(wakeup_slot, cycle_late); });
 }
 
 ThreadManager::~ThreadManager() {
@@ -23,6 +23,7 @@
 
 namespace Kernel {
 
+class AddressArbiter;
 class Mutex;
 class Process;
 
@@ -115,6 +116,13 @@ public:
      */
     const std::vector<std::shared_ptr<Thread>>& GetThreadList();
 
+    /**
+     * Returns the number of context switches performed on this core, for profiling purposes
+     */
+    u64 GetContextSwitchCount() const {
+        return context_switch_count;
+    }
+
     void SetCPU(ARM_Interface& cpu) {
         this->cpu = &cpu;
     }
@@ -141,14 +149,34 @@ private:
      * @param thread_id The ID of the thread that's been awoken
      * @param cycles_late The number of CPU cycles that have passed since the desired wakeup time
      */
-    void ThreadWakeupCallback(u64 thread_id, s64 cycles_late);
+    void ThreadWakeupCallback(u64 wakeup_slot, s64 cycles_late);
+
+    /**
+     * Reserves a slot in the wakeup table for the specified thread
+     * @param thread The thread the slot will refer to
+     * @return The index of the reserved slot, used as the userdata of the thread's wakeup event
+     */
+    u32 AllocateWakeupSlot(Thread* thread);
+
+    /**
+     * Releases the wakeup slot reserved for the specified thread, if it still holds one
+     * @param thread The thread whose slot will be released
+     */
+    void FreeWakeupSlot(Thread* thread);
 
     Kernel::KernelSystem& kernel;
     ARM_Interface* cpu;
 
     std::shared_ptr<Thread> current_thread;
-    Common::ThreadQueueList<Thread*, ThreadPrioLowest + 1> ready_queue;
-    std::unordered_map<u64, Thread*> wakeup_callback_table;
+    Common::ThreadQueueList<Thread, ThreadPrioLowest + 1> ready_queue;
+
+    /// Threads indexed by their wakeup slot. Freed slots are nullptr and listed in
+    /// free_wakeup_slots so they can be reused.
+    std::vector<Thread*> wakeup_slots;
+    std::vector<u32> free_wakeup_slots;
+
+    /// Number of context switches performed on this core
+    u64 context_switch_count = 0;
 
     /// Event type for the thread wake up event
     Core::TimingEventType* ThreadWakeupEventType = nullptr;
@@ -164,12 +192,33 @@ private:
     void serialize(Archive& ar, const unsigned int file_version) {
         ar& current_thread;
         ar& ready_queue;
-        ar& wakeup_callback_table;
+        if (file_version > 0) {
+            ar& wakeup_slots;
+            ar& free_wakeup_slots;
+            ar& context_switch_count;
+        } else if (Archive::is_loading::value) {
+            // Older versions looked threads up by ID instead, see Thread::serialize
+            std::unordered_map<u64, Thread*> wakeup_callback_table;
+            ar& wakeup_callback_table;
+            wakeup_slots.clear();
+            free_wakeup_slots.clear();
+            for (const auto& [thread_id, thread] : wakeup_callback_table) {
+                if (thread_id >= wakeup_slots.size()) {
+                    wakeup_slots.resize(thread_id + 1);
+                }
+                wakeup_slots[thread_id] = thread;
+            }
+            for (u32 slot = 0; slot < wakeup_slots.size(); ++slot) {
+                if (wakeup_slots[slot] == nullptr) {
+                    free_wakeup_slots.push_back(slot);
+                }
+            }
+        }
         ar& thread_list;
     }
 };
 
-class Thread final : public WaitObject {
+class Thread final : public WaitObject, public Common::ThreadQueueListNode<Thread> {
 public:
     explicit Thread(KernelSystem&, u32 core_id);
     ~Thread() override;
@@ -296,7 +345,10 @@ public:
     u32 nominal_priority; ///< Nominal thread priority, as set by the emulated application
     u32 current_priority; ///< Current thread priority, can be temporarily changed
 
-    u64 last_running_ticks; ///< CPU tick when thread was last running
+    u64 last_running_ticks;       ///< CPU tick when thread was last running
+    u64 last_scheduled_ticks = 0; ///< CPU tick when thread was last switched in
+    u64 run_ticks = 0;            ///< Total CPU ticks this thread has spent running
+    u64 context_switch_count = 0; ///< Number of times this thread has been switched in
 
     s32 processor_id;
 
@@ -316,6 +368,9 @@ public:
 
     VAddr wait_address; ///< If waiting on an AddressArbiter, this is the arbitration address
 
+    /// Arbiter the thread is waiting on, if any. Not serialized, the arbiter restores it on load.
+    AddressArbiter* waiting_arbiter = nullptr;
+
     std::string name{};
 
     // Callback that will be invoked when the thread is resumed from a waiting state. If the thread
@@ -328,6 +383,12 @@ public:
 private:
     ThreadManager& thread_manager;
 
+    u32 wakeup_slot = 0;           ///< Index of this thread in the wakeup table of its manager
+    bool wakeup_scheduled = false; ///< Whether a wakeup event is pending for this thread
+
+    friend class ThreadManager;
+    friend class KernelSystem;
+
     friend class boost::serialization::access;
     template <class Archive>
     void serialize(Archive& ar, const unsigned int file_version);
@@ -347,6 +408,8 @@ std::shared_ptr<Thread> SetupMainThread(KernelSystem& kernel, u32 entry_point, u
 } // namespace Kernel
 
 BOOST_CLASS_EXPORT_KEY(Kernel::Thread)
+BOOST_CLASS_VERSION(Kernel::Thread, 1)
+BOOST_CLASS_VERSION(Kernel::ThreadManager, 1)
 
 namespace boost::serialization {
 
@@ -3,16 +3,27 @@
 // Refer to the license.txt file included.
 
 #include <algorithm>
+#include <chrono>
 #include <cinttypes>
+#include <condition_variable>
 #include <cstddef>
 #include <cstring>
-#include <cryptopp/aes.h>
-#include <cryptopp/modes.h>
+#include <deque>
+#include <future>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <cryptopp/sha.h>
 #include <fmt/format.h>
+#include "common/common_funcs.h"
 #include "common/common_paths.h"
 #include "common/file_util.h"
+#include "common/hash.h"
 #include "common/logging/log.h"
+#include "common/scope_exit.h"
 #include "common/string_util.h"
+#include "common/swap.h"
+#include "common/thread.h"
 #include "core/core.h"
 #include "core/file_sys/errors.h"
 #include "core/file_sys/ncch_container.h"
@@ -32,6 +43,7 @@
 #include "core/hle/service/am/am_u.h"
 #include "core/hle/service/fs/archive.h"
 #include "core/hle/service/fs/fs_user.h"
+#include "core/hw/aes/cipher.h"
 #include "core/loader/loader.h"
 #include "core/loader/smdh.h"
 
@@ -78,9 +90,60 @@ struct TicketInfo {
 
 static_assert(sizeof(TicketInfo) == 0x18, "Ticket info structure size is wrong");
 
+/// Size of the chunks content data is passed between the install stages in
+constexpr std::size_t InstallChunkSize = 1024 * 1024;
+/// Number of chunks a stage of a content install may get ahead of the next one
+constexpr std::size_t InstallQueueDepth = 4;
+/// Maximum number of contents installed at once, more would only make the disk seek around
+constexpr std::size_t MaxConcurrentContentInstalls = 4;
+
+/**
+ * Bounded queue of content data chunks connecting two stages of a content install. Either side
+ * may close the queue: the producer once it is done, or the consumer to make the producer stop.
+ */
+class ChunkQueue {
+public:
+    /// Blocks while the queue is full. Returns false if the queue has been closed.
+    bool Push(std::vector<u8>&& chunk) {
+        std::unique_lock lock{mutex};
+        cv.wait(lock, [this] { return chunks.size() < InstallQueueDepth || closed; });
+        if (closed) {
+            return false;
+        }
+        chunks.push_back(std::move(chunk));
+        cv.notify_all();
+        return true;
+    }
+
+    /// Blocks until a chunk is available. Returns false once the queue is closed and empty.
+    bool Pop(std::vector<u8>& chunk) {
+        std::unique_lock lock{mutex};
+        cv.wait(lock, [this] { return !chunks.empty() || closed; });
+        if (chunks.empty()) {
+            return false;
+        }
+        chunk = std::move(chunks.front());
+        chunks.pop_front();
+        cv.notify_all();
+        return true;
+    }
+
+    void Close() {
+        std::lock_guard lock{mutex};
+        closed = true;
+        cv.notify_all();
+    }
+
+private:
+    std::mutex mutex;
+    std::condition_variable cv;
+    std::deque<std::vector<u8>> chunks;
+    bool closed = false;
+};
+
 class CIAFile::DecryptionState {
 public:
-    std::vector<CryptoPP::CBC_Mode<CryptoPP::AES>::Decryption> content;
+    std::vector<HW::AES::CBCDecryptor> content;
 };
 
 CIAFile::CIAFile(Service::FS::MediaType media_type)
@@ -135,11 +198,9 @@ ResultCode CIAFile::WriteTitleMetadata() {
     content_written.resize(content_count);
 
     if (auto title_key = container.GetTicket().GetTitleKey()) {
-        decryption_state->content.resize(content_count);
+        decryption_state->content.clear();
         for (std::size_t i = 0; i < content_count; ++i) {
-            auto ctr = tmd.GetContentCTRByIndex(i);
-            decryption_state->content[i].SetKeyWithIV(title_key->data(), title_key->size(),
-                                                      ctr.data());
+            decryption_state->content.emplace_back(*title_key, tmd.GetContentCTRByIndex(i));
         }
     }
 
@@ -179,18 +240,24 @@ ResultVal<std::size_t> CIAFile::WriteContentData(u64 offset, std::size_t length,
                 return FileSys::ERROR_INSUFFICIENT_SPACE;
             }
 
-            std::vector<u8> temp(buffer + (range_min - offset),
-                                 buffer + (range_min - offset) + available_to_write);
+            const u8* content_data = buffer + (range_min - offset);
 
+            // The guest may split its writes anywhere, so the decryptor can hold back the end of
+            // an incomplete block until the next write
             if ((tmd.GetContentTypeByIndex(i) & FileSys::TMDContentTypeFlag::Encrypted) != 0) {
-                decryption_state->content[i].ProcessData(temp.data(), temp.data(), temp.size());
+                std::vector<u8> temp;
+                decryption_state->content[i].Process(content_data, available_to_write, temp);
+                file.WriteBytes(temp.data(), temp.size());
+            } else {
+                file.WriteBytes(content_data, available_to_write);
             }
 
-            file.WriteBytes(temp.data(), temp.size());
-
             // Keep tabs on how much of this content ID has been written so new range_min
             // values can be calculated.
             content_written[i] += available_to_write;
+            if (content_written[i] == size && decryption_state->content[i].GetPendingSize() != 0) {
+                LOG_ERROR(Service_AM, "Content {} doesn't end on an AES block boundary", i);
+            }
             LOG_DEBUG(Service_AM, "Wrote {:x} to content {}, total {:x}", available_to_write, i,
                       content_written[i]);
         }
@@ -270,6 +337,157 @@ ResultVal<std::size_t> CIAFile::Write(u64 offset, std::size_t length, bool flush
     return MakeResult<std::size_t>(length);
 }
 
+ResultCode CIAFile::InstallContents(const std::string& path,
+                                    const std::function<ProgressCallback>& update_callback) {
+    if (install_state != CIAInstallState::TMDLoaded) {
+        return FileSys::ERROR_NOT_FOUND;
+    }
+
+    const std::size_t content_count = container.GetTitleMetadata().GetContentCount();
+    if (content_count == 0) {
+        return RESULT_SUCCESS;
+    }
+    u64 total_size = 0;
+    for (std::size_t i = 0; i < content_count; i++) {
+        total_size += container.GetContentSize(i) - content_written[i];
+    }
+
+    std::atomic<std::size_t> next_content = 0;
+    std::atomic<u64> progress = 0;
+    const auto worker = [&]() -> ResultCode {
+        Common::SetCurrentThreadName("CIAInstall");
+        ResultCode result = RESULT_SUCCESS;
+        for (std::size_t i = next_content++; i < content_count; i = next_content++) {
+            const ResultCode content_result = InstallContent(path, i, progress);
+            if (content_result.IsError() && result.IsSuccess()) {
+                result = content_result;
+            }
+        }
+        return result;
+    };
+
+    const std::size_t worker_count =
+        std::clamp<std::size_t>(std::thread::hardware_concurrency(), 1,
+                                std::min(content_count, MaxConcurrentContentInstalls));
+    std::vector<std::future<ResultCode>> workers;
+    for (std::size_t i = 0; i < worker_count; i++) {
+        workers.push_back(std::async(std::launch::async, worker));
+    }
+
+    // Progress is reported from the calling thread, as the callback doesn't need to be thread-safe
+    ResultCode result = RESULT_SUCCESS;
+    for (auto& future : workers) {
+        while (future.wait_for(std::chrono::milliseconds(100)) != std::future_status::ready) {
+            if (update_callback) {
+                update_callback(static_cast<std::size_t>(progress.load()),
+                                static_cast<std::size_t>(total_size));
+            }
+        }
+        const ResultCode worker_result = future.get();
+        if (worker_result.IsError() && result.IsSuccess()) {
+            result = worker_result;
+        }
+    }
+    if (update_callback) {
+        update_callback(static_cast<std::size_t>(progress.load()),
+                        static_cast<std::size_t>(total_size));
+    }
+    return result;
+}
+
+ResultCode CIAFile::InstallContent(const std::string& path, std::size_t index,
+                                   std::atomic<u64>& progress) {
+    const FileSys::TitleMetadata& tmd = container.GetTitleMetadata();
+    const u64 size = container.GetContentSize(index);
+    const bool is_encrypted =
+        (tmd.GetContentTypeByIndex(index) & FileSys::TMDContentTypeFlag::Encrypted) != 0;
+    if (content_written[index] != 0) {
+        LOG_ERROR(Service_AM, "Content {} was already partially written", index);
+        return FileSys::ERROR_ALREADY_EXISTS;
+    }
+
+    ChunkQueue read_queue;
+    ChunkQueue write_queue;
+
+    auto reader = std::async(std::launch::async, [&]() -> bool {
+        Common::SetCurrentThreadName("CIAInstallRead");
+        SCOPE_EXIT({ read_queue.Close(); });
+        FileUtil::IOFile file(path, "rb");
+        if (!file.IsOpen() || !file.Seek(container.GetContentOffset(index), SEEK_SET)) {
+            return false;
+        }
+        for (u64 remaining = size; remaining != 0;) {
+            std::vector<u8> chunk(
+                static_cast<std::size_t>(std::min<u64>(remaining, InstallChunkSize)));
+            if (file.ReadBytes(chunk.data(), chunk.size()) != chunk.size()) {
+                return false;
+            }
+            remaining -= chunk.size();
+            if (!read_queue.Push(std::move(chunk))) {
+                return true; // The install failed further down the pipeline
+            }
+        }
+        return true;
+    });
+
+    auto writer = std::async(std::launch::async, [&]() -> bool {
+        Common::SetCurrentThreadName("CIAInstallWrite");
+        SCOPE_EXIT({ write_queue.Close(); });
+        FileUtil::IOFile file(GetTitleContentPath(media_type, tmd.GetTitleID(), index, is_update),
+                              "wb");
+        if (!file.IsOpen()) {
+            return false;
+        }
+        std::vector<u8> chunk;
+        while (write_queue.Pop(chunk)) {
+            if (file.WriteBytes(chunk.data(), chunk.size()) != chunk.size()) {
+                return false;
+            }
+            content_written[index] += chunk.size();
+            progress += chunk.size();
+        }
+        return true;
+    });
+
+    // Decrypt and hash on this thread, so the CPU bound stage of each content gets its own core
+    CryptoPP::SHA256 sha;
+    std::vector<u8> chunk;
+    std::vector<u8> decrypted;
+    while (read_queue.Pop(chunk)) {
+        if (is_encrypted) {
+            decryption_state->content[index].Process(chunk.data(), chunk.size(), decrypted);
+            chunk.swap(decrypted);
+        }
+        sha.Update(chunk.data(), chunk.size());
+        if (!write_queue.Push(std::move(chunk))) {
+            read_queue.Close();
+            break;
+        }
+    }
+    write_queue.Close();
+
+    const bool read_ok = reader.get();
+    const bool write_ok = writer.get();
+    if (!read_ok) {
+        LOG_ERROR(Service_AM, "Could not read content {} from {}", index, path);
+        return FileSys::ERROR_NOT_FOUND;
+    }
+    if (!write_ok || content_written[index] != size) {
+        LOG_ERROR(Service_AM, "Could not write content {}", index);
+        return FileSys::ERROR_INSUFFICIENT_SPACE;
+    }
+
+    // Citra has never refused contents with a bad hash, so only warn about them
+    std::array<u8, CryptoPP::SHA256::DIGESTSIZE> hash;
+    sha.Final(hash.data());
+    if (hash != tmd.GetContentHashByIndex(index)) {
+        LOG_WARNING(Service_AM, "Content {} hash does not match the TMD", index);
+    }
+
+    LOG_DEBUG(Service_AM, "Installed content {}, {:x} bytes", index, size);
+    return RESULT_SUCCESS;
+}
+
 u64 CIAFile::GetSize() const {
     return written;
 }
@@ -289,6 +507,9 @@ bool CIAFile::Close() const {
     if (!complete) {
         LOG_ERROR(Service_AM, "CIAFile closed prematurely, aborting install...");
         FileUtil::DeleteDir(GetTitlePath(media_type, container.GetTitleMetadata().GetTitleID()));
+        if (install_state == CIAInstallState::TMDLoaded) {
+            UpdateTitleIndex(media_type, container.GetTitleMetadata().GetTitleID());
+        }
         return true;
     }
 
@@ -323,6 +544,10 @@ bool CIAFile::Close() const {
 
         FileUtil::Delete(old_tmd_path);
     }
+
+    if (install_state == CIAInstallState::TMDLoaded) {
+        UpdateTitleIndex(media_type, container.GetTitleMetadata().GetTitleID());
+    }
     return true;
 }
 
@@ -357,15 +582,31 @@ InstallStatus InstallCIA(const std::string& path,
         if (!file.IsOpen())
             return InstallStatus::ErrorFailedToOpenFile;
 
+        // Everything before the content data is written through the CIA file as usual, the
+        // contents are then installed straight from the file so they can be pipelined
+        const u64 content_offset = container.GetContentOffset();
+
+        // Progress covers what is installed: the sections up to the contents, then the contents.
+        // The meta section following them is not installed, so the CIA size can't be used.
+        u64 install_size = content_offset;
+        for (std::size_t i = 0; i < container.GetTitleMetadata().GetContentCount(); i++) {
+            install_size += container.GetContentSize(i);
+        }
+
         std::array<u8, 0x10000> buffer;
         std::size_t total_bytes_read = 0;
-        while (total_bytes_read != file.GetSize()) {
-            std::size_t bytes_read = file.ReadBytes(buffer.data(), buffer.size());
+        while (total_bytes_read != content_offset) {
+            std::size_t bytes_read = file.ReadBytes(
+                buffer.data(), std::min<u64>(buffer.size(), content_offset - total_bytes_read));
+            if (bytes_read == 0) {
+                LOG_ERROR(Service_AM, "CIA file {} is truncated, aborting", path);
+                return InstallStatus::ErrorAborted;
+            }
             auto result = installFile.Write(static_cast<u64>(total_bytes_read), bytes_read, true,
                                             static_cast<u8*>(buffer.data()));
 
             if (update_callback)
-                update_callback(total_bytes_read, file.GetSize());
+                update_callback(total_bytes_read, static_cast<std::size_t>(install_size));
             if (result.Failed()) {
                 LOG_ERROR(Service_AM, "CIA file installation aborted with error code {:08x}",
                           result.Code().raw);
@@ -373,6 +614,18 @@ InstallStatus InstallCIA(const std::string& path,
             }
             total_bytes_read += bytes_read;
         }
+
+        const ResultCode result = installFile.InstallContents(
+            path, [&](std::size_t written, std::size_t) {
+                if (update_callback)
+                    update_callback(total_bytes_read + written,
+                                    static_cast<std::size_t>(install_size));
+            });
+        if (result.IsError()) {
+            LOG_ERROR(Service_AM, "CIA file installation aborted with error code {:08x}",
+                      result.raw);
+            return InstallStatus::ErrorAborted;
+        }
         installFile.Close();
 
         LOG_INFO(Service_AM, "Installed {} successfully.", path);
@@ -544,26 +797,186 @@ std::string GetMediaTitlePath(Service::FS::MediaType media_type) {
     return "";
 }
 
-void Module::ScanForTitles(Service::FS::MediaType media_type) {
-    am_title_list[static_cast<u32>(media_type)].clear();
+namespace {
+
+constexpr u32 TitleIndexMagic = 0x58444954; // "TIDX"
+constexpr u32 TitleIndexVersion = 2;
+
+struct TitleIndexHeader {
+    u32_le magic;
+    u32_le version;
+    u64_le entry_count;
+};
+static_assert(sizeof(TitleIndexHeader) == 0x10, "TitleIndexHeader has incorrect size.");
+
+/**
+ * An installed title that was parsed successfully, along with the state of its files at that time.
+ * It is parsed again once they change. Titles that failed to parse aren't indexed, as the failure
+ * may come from missing keys or seeds, which can be added without touching the title's files.
+ */
+struct TitleIndexEntry {
+    u64_le title_id;
+    /// Modification time of the content/ folder, which changes when files are added or removed
+    s64_le folder_mtime;
+    /// Modification time and size of the main content, which change when it is overwritten
+    s64_le content_mtime;
+    u64_le content_size;
+};
+static_assert(sizeof(TitleIndexEntry) == 0x20, "TitleIndexEntry has incorrect size.");
+
+/// Serializes accesses to the title index files, as titles can be installed by the frontend
+std::mutex title_index_mutex;
+
+std::string GetTitleIndexPath(Service::FS::MediaType media_type) {
+    const std::string title_path = GetMediaTitlePath(media_type);
+    return fmt::format("{}am_titles/{:016X}.bin",
+                       FileUtil::GetUserPath(FileUtil::UserPath::CacheDir),
+                       Common::ComputeHash64(title_path.data(), title_path.size()));
+}
+
+std::vector<TitleIndexEntry> LoadTitleIndex(const std::string& path) {
+    FileUtil::IOFile file(path, "rb");
+    TitleIndexHeader header;
+    if (!file.IsOpen() || file.ReadBytes(&header, sizeof(header)) != sizeof(header) ||
+        header.magic != TitleIndexMagic || header.version != TitleIndexVersion ||
+        header.entry_count * sizeof(TitleIndexEntry) != file.GetSize() - sizeof(header)) {
+        return {};
+    }
+
+    std::vector<TitleIndexEntry> entries(static_cast<std::size_t>(header.entry_count));
+    if (file.ReadArray(entries.data(), entries.size()) != entries.size()) {
+        return {};
+    }
+    return entries;
+}
+
+void SaveTitleIndex(const std::string& path, const std::vector<TitleIndexEntry>& entries) {
+    if (!FileUtil::CreateFullPath(path)) {
+        LOG_ERROR(Service_AM, "Could not create title index path {}", path);
+        return;
+    }
+
+    TitleIndexHeader header{};
+    header.magic = TitleIndexMagic;
+    header.version = TitleIndexVersion;
+    header.entry_count = entries.size();
+    FileUtil::IOFile file(path, "wb");
+    if (file.WriteObject(header) != 1 ||
+        file.WriteArray(entries.data(), entries.size()) != entries.size()) {
+        LOG_ERROR(Service_AM, "Could not write title index {}", path);
+        file.Close();
+        FileUtil::Delete(path);
+    }
+}
+
+/// Returns the entry of an installed title, describing the current state of its files
+TitleIndexEntry MakeTitleIndexEntry(Service::FS::MediaType media_type, u64 title_id) {
+    TitleIndexEntry entry{};
+    entry.title_id = title_id;
+    const std::string folder_path = GetTitlePath(media_type, title_id) + "content";
+    if (FileUtil::IsDirectory(folder_path)) {
+        entry.folder_mtime = FileUtil::GetModificationTime(folder_path);
+    }
+    const std::string content_path = GetTitleContentPath(media_type, title_id);
+    if (FileUtil::Exists(content_path)) {
+        entry.content_mtime = FileUtil::GetModificationTime(content_path);
+        entry.content_size = FileUtil::GetSize(content_path);
+    }
+    return entry;
+}
+
+bool IsSameTitleState(const TitleIndexEntry& a, const TitleIndexEntry& b) {
+    return a.folder_mtime == b.folder_mtime && a.content_mtime == b.content_mtime &&
+           a.content_size == b.content_size;
+}
+
+bool IsValidTitle(Service::FS::MediaType media_type, u64 title_id) {
+    FileSys::NCCHContainer container(GetTitleContentPath(media_type, title_id));
+    return container.Load() == Loader::ResultStatus::Success;
+}
+
+} // Anonymous namespace
+
+bool UpdateTitleIndex(Service::FS::MediaType media_type, u64 title_id) {
+    if (media_type != Service::FS::MediaType::NAND && media_type != Service::FS::MediaType::SDMC)
+        return false;
+
+    std::lock_guard lock{title_index_mutex};
+    const std::string index_path = GetTitleIndexPath(media_type);
+    std::vector<TitleIndexEntry> entries = LoadTitleIndex(index_path);
+    entries.erase(std::remove_if(entries.begin(), entries.end(),
+                                 [title_id](const auto& entry) {
+                                     return entry.title_id == title_id;
+                                 }),
+                  entries.end());
+
+    const bool valid = FileUtil::IsDirectory(GetTitlePath(media_type, title_id)) &&
+                       IsValidTitle(media_type, title_id);
+    if (valid) {
+        entries.push_back(MakeTitleIndexEntry(media_type, title_id));
+    }
+    SaveTitleIndex(index_path, entries);
+    return valid;
+}
+
+std::vector<u64> ScanForInstalledTitles(Service::FS::MediaType media_type) {
+    std::lock_guard lock{title_index_mutex};
+    const std::string index_path = GetTitleIndexPath(media_type);
+    std::unordered_map<u64, TitleIndexEntry> cached_entries;
+    for (const TitleIndexEntry& entry : LoadTitleIndex(index_path)) {
+        cached_entries.emplace(entry.title_id, entry);
+    }
 
     std::string title_path = GetMediaTitlePath(media_type);
 
-    FileUtil::FSTEntry entries;
-    FileUtil::ScanDirectoryTree(title_path, entries, 1);
-    for (const FileUtil::FSTEntry& tid_high : entries.children) {
+    // Titles are only parsed again if their files changed since they were indexed
+    std::vector<u64> title_list;
+    std::vector<TitleIndexEntry> entries;
+    bool index_changed = false;
+    FileUtil::FSTEntry tid_highs;
+    FileUtil::ScanDirectoryTree(title_path, tid_highs, 1);
+    for (const FileUtil::FSTEntry& tid_high : tid_highs.children) {
         for (const FileUtil::FSTEntry& tid_low : tid_high.children) {
             std::string tid_string = tid_high.virtualName + tid_low.virtualName;
 
             if (tid_string.length() == TITLE_ID_VALID_LENGTH) {
                 const u64 tid = std::stoull(tid_string, nullptr, 16);
-
-                FileSys::NCCHContainer container(GetTitleContentPath(media_type, tid));
-                if (container.Load() == Loader::ResultStatus::Success)
-                    am_title_list[static_cast<u32>(media_type)].push_back(tid);
+                const TitleIndexEntry entry = MakeTitleIndexEntry(media_type, tid);
+
+                const auto itr = cached_entries.find(tid);
+                const bool cached =
+                    itr != cached_entries.end() && IsSameTitleState(itr->second, entry);
+                if (!cached && !IsValidTitle(media_type, tid)) {
+                    index_changed |= itr != cached_entries.end();
+                    continue;
+                }
+                index_changed |= !cached;
+                entries.push_back(entry);
+                title_list.push_back(tid);
             }
         }
     }
+
+    if (index_changed || entries.size() != cached_entries.size()) {
+        SaveTitleIndex(index_path, entries);
+    }
+    LOG_DEBUG(Service_AM, "Found {} titles in {}", title_list.size(), title_path);
+    return title_list;
+}
+
+void Module::ScanForTitles(Service::FS::MediaType media_type) {
+    const std::vector<u64> title_ids = ScanForInstalledTitles(media_type);
+    auto& title_list = am_title_list[static_cast<u32>(media_type)];
+    title_list.assign(title_ids.begin(), title_ids.end());
+}
+
+void Module::UpdateTitle(Service::FS::MediaType media_type, u64 title_id) {
+    auto& title_list = am_title_list[static_cast<u32>(media_type)];
+    title_list.erase(std::remove(title_list.begin(), title_list.end(), title_id),
+                     title_list.end());
+    if (UpdateTitleIndex(media_type, title_id)) {
+        title_list.push_back(title_id);
+    }
 }
 
 void Module::ScanForAllTitles() {
@@ -814,7 +1227,7 @@ void Module::Interface::DeleteUserProgram(Kernel::HLERequestContext& ctx) {
         return;
     }
     bool success = FileUtil::DeleteDirRecursively(path);
-    am->ScanForAllTitles();
+    am->UpdateTitle(media_type, title_id);
     rb.Push(RESULT_SUCCESS);
     if (!success)
         LOG_ERROR(Service_AM, "FileUtil::DeleteDirRecursively unexpectedly failed");
@@ -1146,11 +1559,13 @@ public:
         : file(std::move(file)), file_offset(offset), file_size(size) {}
 
     ResultVal<std::size_t> Read(u64 offset, std::size_t length, u8* buffer) const override {
+        file->WaitForPendingReads();
         return file->backend->Read(offset + file_offset, length, buffer);
     }
 
     ResultVal<std::size_t> Write(u64 offset, std::size_t length, bool flush,
                                  const u8* buffer) override {
+        file->WaitForPendingReads();
         return file->backend->Write(offset + file_offset, length, flush, buffer);
     }
 
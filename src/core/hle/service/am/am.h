@@ -5,6 +5,7 @@
 #pragma once
 
 #include <array>
+#include <atomic>
 #include <functional>
 #include <memory>
 #include <string>
@@ -76,6 +77,19 @@ public:
     ResultCode WriteTicket();
     ResultCode WriteTitleMetadata();
     ResultVal<std::size_t> WriteContentData(u64 offset, std::size_t length, const u8* buffer);
+
+    /**
+     * Installs all the content data of the CIA straight from the CIA file, instead of waiting for
+     * it to be written. Several contents are installed at once, each one being read, decrypted and
+     * verified, and written out by separate threads. The TMD must have been written already.
+     * @param path file path of the CIA file being installed
+     * @param update_callback callback function receiving content bytes written and the total size
+     *                        of the contents
+     * @returns ResultCode of the first failed content install, if any
+     */
+    ResultCode InstallContents(const std::string& path,
+                               const std::function<ProgressCallback>& update_callback);
+
     ResultVal<std::size_t> Write(u64 offset, std::size_t length, bool flush,
                                  const u8* buffer) override;
     u64 GetSize() const override;
@@ -84,6 +98,9 @@ public:
     void Flush() const override;
 
 private:
+    ResultCode InstallContent(const std::string& path, std::size_t index,
+                              std::atomic<u64>& progress);
+
     // Whether it's installing an update, and what step of installation it is at
     bool is_update = false;
     CIAInstallState install_state = CIAInstallState::InstallStarted;
@@ -104,7 +121,9 @@ private:
 /**
  * Installs a CIA file from a specified file path.
  * @param path file path of the CIA file to install
- * @param update_callback callback function called during filesystem write
+ * @param update_callback callback function called during filesystem write, receiving the bytes
+ *                        installed and the size of the sections up to the contents and of the
+ *                        contents, which is what gets installed
  * @returns bool whether the install was successful
  */
 InstallStatus InstallCIA(const std::string& path,
@@ -152,6 +171,24 @@ std::string GetTitlePath(Service::FS::MediaType media_type, u64 tid);
  */
 std::string GetMediaTitlePath(Service::FS::MediaType media_type);
 
+/**
+ * Updates the entry of a title in the index of titles installed on its storage medium, which is
+ * used to avoid parsing every title when scanning for them. Called after a title is installed or
+ * deleted.
+ * @param media_type the storage medium the title is installed on
+ * @param title_id the title ID of the title
+ * @returns bool whether the title is installed and valid
+ */
+bool UpdateTitleIndex(Service::FS::MediaType media_type, u64 title_id);
+
+/**
+ * Scans a storage medium for valid installed titles. Only the titles whose files changed since
+ * they were last indexed are parsed again.
+ * @param media_type the storage medium to scan
+ * @returns the title IDs of the valid titles
+ */
+std::vector<u64> ScanForInstalledTitles(Service::FS::MediaType media_type);
+
 class Module final {
 public:
     explicit Module(Core::System& system);
@@ -580,6 +617,13 @@ private:
      */
     void ScanForAllTitles();
 
+    /**
+     * Updates the listing of a single title after it was installed or deleted.
+     * @param media_type the storage medium the title is installed on
+     * @param title_id the title ID of the title
+     */
+    void UpdateTitle(Service::FS::MediaType media_type, u64 title_id);
+
     Kernel::KernelSystem& kernel;
     bool cia_installing = false;
     std::array<std::vector<u64_le>, 3> am_title_list;
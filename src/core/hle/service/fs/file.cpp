@@ -2,9 +2,18 @@
 // Licensed under GPLv2 or any later version
 // Refer to the license.txt file included.
 
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <thread>
+#include <boost/serialization/shared_ptr.hpp>
 #include <boost/serialization/unique_ptr.hpp>
+#include <boost/serialization/vector.hpp>
 #include "common/archives.h"
 #include "common/logging/log.h"
+#include "common/thread.h"
 #include "core/core.h"
 #include "core/file_sys/errors.h"
 #include "core/file_sys/file_backend.h"
@@ -14,14 +23,153 @@
 #include "core/hle/kernel/event.h"
 #include "core/hle/kernel/server_session.h"
 #include "core/hle/service/fs/file.h"
+#include "core/memory.h"
 
 SERIALIZE_EXPORT_IMPL(Service::FS::File)
 SERIALIZE_EXPORT_IMPL(Service::FS::FileSessionSlot)
+SERIALIZE_EXPORT_IMPL(Service::FS::File::ReadCallback)
 
 namespace Service::FS {
 
+namespace {
+
+/**
+ * Runs host file reads in submission order on a dedicated thread. A single thread is used so that
+ * backends shared by several files (e.g. the RomFS of a title) are never accessed concurrently.
+ */
+class IOThread {
+public:
+    IOThread() : thread([this] { Loop(); }) {}
+
+    ~IOThread() {
+        {
+            std::lock_guard lock{mutex};
+            stop = true;
+        }
+        cv.notify_one();
+        thread.join();
+    }
+
+    std::future<void> Push(std::function<void()> func) {
+        std::packaged_task<void()> task(std::move(func));
+        auto future = task.get_future();
+        {
+            std::lock_guard lock{mutex};
+            tasks.push_back(std::move(task));
+        }
+        cv.notify_one();
+        return future;
+    }
+
+    /// Waits for all the tasks pushed so far to complete.
+    void Drain() {
+        // Tasks run in order, so an empty one completes after all those pushed before it
+        Push([] {}).wait();
+    }
+
+private:
+    void Loop() {
+        Common::SetCurrentThreadName("FileIO");
+        while (true) {
+            std::packaged_task<void()> task;
+            {
+                std::unique_lock lock{mutex};
+                cv.wait(lock, [this] { return stop || !tasks.empty(); });
+                if (tasks.empty()) {
+                    return;
+                }
+                task = std::move(tasks.front());
+                tasks.pop_front();
+            }
+            task();
+        }
+    }
+
+    std::mutex mutex;
+    std::condition_variable cv;
+    std::deque<std::packaged_task<void()>> tasks;
+    bool stop = false;
+    std::thread thread;
+};
+
+IOThread& GetIOThread() {
+    static IOThread io_thread;
+    return io_thread;
+}
+
+} // Anonymous namespace
+
+struct File::AsyncRead {
+    /// Data of the file that can be read in place, if the backend supports it
+    const u8* direct = nullptr;
+    std::vector<u8> data;
+    ResultCode result = RESULT_SUCCESS;
+    u32 read_length = 0;
+    std::future<void> done;
+
+    void Wait() const {
+        if (done.valid()) {
+            done.wait();
+        }
+    }
+};
+
+/// Writes the response of File::Read once the client thread wakes up after the emulated delay,
+/// waiting for the host read if it isn't complete yet.
+class File::ReadCallback : public Kernel::HLERequestContext::WakeupCallback {
+public:
+    explicit ReadCallback(std::shared_ptr<AsyncRead> read) : read(std::move(read)) {}
+
+    void WakeUp(std::shared_ptr<Kernel::Thread> thread, Kernel::HLERequestContext& ctx,
+                Kernel::ThreadWakeupReason reason) override {
+        read->Wait();
+
+        // The request is still in the command buffer, as no response was written to it yet
+        IPC::RequestParser rp(ctx, 0x0802, 3, 2);
+        rp.Skip(3, false);
+        auto& buffer = rp.PopMappedBuffer();
+
+        IPC::RequestBuilder rb = rp.MakeBuilder(2, 2);
+        if (read->result.IsError()) {
+            rb.Push(read->result);
+            rb.Push<u32>(0);
+        } else {
+            buffer.Write(read->direct ? read->direct : read->data.data(), 0, read->read_length);
+            rb.Push(RESULT_SUCCESS);
+            rb.Push<u32>(read->read_length);
+        }
+        rb.PushMappedBuffer(buffer);
+    }
+
+private:
+    ReadCallback() = default;
+    std::shared_ptr<AsyncRead> read;
+
+    template <class Archive>
+    void serialize(Archive& ar, const unsigned int) {
+        ar& boost::serialization::base_object<Kernel::HLERequestContext::WakeupCallback>(*this);
+        // Reads in flight can't be saved, so their result is saved instead
+        if (Archive::is_saving::value) {
+            read->Wait();
+            if (read->direct != nullptr) {
+                read->data.assign(read->direct, read->direct + read->read_length);
+                read->direct = nullptr;
+            }
+        } else {
+            read = std::make_shared<AsyncRead>();
+        }
+        ar& read->data;
+        ar& read->result;
+        ar& read->read_length;
+    }
+    friend class boost::serialization::access;
+};
+
 template <class Archive>
 void File::serialize(Archive& ar, const unsigned int) {
+    // Backends can be shared by several files (e.g. the RomFS of a title), so all the queued reads
+    // have to complete, not only those of this file
+    GetIOThread().Drain();
     ar& boost::serialization::base_object<Kernel::SessionRequestHandler>(*this);
     ar& path;
     ar& backend;
@@ -53,11 +201,14 @@ File::File(Kernel::KernelSystem& kernel)
     RegisterHandlers(functions);
 }
 
+File::~File() {
+    WaitForPendingReads();
+}
+
 void File::Read(Kernel::HLERequestContext& ctx) {
     IPC::RequestParser rp(ctx, 0x0802, 3, 2);
     u64 offset = rp.Pop<u64>();
     u32 length = rp.Pop<u32>();
-    auto& buffer = rp.PopMappedBuffer();
     LOG_TRACE(Service_FS, "Read {}: offset=0x{:x} length=0x{:08X}", GetName(), offset, length);
 
     const FileSessionSlot* file = GetSessionData(ctx.Session());
@@ -70,28 +221,44 @@ void File::Read(Kernel::HLERequestContext& ctx) {
     // This file session might have a specific offset from where to start reading, apply it.
     offset += file->offset;
 
-    if (offset + length > backend->GetSize()) {
-        LOG_ERROR(Service_FS,
-                  "Reading from out of bounds offset=0x{:x} length=0x{:08X} file_size=0x{:x}",
-                  offset, length, backend->GetSize());
+    // The host read is done on the I/O thread while the client thread sleeps for the emulated
+    // media latency, and the response is written when the thread wakes up.
+    auto read = std::make_shared<AsyncRead>();
+    read->direct = backend->GetDataPointer(offset, length);
+    if (read->direct == nullptr) {
+        read->data.resize(length);
     }
-
-    IPC::RequestBuilder rb = rp.MakeBuilder(2, 2);
-
-    std::vector<u8> data(length);
-    ResultVal<std::size_t> read = backend->Read(offset, data.size(), data.data());
-    if (read.Failed()) {
-        rb.Push(read.Code());
-        rb.Push<u32>(0);
-    } else {
-        buffer.Write(data.data(), 0, *read);
-        rb.Push(RESULT_SUCCESS);
-        rb.Push<u32>(static_cast<u32>(*read));
-    }
-    rb.PushMappedBuffer(buffer);
+    read->done = GetIOThread().Push([this, read, offset, length] {
+        if (offset + length > backend->GetSize()) {
+            LOG_ERROR(Service_FS,
+                      "Reading from out of bounds offset=0x{:x} length=0x{:08X} file_size=0x{:x}",
+                      offset, length, backend->GetSize());
+        }
+
+        if (read->direct != nullptr) {
+            // Touch the data so that it is paged in here rather than while copying it to the
+            // guest buffer
+            const volatile u8* data = read->direct;
+            for (std::size_t i = 0; i < length; i += Memory::PAGE_SIZE) {
+                static_cast<void>(data[i]);
+            }
+            read->read_length = length;
+            return;
+        }
+
+        const ResultVal<std::size_t> result =
+            backend->Read(offset, read->data.size(), read->data.data());
+        if (result.Failed()) {
+            read->result = result.Code();
+        } else {
+            read->read_length = static_cast<u32>(*result);
+        }
+    });
+    last_read = read;
 
     std::chrono::nanoseconds read_timeout_ns{backend->GetReadDelayNs(length)};
-    ctx.SleepClientThread("file::read", read_timeout_ns, nullptr);
+    ctx.SleepClientThread("file::read", read_timeout_ns,
+                          std::make_shared<ReadCallback>(std::move(read)));
 }
 
 void File::Write(Kernel::HLERequestContext& ctx) {
@@ -115,6 +282,7 @@ void File::Write(Kernel::HLERequestContext& ctx) {
         return;
     }
 
+    WaitForPendingReads();
     std::vector<u8> data(length);
     buffer.Read(data.data(), 0, data.size());
     ResultVal<std::size_t> written = backend->Write(offset, data.size(), flush != 0, data.data());
@@ -156,6 +324,7 @@ void File::SetSize(Kernel::HLERequestContext& ctx) {
         return;
     }
 
+    WaitForPendingReads();
     file->size = size;
     backend->SetSize(size);
     rb.Push(RESULT_SUCCESS);
@@ -169,6 +338,7 @@ void File::Close(Kernel::HLERequestContext& ctx) {
         LOG_WARNING(Service_FS, "Closing File backend but {} clients still connected",
                     connected_sessions.size());
 
+    WaitForPendingReads();
     backend->Close();
     IPC::RequestBuilder rb = rp.MakeBuilder(1, 0);
     rb.Push(RESULT_SUCCESS);
@@ -187,6 +357,7 @@ void File::Flush(Kernel::HLERequestContext& ctx) {
         return;
     }
 
+    WaitForPendingReads();
     backend->Flush();
     rb.Push(RESULT_SUCCESS);
 }
@@ -224,6 +395,7 @@ void File::OpenLinkFile(Kernel::HLERequestContext& ctx) {
 
     slot->priority = original_file->priority;
     slot->offset = 0;
+    WaitForPendingReads();
     slot->size = backend->GetSize();
     slot->subfile = false;
 
@@ -282,6 +454,7 @@ std::shared_ptr<Kernel::ClientSession> File::Connect() {
     FileSessionSlot* slot = GetSessionData(std::move(server));
     slot->priority = 0;
     slot->offset = 0;
+    WaitForPendingReads();
     slot->size = backend->GetSize();
     slot->subfile = false;
 
@@ -300,4 +473,10 @@ std::size_t File::GetSessionFileSize(std::shared_ptr<Kernel::ServerSession> sess
     return slot->size;
 }
 
+void File::WaitForPendingReads() const {
+    if (last_read) {
+        last_read->Wait();
+    }
+}
+
 } // namespace Service::FS
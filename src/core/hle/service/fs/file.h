@@ -41,7 +41,9 @@ class File final : public ServiceFramework<File, FileSessionSlot> {
 public:
     File(Kernel::KernelSystem& kernel, std::unique_ptr<FileSys::FileBackend>&& backend,
          const FileSys::Path& path);
-    ~File() = default;
+    ~File();
+
+    class ReadCallback;
 
     std::string GetName() const {
         return "Path: " + path.DebugStr();
@@ -61,6 +63,10 @@ public:
     // OpenSubFile.
     std::size_t GetSessionFileSize(std::shared_ptr<Kernel::ServerSession> session);
 
+    /// Waits for the host reads queued for this file to complete. Must be called before accessing
+    /// the backend directly.
+    void WaitForPendingReads() const;
+
 private:
     void Read(Kernel::HLERequestContext& ctx);
     void Write(Kernel::HLERequestContext& ctx);
@@ -73,8 +79,13 @@ private:
     void OpenLinkFile(Kernel::HLERequestContext& ctx);
     void OpenSubFile(Kernel::HLERequestContext& ctx);
 
+    struct AsyncRead;
+
     Kernel::KernelSystem& kernel;
 
+    /// The last host read queued for this file. Reads complete in order.
+    std::shared_ptr<AsyncRead> last_read;
+
     File(Kernel::KernelSystem& kernel);
     File();
 
@@ -87,3 +98,4 @@ private:
 
 BOOST_CLASS_EXPORT_KEY(Service::FS::FileSessionSlot)
 BOOST_CLASS_EXPORT_KEY(Service::FS::File)
+BOOST_CLASS_EXPORT_KEY(Service::FS::File::ReadCallback)
@@ -7,6 +7,7 @@
 #include "common/assert.h"
 #include "common/logging/log.h"
 #include "core/core.h"
+#include "core/hle/call_profiler.h"
 #include "core/hle/ipc.h"
 #include "core/hle/kernel/client_port.h"
 #include "core/hle/kernel/handle_table.h"
@@ -177,7 +178,16 @@ void ServiceFrameworkBase::HandleSyncRequest(Kernel::HLERequestContext& context)
 
     LOG_TRACE(Service, "{}",
               MakeFunctionString(info->name, GetServiceName(), context.CommandBuffer()));
+
+    HLE::CallProfiler* profiler = Core::System::GetInstance().GetCallProfiler();
+    if (profiler == nullptr || !profiler->IsEnabled()) {
+        handler_invoker(this, info->handler_callback, context);
+        return;
+    }
+
+    const auto start = HLE::CallProfiler::Clock::now();
     handler_invoker(this, info->handler_callback, context);
+    profiler->RecordServiceCall(*this, header_code, HLE::CallProfiler::Clock::now() - start);
 }
 
 std::string ServiceFrameworkBase::GetFunctionName(u32 header) const {
@@ -0,0 +1,103 @@
+// Copyright 2020 Citra Emulator Project
+// Licensed under GPLv2 or any later version
+// Refer to the license.txt file included.
+
+#include <algorithm>
+#include <cstring>
+#include <future>
+#include <thread>
+#include <vector>
+#include <cryptopp/aes.h>
+#include <cryptopp/modes.h>
+#include "core/hw/aes/cipher.h"
+
+namespace HW::AES {
+
+namespace {
+
+/// Ranges smaller than this are not worth the cost of waking up worker threads
+constexpr std::size_t MinParallelChunkSize = 0x100000;
+
+/// Returns the block aligned size of the chunks a range is split in for processing.
+std::size_t GetChunkSize(std::size_t size) {
+    // Large ranges are split even on single core hosts, so the chunk chaining runs everywhere
+    const std::size_t max_workers = std::max(2u, std::thread::hardware_concurrency());
+    const std::size_t workers = std::min(max_workers, size / MinParallelChunkSize);
+    if (workers <= 1) {
+        return size;
+    }
+    const std::size_t chunk_blocks = (size / AES_BLOCK_SIZE + workers - 1) / workers;
+    return chunk_blocks * AES_BLOCK_SIZE;
+}
+
+/**
+ * Calls func(begin, end) for each chunk of the range [0, size), on the calling thread and worker
+ * threads. Returns once all the chunks are processed.
+ */
+template <typename Func>
+void ParallelForChunks(std::size_t size, std::size_t chunk_size, const Func& func) {
+    std::vector<std::future<void>> futures;
+    for (std::size_t begin = chunk_size; begin < size; begin += chunk_size) {
+        const std::size_t end = std::min(size, begin + chunk_size);
+        futures.push_back(
+            std::async(std::launch::async, [&func, begin, end] { func(begin, end); }));
+    }
+    func(std::size_t{0}, std::min(size, chunk_size));
+    for (auto& future : futures) {
+        future.get();
+    }
+}
+
+} // Anonymous namespace
+
+void TransformCTR(const AESKey& key, const AESKey& ctr, u64 offset, u8* data, std::size_t size) {
+    if (size == 0) {
+        return; // Crypto++ does not like zero size buffer
+    }
+    // Crypto++ uses AES-NI for the key stream when the host supports it
+    ParallelForChunks(size, GetChunkSize(size), [&](std::size_t begin, std::size_t end) {
+        CryptoPP::CTR_Mode<CryptoPP::AES>::Decryption d(key.data(), key.size(), ctr.data());
+        d.Seek(offset + begin);
+        d.ProcessData(data + begin, data + begin, end - begin);
+    });
+}
+
+void CBCDecryptor::Process(const u8* data, std::size_t size, std::vector<u8>& out) {
+    out.clear();
+
+    // Complete the block held back from the previous piece, and decrypt it on its own
+    if (!pending.empty()) {
+        const std::size_t fill = std::min(size, AES_BLOCK_SIZE - pending.size());
+        pending.insert(pending.end(), data, data + fill);
+        data += fill;
+        size -= fill;
+        if (pending.size() < AES_BLOCK_SIZE) {
+            return;
+        }
+        out.resize(AES_BLOCK_SIZE);
+        CryptoPP::CBC_Mode<CryptoPP::AES>::Decryption d(key.data(), key.size(), iv.data());
+        d.ProcessData(out.data(), pending.data(), AES_BLOCK_SIZE);
+        std::memcpy(iv.data(), pending.data(), AES_BLOCK_SIZE);
+        pending.clear();
+    }
+
+    const std::size_t aligned_size = size - size % AES_BLOCK_SIZE;
+    pending.assign(data + aligned_size, data + size);
+    if (aligned_size == 0) {
+        return;
+    }
+
+    // Each chunk is chained to the last cipher text block of the previous one
+    const std::size_t out_offset = out.size();
+    out.resize(out_offset + aligned_size);
+    u8* const dest = out.data() + out_offset;
+    const auto decrypt_chunk = [&](std::size_t begin, std::size_t end) {
+        const u8* chunk_iv = begin == 0 ? iv.data() : data + begin - AES_BLOCK_SIZE;
+        CryptoPP::CBC_Mode<CryptoPP::AES>::Decryption d(key.data(), key.size(), chunk_iv);
+        d.ProcessData(dest + begin, data + begin, end - begin);
+    };
+    ParallelForChunks(aligned_size, GetChunkSize(aligned_size), decrypt_chunk);
+    std::memcpy(iv.data(), data + aligned_size - AES_BLOCK_SIZE, AES_BLOCK_SIZE);
+}
+
+} // namespace HW::AES
@@ -0,0 +1,58 @@
+// Copyright 2020 Citra Emulator Project
+// Licensed under GPLv2 or any later version
+// Refer to the license.txt file included.
+
+#pragma once
+
+#include <cstddef>
+#include <vector>
+#include "common/common_types.h"
+#include "core/hw/aes/key.h"
+
+namespace HW::AES {
+
+/**
+ * Encrypts or decrypts data in place using AES-CTR, which is the same operation in both
+ * directions. Large ranges are split across worker threads, as every block of the key stream can
+ * be computed independently.
+ * @param key The key to use
+ * @param ctr The initial counter
+ * @param offset Offset in bytes of the data into the key stream
+ * @param data The data to transform
+ * @param size Size in bytes of the data
+ */
+void TransformCTR(const AESKey& key, const AESKey& ctr, u64 offset, u8* data, std::size_t size);
+
+/**
+ * Decrypts a stream of AES-CBC data, possibly in several pieces. Large pieces are split across
+ * worker threads, as decrypting a block only needs the previous cipher text block.
+ */
+class CBCDecryptor {
+public:
+    CBCDecryptor() = default;
+    CBCDecryptor(const AESKey& key, const AESKey& iv) : key(key), iv(iv) {}
+
+    /**
+     * Decrypts the next piece of the stream. Pieces don't have to be block aligned: a trailing
+     * partial block is held back, and decrypted once the next piece completes it.
+     * @param data The cipher text of the piece
+     * @param size Size in bytes of the piece
+     * @param out Replaced by the decrypted data, which starts with the block completed by this
+     *            piece and lacks the bytes held back from it.
+     */
+    void Process(const u8* data, std::size_t size, std::vector<u8>& out);
+
+    /// Returns the number of bytes held back until the next piece completes their block.
+    std::size_t GetPendingSize() const {
+        return pending.size();
+    }
+
+private:
+    AESKey key{};
+    /// The last cipher text block processed so far
+    AESKey iv{};
+    /// Cipher text of the incomplete block at the end of the previous piece
+    std::vector<u8> pending;
+};
+
+} // namespace HW::AES
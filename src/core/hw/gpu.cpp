@@ -17,6 +17,8 @@
 #include "core/hw/gpu.h"
 #include "core/hw/hw.h"
 #include "core/memory.h"
+#include "core/movie.h"
+#include "core/rpc/rpc_server.h"
 #include "core/tracer/recorder.h"
 #include "video_core/command_processor.h"
 #include "video_core/debug_utils/debug_utils.h"
@@ -514,6 +516,13 @@ static void VBlankCallback(u64 userdata, s64 cycles_late) {
     Service::GSP::SignalInterrupt(Service::GSP::InterruptId::PDC0);
     Service::GSP::SignalInterrupt(Service::GSP::InterruptId::PDC1);
 
+    Core::Movie::GetInstance().HandleVBlank();
+
+    // Push memory subscriptions to scripting clients at the frame boundary
+    if (auto rpc_server = Core::System::GetInstance().GetRPCServer()) {
+        rpc_server->OnVBlank();
+    }
+
     // Reschedule recurrent event
     Core::System::GetInstance().CoreTiming().ScheduleEvent(frame_ticks - cycles_late, vblank_event);
 }
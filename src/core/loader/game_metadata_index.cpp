@@ -0,0 +1,216 @@
+// Copyright 2020 Citra Emulator Project
+// Licensed under GPLv2 or any later version
+// Refer to the license.txt file included.
+
+#include <iterator>
+#include "common/common_funcs.h"
+#include "common/file_util.h"
+#include "common/logging/log.h"
+#include "common/swap.h"
+#include "core/loader/game_metadata_index.h"
+#include "core/loader/smdh.h"
+
+namespace Loader {
+
+namespace {
+
+constexpr u32 IndexMagic = 0x58444D47; // "GMDX"
+constexpr u32 IndexVersion = 2;
+
+struct IndexHeader {
+    u32_le magic;
+    u32_le version;
+    u64_le entry_count;
+};
+static_assert(sizeof(IndexHeader) == 0x10, "IndexHeader has incorrect size.");
+
+/// Header of an index entry, followed by the path and the SMDH
+struct IndexEntryHeader {
+    u32_le path_size;
+    u32_le smdh_size;
+    u64_le size;
+    s64_le mtime;
+    u64_le program_id;
+    u64_le extdata_id;
+    u32_le file_type;
+    u8 executable;
+    u8 encrypted;
+    INSERT_PADDING_BYTES(2);
+};
+static_assert(sizeof(IndexEntryHeader) == 0x30, "IndexEntryHeader has incorrect size.");
+
+GameMetadata ReadGameMetadata(const std::string& path) {
+    GameMetadata metadata;
+    std::unique_ptr<AppLoader> loader = GetLoader(path);
+    if (!loader) {
+        return metadata;
+    }
+
+    metadata.file_type = loader->GetFileType();
+    metadata.encrypted = loader->IsExecutable(metadata.executable) == ResultStatus::ErrorEncrypted;
+    loader->ReadProgramId(metadata.program_id);
+    loader->ReadExtdataId(metadata.extdata_id);
+    loader->ReadIcon(metadata.smdh);
+    if (!IsValidSMDH(metadata.smdh)) {
+        metadata.smdh.clear();
+    }
+    return metadata;
+}
+
+/**
+ * Returns whether the metadata of a file only depends on the file. Files that are encrypted or
+ * have no SMDH may read differently once keys, seeds or icon mods are added, without the file
+ * changing, so they are read again on every refresh instead.
+ */
+bool IsPersistent(const GameMetadata& metadata) {
+    return metadata.file_type != FileType::Error && !metadata.encrypted && !metadata.smdh.empty();
+}
+
+} // Anonymous namespace
+
+GameMetadataIndex::GameMetadataIndex(std::string index_path) : index_path(std::move(index_path)) {
+    Load();
+}
+
+GameMetadataIndex::~GameMetadataIndex() = default;
+
+std::string GameMetadataIndex::GetDefaultPath() {
+    return FileUtil::GetUserPath(FileUtil::UserPath::CacheDir) + "game_list/metadata.bin";
+}
+
+GameMetadata GameMetadataIndex::Get(const std::string& path) {
+    return GetImpl(path, nullptr);
+}
+
+std::vector<GameMetadata> GameMetadataIndex::Get(const std::vector<std::string>& paths,
+                                                 const std::atomic_bool* stop) {
+    // Loaders aren't thread-safe, as they use global state such as the AES key slots, so the
+    // files are read one at a time
+    std::vector<GameMetadata> result(paths.size());
+    for (std::size_t i = 0; i < paths.size(); i++) {
+        result[i] = GetImpl(paths[i], stop);
+    }
+    return result;
+}
+
+GameMetadata GameMetadataIndex::GetImpl(const std::string& path, const std::atomic_bool* stop) {
+    const u64 size = FileUtil::GetSize(path);
+    const s64 mtime = FileUtil::GetModificationTime(path);
+    {
+        std::lock_guard lock{mutex};
+        const auto itr = entries.find(path);
+        if (itr != entries.end() && itr->second.size == size && itr->second.mtime == mtime) {
+            return itr->second.metadata;
+        }
+    }
+
+    if (stop && *stop) {
+        return {};
+    }
+
+    GameMetadata metadata = ReadGameMetadata(path);
+    std::lock_guard lock{mutex};
+    if (IsPersistent(metadata)) {
+        entries[path] = Entry{size, mtime, metadata};
+        changed = true;
+    } else if (entries.erase(path) != 0) {
+        changed = true;
+    }
+    return metadata;
+}
+
+void GameMetadataIndex::Load() {
+    FileUtil::IOFile file(index_path, "rb");
+    IndexHeader header;
+    if (!file.IsOpen() || file.ReadBytes(&header, sizeof(header)) != sizeof(header) ||
+        header.magic != IndexMagic || header.version != IndexVersion) {
+        return;
+    }
+
+    std::unordered_map<std::string, Entry> loaded_entries;
+    for (u64 i = 0; i < header.entry_count; i++) {
+        IndexEntryHeader entry_header;
+        if (file.ReadBytes(&entry_header, sizeof(entry_header)) != sizeof(entry_header)) {
+            break;
+        }
+
+        std::string path(entry_header.path_size, '\0');
+        Entry entry;
+        entry.size = entry_header.size;
+        entry.mtime = entry_header.mtime;
+        entry.metadata.file_type = static_cast<FileType>(static_cast<u32>(entry_header.file_type));
+        entry.metadata.executable = entry_header.executable != 0;
+        entry.metadata.encrypted = entry_header.encrypted != 0;
+        entry.metadata.program_id = entry_header.program_id;
+        entry.metadata.extdata_id = entry_header.extdata_id;
+        entry.metadata.smdh.resize(entry_header.smdh_size);
+        if (file.ReadBytes(path.data(), path.size()) != path.size() ||
+            file.ReadBytes(entry.metadata.smdh.data(), entry.metadata.smdh.size()) !=
+                entry.metadata.smdh.size()) {
+            break;
+        }
+        loaded_entries.emplace(std::move(path), std::move(entry));
+    }
+
+    if (loaded_entries.size() != header.entry_count) {
+        LOG_WARNING(Loader, "Game metadata index {} is truncated, ignoring it", index_path);
+        return;
+    }
+
+    std::lock_guard lock{mutex};
+    entries = std::move(loaded_entries);
+}
+
+bool GameMetadataIndex::Save() {
+    std::lock_guard lock{mutex};
+    if (!changed) {
+        return true;
+    }
+
+    // Forget about games that were removed meanwhile
+    for (auto itr = entries.begin(); itr != entries.end();) {
+        itr = FileUtil::Exists(itr->first) ? std::next(itr) : entries.erase(itr);
+    }
+
+    if (!FileUtil::CreateFullPath(index_path)) {
+        LOG_ERROR(Loader, "Could not create game metadata index path {}", index_path);
+        return false;
+    }
+
+    FileUtil::IOFile file(index_path, "wb");
+    IndexHeader header{};
+    header.magic = IndexMagic;
+    header.version = IndexVersion;
+    header.entry_count = entries.size();
+    bool success = file.WriteObject(header) == 1;
+    for (const auto& [path, entry] : entries) {
+        if (!success) {
+            break;
+        }
+        IndexEntryHeader entry_header{};
+        entry_header.path_size = static_cast<u32>(path.size());
+        entry_header.smdh_size = static_cast<u32>(entry.metadata.smdh.size());
+        entry_header.size = entry.size;
+        entry_header.mtime = entry.mtime;
+        entry_header.program_id = entry.metadata.program_id;
+        entry_header.extdata_id = entry.metadata.extdata_id;
+        entry_header.file_type = static_cast<u32>(entry.metadata.file_type);
+        entry_header.executable = entry.metadata.executable ? 1 : 0;
+        entry_header.encrypted = entry.metadata.encrypted ? 1 : 0;
+        success = file.WriteObject(entry_header) == 1 &&
+                  file.WriteString(path) == path.size() &&
+                  file.WriteBytes(entry.metadata.smdh.data(), entry.metadata.smdh.size()) ==
+                      entry.metadata.smdh.size();
+    }
+
+    if (!success) {
+        LOG_ERROR(Loader, "Could not write game metadata index {}", index_path);
+        file.Close();
+        FileUtil::Delete(index_path);
+        return false;
+    }
+    changed = false;
+    return true;
+}
+
+} // namespace Loader
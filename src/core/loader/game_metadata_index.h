@@ -0,0 +1,88 @@
+// Copyright 2020 Citra Emulator Project
+// Licensed under GPLv2 or any later version
+// Refer to the license.txt file included.
+
+#pragma once
+
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "common/common_types.h"
+#include "core/loader/loader.h"
+
+namespace Loader {
+
+/// Metadata of a game file needed to list it, as read through its AppLoader
+struct GameMetadata {
+    /// Type of the file, FileType::Error if no loader could be created for it
+    FileType file_type = FileType::Error;
+    /// Whether the file can be booted
+    bool executable = false;
+    /// Whether the file could not be read because it's encrypted
+    bool encrypted = false;
+    u64 program_id = 0;
+    u64 extdata_id = 0;
+    /// SMDH of the file, empty if it has none
+    std::vector<u8> smdh;
+};
+
+/**
+ * Persistent index of game metadata keyed by file path, so that listing a game library only needs
+ * to read the files that were added or modified since the last time. Entries are invalidated when
+ * the size or modification time of their file changes. Files that are encrypted or have no SMDH
+ * aren't indexed, as that can change without their file changing. All public functions are
+ * thread-safe.
+ */
+class GameMetadataIndex {
+public:
+    /**
+     * Loads the index from the specified file. The index starts empty if it doesn't exist yet.
+     * @param index_path path of the file the index is stored in
+     */
+    explicit GameMetadataIndex(std::string index_path);
+    ~GameMetadataIndex();
+
+    /// Returns the default location of the index in the cache directory
+    static std::string GetDefaultPath();
+
+    /**
+     * Gets the metadata of a file, reading it through its loader if it isn't indexed yet.
+     * @param path path of the game file
+     */
+    GameMetadata Get(const std::string& path);
+
+    /**
+     * Gets the metadata of several files, reading the ones that aren't indexed yet.
+     * @param paths paths of the game files
+     * @param stop if set, files that aren't indexed yet are no longer read and get empty metadata
+     * @return metadata of each file, in the same order as the paths
+     */
+    std::vector<GameMetadata> Get(const std::vector<std::string>& paths,
+                                  const std::atomic_bool* stop = nullptr);
+
+    /// Writes the index back to its file if it changed, dropping the entries of removed files.
+    /// Returns false on failure.
+    bool Save();
+
+private:
+    struct Entry {
+        u64 size = 0;
+        s64 mtime = 0;
+        GameMetadata metadata;
+    };
+
+    /// Returns the indexed entry of the file if it is still up-to-date, or reads the file.
+    GameMetadata GetImpl(const std::string& path, const std::atomic_bool* stop);
+
+    void Load();
+
+    std::string index_path;
+
+    std::mutex mutex;
+    std::unordered_map<std::string, Entry> entries;
+    bool changed = false;
+};
+
+} // namespace Loader
@@ -83,8 +83,7 @@ ResultStatus AppLoader_NCCH::LoadExec(std::shared_ptr<Kernel::Process>& process)
 
     std::vector<u8> code;
     u64_le program_id;
-    if (ResultStatus::Success == ReadCode(code) &&
-        ResultStatus::Success == ReadProgramId(program_id)) {
+    if (ResultStatus::Success == ReadProgramId(program_id)) {
         std::string process_name = Common::StringFromFixedZeroTerminatedBuffer(
             (const char*)overlay_ncch->exheader_header.codeset_info.name, 8);
 
@@ -105,7 +104,11 @@ ResultStatus AppLoader_NCCH::LoadExec(std::shared_ptr<Kernel::Process>& process)
         // TODO(yuriks): Not sure if the bss size is added to the page-aligned .data size or just
         //               to the regular size. Playing it safe for now.
         u32 bss_page_size = (overlay_ncch->exheader_header.codeset_info.bss_size + 0xFFF) & ~0xFFF;
-        code.resize(code.size() + bss_page_size, 0);
+
+        // Load the code with the .bss allocated and the patches applied
+        const ResultStatus code_result = overlay_ncch->LoadPatchedCode(code, bss_page_size);
+        if (code_result != ResultStatus::Success)
+            return code_result;
 
         codeset->DataSegment().offset =
             codeset->RODataSegment().offset + codeset->RODataSegment().size;
@@ -114,11 +117,6 @@ ResultStatus AppLoader_NCCH::LoadExec(std::shared_ptr<Kernel::Process>& process)
             overlay_ncch->exheader_header.codeset_info.data.num_max_pages * Memory::PAGE_SIZE +
             bss_page_size;
 
-        // Apply patches now that the entire codeset (including .bss) has been allocated
-        const ResultStatus patch_result = overlay_ncch->ApplyCodePatch(code);
-        if (patch_result != ResultStatus::Success && patch_result != ResultStatus::ErrorNotUsed)
-            return patch_result;
-
         codeset->entrypoint = codeset->CodeSegment().addr;
         codeset->memory = std::move(code);
 
@@ -4,6 +4,7 @@
 
 #include <array>
 #include <cstring>
+#include <stdexcept>
 #include <boost/serialization/array.hpp>
 #include <boost/serialization/binary_object.hpp>
 #include "audio_core/dsp_interface.h"
@@ -19,6 +20,7 @@
 #include "core/hle/kernel/process.h"
 #include "core/hle/lock.h"
 #include "core/memory.h"
+#include "core/memory_snapshot.h"
 #include "core/settings.h"
 #include "video_core/renderer_base.h"
 #include "video_core/video_core.h"
@@ -93,6 +95,15 @@ public:
 
     AudioCore::DspInterface* dsp = nullptr;
 
+    /// Base used by incremental savestates, see MemorySystem::SetSnapshotBase
+    const SnapshotBase* snapshot_base = nullptr;
+    /// Whether the savestate currently being serialized is relative to snapshot_base
+    bool serialize_incremental = false;
+    /// Pages of each region stored by the last incremental savestate
+    std::vector<u32> last_vram_pages;
+    std::vector<u32> last_fcram_pages;
+    std::vector<u32> last_n3ds_extra_ram_pages;
+
     std::shared_ptr<BackingMem> fcram_mem;
     std::shared_ptr<BackingMem> vram_mem;
     std::shared_ptr<BackingMem> n3ds_extra_ram_mem;
@@ -151,11 +162,18 @@ private:
     void serialize(Archive& ar, const unsigned int file_version) {
         bool save_n3ds_ram = Settings::values.is_new_3ds;
         ar& save_n3ds_ram;
-        ar& boost::serialization::make_binary_object(vram.get(), Memory::VRAM_SIZE);
-        ar& boost::serialization::make_binary_object(
-            fcram.get(), save_n3ds_ram ? Memory::FCRAM_N3DS_SIZE : Memory::FCRAM_SIZE);
-        ar& boost::serialization::make_binary_object(
-            n3ds_extra_ram.get(), save_n3ds_ram ? Memory::N3DS_EXTRA_RAM_SIZE : 0);
+        const SnapshotBase* base = serialize_incremental ? snapshot_base : nullptr;
+        if (base && base->is_n3ds != save_n3ds_ram) {
+            throw std::runtime_error("Snapshot base was taken with a different system model");
+        }
+        SerializeRegion(ar, vram.get(), Memory::VRAM_SIZE, base ? &base->vram : nullptr,
+                        &last_vram_pages);
+        SerializeRegion(ar, fcram.get(),
+                        save_n3ds_ram ? Memory::FCRAM_N3DS_SIZE : Memory::FCRAM_SIZE,
+                        base ? &base->fcram : nullptr, &last_fcram_pages);
+        SerializeRegion(ar, n3ds_extra_ram.get(),
+                        save_n3ds_ram ? Memory::N3DS_EXTRA_RAM_SIZE : 0,
+                        base ? &base->n3ds_extra_ram : nullptr, &last_n3ds_extra_ram_pages);
         ar& cache_marker;
         ar& page_table_list;
         // dsp is set from Core::System at startup
@@ -205,7 +223,19 @@ MemorySystem::~MemorySystem() = default;
 
 template <class Archive>
 void MemorySystem::serialize(Archive& ar, const unsigned int file_version) {
+    // Incremental savestates store the id of their base, full ones store 0
+    u64 base_id = impl->snapshot_base ? impl->snapshot_base->id : 0;
+    if (file_version >= 1) {
+        ar& base_id;
+    } else {
+        base_id = 0;
+    }
+    if (base_id != 0 && (!impl->snapshot_base || impl->snapshot_base->id != base_id)) {
+        throw std::runtime_error("Savestate was made against a snapshot base that isn't loaded");
+    }
+    impl->serialize_incremental = base_id != 0;
     ar&* impl.get();
+    impl->serialize_incremental = false;
 }
 
 SERIALIZE_IMPL(MemorySystem)
@@ -610,6 +640,14 @@ void RasterizerClearAll(bool flush) {
     VideoCore::g_renderer->Rasterizer()->ClearAll(flush);
 }
 
+void RasterizerFlushAll() {
+    if (VideoCore::g_renderer == nullptr) {
+        return;
+    }
+
+    VideoCore::g_renderer->Rasterizer()->FlushAll();
+}
+
 void RasterizerFlushVirtualRegion(VAddr start, u32 size, FlushMode mode) {
     // Since pages are unmapped on shutdown after video core is shutdown, the renderer may be
     // null here
@@ -954,4 +992,31 @@ void MemorySystem::SetDSP(AudioCore::DspInterface& dsp) {
     impl->dsp = &dsp;
 }
 
+std::unique_ptr<SnapshotBase> MemorySystem::CreateSnapshotBase(u64 id) const {
+    auto base = std::make_unique<SnapshotBase>();
+    base->id = id;
+    base->is_n3ds = Settings::values.is_new_3ds;
+    const u8* vram = impl->vram.get();
+    const u8* fcram = impl->fcram.get();
+    const u8* n3ds_extra_ram = impl->n3ds_extra_ram.get();
+    base->vram.assign(vram, vram + VRAM_SIZE);
+    base->fcram.assign(fcram, fcram + (base->is_n3ds ? FCRAM_N3DS_SIZE : FCRAM_SIZE));
+    if (base->is_n3ds) {
+        base->n3ds_extra_ram.assign(n3ds_extra_ram, n3ds_extra_ram + N3DS_EXTRA_RAM_SIZE);
+    }
+    return base;
+}
+
+void MemorySystem::SetSnapshotBase(const SnapshotBase* base) {
+    impl->snapshot_base = base;
+}
+
+SnapshotPages MemorySystem::GetLastSnapshotPages() const {
+    SnapshotPages pages;
+    pages.vram = CopyPages(impl->vram.get(), impl->last_vram_pages);
+    pages.fcram = CopyPages(impl->fcram.get(), impl->last_fcram_pages);
+    pages.n3ds_extra_ram = CopyPages(impl->n3ds_extra_ram.get(), impl->last_n3ds_extra_ram_pages);
+    return pages;
+}
+
 } // namespace Memory
@@ -11,6 +11,7 @@
 #include <vector>
 #include <boost/serialization/array.hpp>
 #include <boost/serialization/vector.hpp>
+#include <boost/serialization/version.hpp>
 #include "common/common_types.h"
 #include "common/memory_ref.h"
 #include "core/mmio.h"
@@ -281,12 +282,31 @@ enum class FlushMode {
  */
 void RasterizerClearAll(bool flush);
 
+/// Flushes all the cached rasterizer resources to RAM, keeping them cached
+void RasterizerFlushAll();
+
 /**
  * Flushes and invalidates any externally cached rasterizer resources touching the given virtual
  * address region.
  */
 void RasterizerFlushVirtualRegion(VAddr start, u32 size, FlushMode mode);
 
+/**
+ * Copy of the emulated RAM taken at some point in time, used as the reference of incremental
+ * savestates. Such savestates only contain the pages that differ from their base, and are
+ * restored by applying those pages on top of it.
+ */
+struct SnapshotBase {
+    /// Identifies the base, so that incremental savestates can't be applied on the wrong one
+    u64 id = 0;
+    bool is_n3ds = false;
+    std::vector<u8> vram;
+    std::vector<u8> fcram;
+    std::vector<u8> n3ds_extra_ram;
+};
+
+struct SnapshotPages;
+
 class MemorySystem {
 public:
     MemorySystem();
@@ -377,6 +397,22 @@ public:
 
     void SetDSP(AudioCore::DspInterface& dsp);
 
+    /// Copies the current contents of the emulated RAM into a new snapshot base.
+    std::unique_ptr<SnapshotBase> CreateSnapshotBase(u64 id) const;
+
+    /**
+     * Sets the base used when serializing memory. While a base is set, saving only writes the
+     * pages that differ from it, and loading accepts savestates that were made against it.
+     * @param base The base to use, or nullptr to serialize the whole memory.
+     */
+    void SetSnapshotBase(const SnapshotBase* base);
+
+    /**
+     * Copies the RAM pages stored by the last incremental savestate. Must be called before the
+     * emulated memory changes again.
+     */
+    SnapshotPages GetLastSnapshotPages() const;
+
 private:
     template <typename T>
     T Read(const VAddr vaddr);
@@ -416,3 +452,4 @@ BOOST_CLASS_EXPORT_KEY(Memory::MemorySystem::BackingMemImpl<Memory::Region::FCRA
 BOOST_CLASS_EXPORT_KEY(Memory::MemorySystem::BackingMemImpl<Memory::Region::VRAM>)
 BOOST_CLASS_EXPORT_KEY(Memory::MemorySystem::BackingMemImpl<Memory::Region::DSP>)
 BOOST_CLASS_EXPORT_KEY(Memory::MemorySystem::BackingMemImpl<Memory::Region::N3DS>)
+BOOST_CLASS_VERSION(Memory::MemorySystem, 1)
@@ -0,0 +1,115 @@
+// Copyright 2020 Citra Emulator Project
+// Licensed under GPLv2 or any later version
+// Refer to the license.txt file included.
+
+#pragma once
+
+#include <cstddef>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include <vector>
+#include <boost/serialization/binary_object.hpp>
+#include <boost/serialization/vector.hpp>
+#include "common/common_types.h"
+#include "core/memory.h"
+
+namespace Memory {
+
+/**
+ * The RAM pages stored by an incremental savestate. Applying them on top of the base the
+ * savestate was made against gives the RAM at the time it was saved, which can serve as a newer
+ * base without reading the emulated memory again.
+ */
+struct SnapshotPages {
+    struct Region {
+        std::vector<u32> indices; ///< Index of each stored page in the region
+        std::vector<u8> data;     ///< Contents of the stored pages, in the same order
+    };
+    Region vram;
+    Region fcram;
+    Region n3ds_extra_ram;
+};
+
+/// Copies the specified pages of a RAM region.
+inline SnapshotPages::Region CopyPages(const u8* data, std::vector<u32> indices) {
+    SnapshotPages::Region region;
+    region.data.resize(indices.size() * PAGE_SIZE);
+    for (std::size_t i = 0; i < indices.size(); ++i) {
+        std::memcpy(region.data.data() + i * PAGE_SIZE, data + indices[i] * PAGE_SIZE, PAGE_SIZE);
+    }
+    region.indices = std::move(indices);
+    return region;
+}
+
+/**
+ * Creates a base from an older one and the pages of an incremental savestate made against it.
+ * Doesn't touch the emulated memory, so it can run on any thread.
+ * @param id The id of the new base
+ */
+inline std::unique_ptr<SnapshotBase> ApplySnapshotPages(const SnapshotBase& base,
+                                                        const SnapshotPages& pages, u64 id) {
+    auto result = std::make_unique<SnapshotBase>(base);
+    result->id = id;
+    const auto apply = [](std::vector<u8>& data, const SnapshotPages::Region& region) {
+        for (std::size_t i = 0; i < region.indices.size(); ++i) {
+            const std::size_t offset = region.indices[i] * std::size_t{PAGE_SIZE};
+            if (offset + PAGE_SIZE > data.size()) {
+                throw std::runtime_error("Snapshot page outside of the base");
+            }
+            std::memcpy(data.data() + offset, region.data.data() + i * PAGE_SIZE, PAGE_SIZE);
+        }
+    };
+    apply(result->vram, pages.vram);
+    apply(result->fcram, pages.fcram);
+    apply(result->n3ds_extra_ram, pages.n3ds_extra_ram);
+    return result;
+}
+
+/**
+ * Serializes a RAM region. When a base is given, only the pages that differ from it are written,
+ * and loading starts from the base before applying the stored pages.
+ * @param data The region contents
+ * @param size The region size, a multiple of PAGE_SIZE
+ * @param base Contents of the region in the snapshot base, or nullptr to serialize all of it
+ * @param stored_pages If not null, receives the indices of the pages written when saving
+ */
+template <class Archive>
+void SerializeRegion(Archive& ar, u8* data, std::size_t size, const std::vector<u8>* base,
+                     std::vector<u32>* stored_pages = nullptr) {
+    if (!base) {
+        ar& boost::serialization::make_binary_object(data, size);
+        if (stored_pages) {
+            stored_pages->clear();
+        }
+        return;
+    }
+    if (base->size() != size) {
+        throw std::runtime_error("Snapshot base doesn't match the emulated memory");
+    }
+
+    const std::size_t num_pages = size / PAGE_SIZE;
+    std::vector<u32> dirty_pages;
+    if (Archive::is_saving::value) {
+        for (std::size_t page = 0; page < num_pages; ++page) {
+            const std::size_t offset = page * PAGE_SIZE;
+            if (std::memcmp(data + offset, base->data() + offset, PAGE_SIZE) != 0) {
+                dirty_pages.push_back(static_cast<u32>(page));
+            }
+        }
+    } else {
+        std::memcpy(data, base->data(), size);
+    }
+    ar& dirty_pages;
+    for (const u32 page : dirty_pages) {
+        if (page >= num_pages) {
+            throw std::runtime_error("Invalid page in incremental savestate");
+        }
+        ar& boost::serialization::make_binary_object(data + page * PAGE_SIZE, PAGE_SIZE);
+    }
+    if (stored_pages && Archive::is_saving::value) {
+        *stored_pages = std::move(dirty_pages);
+    }
+}
+
+} // namespace Memory
@@ -2,24 +2,33 @@
 // Licensed under GPLv2 or any later version
 // Refer to the license.txt file included.
 
+#include <algorithm>
 #include <cstring>
+#include <limits>
+#include <optional>
+#include <stdexcept>
 #include <string>
 #include <vector>
 #include <boost/optional.hpp>
 #include <cryptopp/hex.h>
+#include "common/archives.h"
 #include "common/bit_field.h"
 #include "common/common_types.h"
 #include "common/file_util.h"
 #include "common/logging/log.h"
 #include "common/scm_rev.h"
+#include "common/scope_exit.h"
 #include "common/string_util.h"
 #include "common/swap.h"
 #include "common/timer.h"
+#include "common/zstd_compression.h"
 #include "core/core.h"
 #include "core/hle/service/hid/hid.h"
 #include "core/hle/service/ir/extra_hid.h"
 #include "core/hle/service/ir/ir_rst.h"
 #include "core/movie.h"
+#include "core/settings.h"
+#include "network/network.h"
 
 namespace Core {
 
@@ -117,12 +126,42 @@ struct CTMHeader {
     u64_le program_id;           /// ID of the ROM being executed. Also called title_id
     std::array<u8, 20> revision; /// Git hash of the revision this movie was created with
     u64_le clock_init_time;      /// The init time of the system clock
+    u32_le version;              /// Layout of the data following the header, see CTMVersion
+    u32_le anchor_count;         /// Number of CTMAnchor entries (Indexed version only)
+    u64_le input_size;           /// Size of the input data (Indexed version only)
+    u64_le frame_count;          /// Number of frame index entries (Indexed version only)
 
-    std::array<u8, 216> reserved; /// Make heading 256 bytes so it has consistent size
+    std::array<u8, 192> reserved; /// Make heading 256 bytes so it has consistent size
 };
 static_assert(sizeof(CTMHeader) == 256, "CTMHeader should be 256 bytes");
+
+/// Location of a compressed chunk of an anchor savestate in the anchor file
+struct CTMChunk {
+    u64_le offset;
+    u32_le compressed_size;
+    u32_le size;
+};
+static_assert(sizeof(CTMChunk) == 16, "CTMChunk should be 16 bytes");
 #pragma pack(pop)
 
+enum class CTMVersion : u32 {
+    /// The input data fills the rest of the file. The reserved bytes of the header were zero
+    /// before versions were introduced.
+    Flat = 0,
+    /// The input data is followed by the frame index (u64 offsets into the input data) and by the
+    /// anchors, whose savestates are stored in a side-car file named after the movie.
+    Indexed = 1,
+};
+
+/// Size of the chunks of anchor savestates before compression
+constexpr std::size_t AnchorChunkSize = 4 * 1024 * 1024;
+/// Anchors are taken while playing, so they are compressed for speed rather than size.
+constexpr s32 AnchorCompressionLevel = 1;
+
+static std::string GetAnchorFilePath(const std::string& movie_file) {
+    return movie_file + ".anchors";
+}
+
 bool Movie::IsPlayingInput() const {
     return play_mode == PlayMode::Playing;
 }
@@ -133,6 +172,9 @@ bool Movie::IsRecordingInput() const {
 void Movie::CheckInputEnd() {
     if (current_byte + sizeof(ControllerState) > recorded_input.size()) {
         LOG_INFO(Movie, "Playback finished");
+        if (seek_target_frame) {
+            FinishSeek();
+        }
         play_mode = PlayMode::None;
         init_time = 0;
         playback_completion_callback();
@@ -402,8 +444,16 @@ void Movie::SaveMovie() {
                            new CryptoPP::HexDecoder(new CryptoPP::StringSink(rev_bytes)));
     std::memcpy(header.revision.data(), rev_bytes.data(), sizeof(CTMHeader::revision));
 
+    header.version = static_cast<u32>(CTMVersion::Indexed);
+    header.anchor_count = static_cast<u32>(anchors.size());
+    header.input_size = recorded_input.size();
+    header.frame_count = frame_index.size();
+
+    std::vector<u64_le> index(frame_index.begin(), frame_index.end());
     save_record.WriteBytes(&header, sizeof(CTMHeader));
     save_record.WriteBytes(recorded_input.data(), recorded_input.size());
+    save_record.WriteBytes(index.data(), index.size() * sizeof(u64_le));
+    save_record.WriteBytes(anchors.data(), anchors.size() * sizeof(CTMAnchor));
 
     if (!save_record.IsGood()) {
         LOG_ERROR(Movie, "Error saving movie");
@@ -419,13 +469,51 @@ void Movie::StartPlayback(const std::string& movie_file,
     if (save_record.IsGood() && size > sizeof(CTMHeader)) {
         CTMHeader header;
         save_record.ReadArray(&header, 1);
-        if (ValidateHeader(header) != ValidationResult::Invalid) {
-            play_mode = PlayMode::Playing;
+        const ValidationResult result = ValidateHeader(header);
+        if (result == ValidationResult::Invalid) {
+            return;
+        }
+
+        frame_index.clear();
+        anchors.clear();
+        const u32 version = header.version;
+        switch (static_cast<CTMVersion>(version)) {
+        case CTMVersion::Flat:
             recorded_input.resize(size - sizeof(CTMHeader));
             save_record.ReadArray(recorded_input.data(), recorded_input.size());
-            current_byte = 0;
-            playback_completion_callback = completion_callback;
+            break;
+        case CTMVersion::Indexed: {
+            const u64 data_size = header.input_size + header.frame_count * sizeof(u64_le) +
+                                  header.anchor_count * sizeof(CTMAnchor);
+            if (data_size > size - sizeof(CTMHeader)) {
+                LOG_ERROR(Movie, "Failed to playback movie: '{}' is truncated", movie_file);
+                return;
+            }
+            recorded_input.resize(header.input_size);
+            save_record.ReadArray(recorded_input.data(), recorded_input.size());
+            std::vector<u64_le> index(header.frame_count);
+            save_record.ReadArray(index.data(), index.size());
+            frame_index.assign(index.begin(), index.end());
+
+            // Anchors are savestates, so they can only be restored by the same revision
+            anchors.resize(header.anchor_count);
+            save_record.ReadArray(anchors.data(), anchors.size());
+            anchor_file_path = GetAnchorFilePath(movie_file);
+            if (result != ValidationResult::OK || !FileUtil::Exists(anchor_file_path)) {
+                LOG_INFO(Movie, "Movie anchors are unavailable, seeking is disabled");
+                anchors.clear();
+            }
+            break;
+        }
+        default:
+            LOG_ERROR(Movie, "Failed to playback movie: unsupported format version {}", version);
+            return;
         }
+
+        play_mode = PlayMode::Playing;
+        current_byte = 0;
+        current_frame = 0;
+        playback_completion_callback = completion_callback;
     } else {
         LOG_ERROR(Movie, "Failed to playback movie: Unable to open '{}'", movie_file);
     }
@@ -435,6 +523,13 @@ void Movie::StartRecording(const std::string& movie_file) {
     LOG_INFO(Movie, "Enabling Movie recording");
     play_mode = PlayMode::Recording;
     record_movie_file = movie_file;
+    frame_index = {0};
+    current_frame = 0;
+    anchors.clear();
+    anchor_file_path = GetAnchorFilePath(movie_file);
+    anchor_file.Close();
+    next_anchor_frame =
+        GetNextAnchorFrame(anchors, current_frame, Settings::values.movie_anchor_interval_frames);
 }
 
 static boost::optional<CTMHeader> ReadHeader(const std::string& movie_file) {
@@ -496,6 +591,15 @@ void Movie::Shutdown() {
     record_movie_file.clear();
     current_byte = 0;
     init_time = 0;
+    frame_index.clear();
+    current_frame = 0;
+    anchors.clear();
+    anchor_file_path.clear();
+    anchor_file.Close();
+    if (seek_target_frame) {
+        seek_target_frame.reset();
+        System::GetInstance().frame_limiter.SetFastForward(false);
+    }
 }
 
 template <typename... Targs>
@@ -533,4 +637,202 @@ void Movie::HandleIrRst(Service::IR::PadState& pad_state, s16& c_stick_x, s16& c
 void Movie::HandleExtraHidResponse(Service::IR::ExtraHIDResponse& extra_hid_response) {
     Handle(extra_hid_response);
 }
+
+void Movie::HandleVBlank() {
+    if (IsPlayingInput()) {
+        ++current_frame;
+        if (seek_target_frame && current_frame >= *seek_target_frame) {
+            FinishSeek();
+        }
+    } else if (IsRecordingInput() && !frame_index.empty()) {
+        ++current_frame;
+        frame_index.push_back(current_byte);
+    }
+}
+
+u64 Movie::GetFrameCount() const {
+    // The index also holds the start of the frame in progress when the movie ended
+    return IsPlayingInput() && !frame_index.empty() ? frame_index.size() - 1 : 0;
+}
+
+u64 Movie::GetNextAnchorFrame(const std::vector<CTMAnchor>& anchors, u64 current_frame,
+                              u32 interval) {
+    if (interval == 0) {
+        return std::numeric_limits<u64>::max();
+    }
+    return anchors.empty() ? current_frame : static_cast<u64>(anchors.back().frame) + interval;
+}
+
+void Movie::Update() {
+    if (!IsRecordingInput() || current_frame < next_anchor_frame) {
+        return;
+    }
+
+    try {
+        CaptureAnchor();
+        next_anchor_frame = GetNextAnchorFrame(anchors, current_frame,
+                                               Settings::values.movie_anchor_interval_frames);
+    } catch (const std::exception& e) {
+        LOG_ERROR(Movie, "Disabling movie anchors, could not capture one: {}", e.what());
+        next_anchor_frame = std::numeric_limits<u64>::max();
+    }
+}
+
+void Movie::CaptureAnchor() {
+    if (!anchor_file.IsOpen()) {
+        anchor_file = FileUtil::IOFile(anchor_file_path, "wb");
+        if (!anchor_file) {
+            throw std::runtime_error("Could not open file " + anchor_file_path);
+        }
+    }
+
+    CTMAnchor anchor{};
+    anchor.frame = current_frame;
+    anchor.input_offset = current_byte;
+
+    // The movie input is kept out of the savestate, as it is already in the movie. Otherwise every
+    // anchor would carry all the input recorded before it.
+    std::vector<u8> input;
+    std::vector<u64> index;
+    std::swap(input, recorded_input);
+    std::swap(index, frame_index);
+    SCOPE_EXIT({
+        std::swap(input, recorded_input);
+        std::swap(index, frame_index);
+    });
+
+    std::optional<std::vector<Common::Compression::ZSTDChunk>> chunks;
+    {
+        Common::Compression::ZSTDChunkedCompressStreamBuf compressor{anchor_file, AnchorChunkSize,
+                                                                     AnchorCompressionLevel};
+        {
+            oarchive oa{compressor};
+            oa& System::GetInstance();
+        }
+        chunks = compressor.Finish();
+    }
+    if (!chunks) {
+        throw std::runtime_error("Could not write to file " + anchor_file_path);
+    }
+
+    std::vector<CTMChunk> chunk_index;
+    chunk_index.reserve(chunks->size());
+    for (const auto& chunk : *chunks) {
+        chunk_index.push_back({chunk.offset, chunk.compressed_size, chunk.size});
+    }
+    anchor.chunk_index_offset = anchor_file.Tell();
+    anchor.chunk_count = static_cast<u32>(chunk_index.size());
+    if (anchor_file.WriteArray(chunk_index.data(), chunk_index.size()) != chunk_index.size() ||
+        !anchor_file.Flush()) {
+        throw std::runtime_error("Could not write to file " + anchor_file_path);
+    }
+    anchors.push_back(anchor);
+}
+
+Movie::SeekPlan Movie::PlanSeek(const std::vector<CTMAnchor>& anchors, u64 current_frame,
+                                u64 target_frame) {
+    // Anchors are recorded in frame order
+    const auto itr = std::upper_bound(anchors.begin(), anchors.end(), target_frame,
+                                      [](u64 value, const CTMAnchor& anchor) {
+                                          return value < static_cast<u64>(anchor.frame);
+                                      });
+    const bool has_anchor = itr != anchors.begin();
+    const bool can_play_on = current_frame <= target_frame;
+
+    SeekPlan plan;
+    plan.possible = has_anchor || can_play_on;
+    if (has_anchor && !(can_play_on && std::prev(itr)->frame <= current_frame)) {
+        plan.anchor = static_cast<std::size_t>(std::prev(itr) - anchors.begin());
+    }
+    return plan;
+}
+
+bool Movie::SeekToFrame(u64 frame) {
+    if (!IsPlayingInput()) {
+        return false;
+    }
+    if (Network::GetRoomMember().lock()->IsConnected()) {
+        throw std::runtime_error("Unable to seek while connected to multiplayer");
+    }
+
+    const SeekPlan plan = PlanSeek(anchors, current_frame, frame);
+    if (!plan.possible) {
+        return false;
+    }
+
+    if (plan.anchor) {
+        const CTMAnchor anchor = anchors[*plan.anchor];
+        FileUtil::IOFile file(anchor_file_path, "rb");
+        std::vector<CTMChunk> chunk_index(anchor.chunk_count);
+        if (!file || !file.Seek(static_cast<s64>(anchor.chunk_index_offset), SEEK_SET) ||
+            file.ReadArray(chunk_index.data(), chunk_index.size()) != chunk_index.size()) {
+            throw std::runtime_error("Could not read from file at " + anchor_file_path);
+        }
+        std::vector<Common::Compression::ZSTDChunk> chunks;
+        chunks.reserve(chunk_index.size());
+        for (const auto& chunk : chunk_index) {
+            chunks.push_back({chunk.offset, chunk.compressed_size, chunk.size});
+        }
+
+        // The anchor doesn't contain the movie input, see CaptureAnchor
+        std::vector<u8> input;
+        std::vector<u64> index;
+        std::swap(input, recorded_input);
+        std::swap(index, frame_index);
+        SCOPE_EXIT({
+            std::swap(input, recorded_input);
+            std::swap(index, frame_index);
+        });
+
+        Common::Compression::ZSTDChunkedDecompressStreamBuf decompressor{file, std::move(chunks)};
+        iarchive ia{decompressor};
+        ia& System::GetInstance();
+
+        LOG_INFO(Movie, "Seeking to frame {} from the anchor at frame {}", frame,
+                 static_cast<u64>(anchor.frame));
+    } else {
+        LOG_INFO(Movie, "Seeking to frame {} from frame {}", frame, current_frame);
+    }
+
+    seek_target_frame = frame;
+    if (current_frame >= frame) {
+        FinishSeek();
+    } else {
+        System::GetInstance().frame_limiter.SetFastForward(true);
+    }
+    return true;
+}
+
+void Movie::FinishSeek() {
+    seek_target_frame.reset();
+    auto& frame_limiter = System::GetInstance().frame_limiter;
+    frame_limiter.SetFastForward(false);
+    frame_limiter.SetFrameAdvancing(true);
+}
+
+void Movie::DropStaleAnchors(std::vector<CTMAnchor>& anchors,
+                             const std::vector<u64>& frame_index, u64 current_frame) {
+    anchors.erase(std::remove_if(anchors.begin(), anchors.end(),
+                                 [&frame_index, current_frame](const CTMAnchor& anchor) {
+                                     return anchor.frame > current_frame ||
+                                            anchor.frame >= frame_index.size() ||
+                                            frame_index[anchor.frame] != anchor.input_offset;
+                                 }),
+                  anchors.end());
+}
+
+void Movie::OnStateLoaded() {
+    if (!IsRecordingInput()) {
+        return;
+    }
+    if (frame_index.empty()) {
+        LOG_WARNING(Movie, "The loaded state has no frame index, the movie won't be seekable");
+        anchors.clear();
+        next_anchor_frame = std::numeric_limits<u64>::max();
+        return;
+    }
+    DropStaleAnchors(anchors, frame_index, current_frame);
+    next_anchor_frame = GetNextAnchorFrame(anchors, current_frame,
+                                           Settings::values.movie_anchor_interval_frames);
+}
 } // namespace Core
@@ -5,8 +5,14 @@
 #pragma once
 
 #include <functional>
+#include <optional>
+#include <string>
+#include <vector>
 #include <boost/serialization/vector.hpp>
+#include <boost/serialization/version.hpp>
 #include "common/common_types.h"
+#include "common/file_util.h"
+#include "common/swap.h"
 
 namespace Service {
 namespace HID {
@@ -22,6 +28,19 @@ union PadState;
 } // namespace Service
 
 namespace Core {
+
+#pragma pack(push, 1)
+/// A savestate taken while recording, which playback can seek from
+struct CTMAnchor {
+    u64_le frame;              /// Frame at which the savestate was taken
+    u64_le input_offset;       /// Offset of the next input to play at that point
+    u64_le chunk_index_offset; /// Offset of the CTMChunk array in the anchor file
+    u32_le chunk_count;        /// Number of compressed chunks of the savestate
+    u32_le reserved;
+};
+static_assert(sizeof(CTMAnchor) == 32, "CTMAnchor should be 32 bytes");
+#pragma pack(pop)
+
 struct CTMHeader;
 struct ControllerState;
 enum class PlayMode;
@@ -96,6 +115,61 @@ public:
      * When playing: Replaces the given input states with the ones stored in the playback file
      */
     void HandleExtraHidResponse(Service::IR::ExtraHIDResponse& extra_hid_response);
+
+    /// Marks the end of an emulated frame, so that the input can be indexed by frame.
+    void HandleVBlank();
+
+    /**
+     * Captures a savestate anchor when one is due while recording. Must be called between CPU
+     * slices, like savestates.
+     */
+    void Update();
+
+    /**
+     * Seeks the movie being played back to the specified frame. The nearest anchor at or before
+     * it is restored, unless playing on from the current frame replays less input. Emulation then
+     * runs without frame limiting up to the frame, and pauses there with frame advancing. Must be
+     * called between CPU slices, like savestates.
+     * @returns false if the frame can't be reached: it is behind the current frame, and the movie
+     * has no anchor at or before it
+     */
+    bool SeekToFrame(u64 frame);
+
+    /// Returns the number of emulated frames recorded or played back so far.
+    u64 GetCurrentFrame() const {
+        return current_frame;
+    }
+
+    /// Returns the number of frames of the movie being played back, or 0 if it has no index.
+    u64 GetFrameCount() const;
+
+    /// How SeekToFrame reaches a frame
+    struct SeekPlan {
+        /// Whether the frame can be reached at all
+        bool possible = false;
+        /// Index of the anchor to restore first, or none to play on from the current frame
+        std::optional<std::size_t> anchor;
+    };
+
+    /**
+     * Chooses how to seek to a frame: by playing on from the current frame, or by restoring the
+     * closest anchor at or before the frame, whichever replays less input.
+     * @param anchors The anchors of the movie, in frame order
+     */
+    static SeekPlan PlanSeek(const std::vector<CTMAnchor>& anchors, u64 current_frame,
+                             u64 target_frame);
+
+    /// Returns the frame at which the next anchor is due while recording.
+    static u64 GetNextAnchorFrame(const std::vector<CTMAnchor>& anchors, u64 current_frame,
+                                  u32 interval);
+
+    /**
+     * Drops the anchors that don't belong to the recorded input, for when recording goes on from a
+     * loaded state: the ones taken after it, or on another branch of the recording.
+     */
+    static void DropStaleAnchors(std::vector<CTMAnchor>& anchors,
+                                 const std::vector<u64>& frame_index, u64 current_frame);
+
     bool IsPlayingInput() const;
     bool IsRecordingInput() const;
 
@@ -127,6 +201,14 @@ private:
 
     void SaveMovie();
 
+    void CaptureAnchor();
+
+    /// Drops the anchors that don't belong to the input restored by a savestate.
+    void OnStateLoaded();
+
+    /// Stops fast-forwarding to a seek target, and pauses emulation there.
+    void FinishSeek();
+
     PlayMode play_mode;
     std::string record_movie_file;
     std::vector<u8> recorded_input;
@@ -134,15 +216,39 @@ private:
     std::function<void()> playback_completion_callback;
     std::size_t current_byte = 0;
 
+    /// Offset into recorded_input where the input of each frame starts
+    std::vector<u64> frame_index;
+    u64 current_frame = 0;
+
+    /// Savestates to seek from, stored in a side-car file next to the movie
+    std::vector<CTMAnchor> anchors;
+    std::string anchor_file_path;
+    FileUtil::IOFile anchor_file;
+    u64 next_anchor_frame = 0;
+    /// Frame that playback is fast-forwarding to after a seek
+    std::optional<u64> seek_target_frame;
+
     template <class Archive>
-    void serialize(Archive& ar, const unsigned int) {
+    void serialize(Archive& ar, const unsigned int file_version) {
         // Only serialize what's needed to make savestates useful for TAS:
         u64 _current_byte = static_cast<u64>(current_byte);
         ar& _current_byte;
         current_byte = static_cast<std::size_t>(_current_byte);
         ar& recorded_input;
         ar& init_time;
+        if (file_version >= 1) {
+            ar& frame_index;
+            ar& current_frame;
+        } else {
+            frame_index.clear();
+            current_frame = 0;
+        }
+        if (Archive::is_loading::value) {
+            OnStateLoaded();
+        }
     }
     friend class boost::serialization::access;
 };
-} // namespace Core
\ No newline at end of file
+} // namespace Core
+
+BOOST_CLASS_VERSION(Core::Movie, 1)
\ No newline at end of file
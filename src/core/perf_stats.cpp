@@ -4,10 +4,12 @@
 
 #include <algorithm>
 #include <chrono>
+#include <cmath>
 #include <iterator>
 #include <mutex>
 #include <numeric>
 #include <thread>
+#include <vector>
 #include <fmt/chrono.h>
 #include <fmt/format.h>
 #include "common/file_util.h"
@@ -85,6 +87,22 @@ double PerfStats::GetMeanFrametime() const {
     return sum / static_cast<double>(current_index - IgnoreFrames);
 }
 
+double PerfStats::GetFrametimePercentile(double percentile) const {
+    std::lock_guard lock{object_mutex};
+
+    if (current_index <= IgnoreFrames) {
+        return 0;
+    }
+
+    std::vector<double> frametimes(perf_history.begin() + IgnoreFrames,
+                                   perf_history.begin() + current_index);
+    const double rank = std::clamp(percentile, 0.0, 100.0) / 100.0 *
+                        static_cast<double>(frametimes.size() - 1);
+    const auto nth = frametimes.begin() + static_cast<std::ptrdiff_t>(std::ceil(rank));
+    std::nth_element(frametimes.begin(), nth, frametimes.end());
+    return *nth;
+}
+
 PerfStats::Results PerfStats::GetAndResetStats(microseconds current_system_time_us) {
     std::lock_guard lock(object_mutex);
 
@@ -119,7 +137,7 @@ double PerfStats::GetLastFrameTimeScale() const {
 }
 
 void FrameLimiter::WaitOnce() {
-    if (frame_advancing_enabled) {
+    if (frame_advancing_enabled && !fast_forward) {
         // Frame advancing is enabled: wait on event instead of doing framelimiting
         frame_advance_event.Wait();
         frame_advance_event.Reset();
@@ -127,6 +145,13 @@ void FrameLimiter::WaitOnce() {
 }
 
 void FrameLimiter::DoFrameLimiting(microseconds current_system_time_us) {
+    if (fast_forward) {
+        // Keep track of the time, so that limiting resumes smoothly afterwards
+        previous_system_time_us = current_system_time_us;
+        previous_walltime = Clock::now();
+        return;
+    }
+
     if (frame_advancing_enabled) {
         // Frame advancing is enabled: wait on event instead of doing framelimiting
         frame_advance_event.Wait();
@@ -181,4 +206,8 @@ void FrameLimiter::AdvanceFrame() {
     frame_advance_event.Set();
 }
 
+void FrameLimiter::SetFastForward(bool value) {
+    fast_forward = value;
+}
+
 } // namespace Core
@@ -47,6 +47,13 @@ public:
      */
     double GetMeanFrametime() const;
 
+    /**
+     * Returns the frametime, in milliseconds, that the given percentage of the frametime values
+     * stored in the performance history don't exceed.
+     * @param percentile Percentage in the range [0, 100]
+     */
+    double GetFrametimePercentile(double percentile) const;
+
     /**
      * Gets the ratio between walltime and the emulated time of the previous system frame. This is
      * useful for scaling inputs or outputs moving between the two time domains.
@@ -99,6 +106,10 @@ public:
     void AdvanceFrame();
     void WaitOnce();
 
+    /// Sets whether emulation runs as fast as possible, ignoring frame limiting and frame
+    /// advancing. Used to reach the target of a movie seek.
+    void SetFastForward(bool value);
+
 private:
     /// Emulated system time (in microseconds) at the last limiter invocation
     std::chrono::microseconds previous_system_time_us{0};
@@ -111,6 +122,9 @@ private:
     /// Whether to use frame advancing (i.e. frame by frame)
     std::atomic_bool frame_advancing_enabled;
 
+    /// Whether frame limiting and frame advancing are skipped
+    std::atomic_bool fast_forward{false};
+
     /// Event to advance the frame when frame advancing is enabled
     Common::Event frame_advance_event;
 };
@@ -0,0 +1,260 @@
+// Copyright 2020 Citra Emulator Project
+// Licensed under GPLv2 or any later version
+// Refer to the license.txt file included.
+
+#include <algorithm>
+#include <exception>
+#include "common/logging/log.h"
+#include "common/thread.h"
+#include "common/zstd_compression.h"
+#include "core/core.h"
+#include "core/core_timing.h"
+#include "core/hw/gpu.h"
+#include "core/rewind.h"
+
+namespace Core {
+
+/// Snapshots are compressed for speed rather than size, as they are short-lived.
+constexpr s32 CompressionLevel = 1;
+
+/// A new base is taken once a snapshot exceeds this fraction of the size of its base, so that
+/// snapshots stay small when the game touches a lot of memory over time.
+constexpr std::size_t RebaseRatio = 8;
+
+static std::size_t GetBaseSize(const Memory::SnapshotBase& base) {
+    return base.vram.size() + base.fcram.size() + base.n3ds_extra_ram.size();
+}
+
+namespace {
+
+class SystemRewindTarget final : public RewindTarget {
+public:
+    explicit SystemRewindTarget(System& system) : system(system) {}
+
+    u64 GetTicks() const override {
+        return system.CoreTiming().GetGlobalTicks();
+    }
+
+    std::shared_ptr<const Memory::SnapshotBase> GetOrCreateSnapshotBase() override {
+        if (!system.GetSnapshotBase()) {
+            system.CreateSnapshotBase();
+        }
+        return system.GetSnapshotBase();
+    }
+
+    void SetSnapshotBase(std::shared_ptr<const Memory::SnapshotBase> base) override {
+        system.SetSnapshotBase(std::move(base));
+    }
+
+    u64 NewSnapshotBaseId() override {
+        return system.NewSnapshotBaseId();
+    }
+
+    std::vector<u8> SaveIncrementalState() override {
+        return system.SaveIncrementalState();
+    }
+
+    Memory::SnapshotPages GetLastSnapshotPages() override {
+        return system.Memory().GetLastSnapshotPages();
+    }
+
+    void LoadIncrementalState(const std::vector<u8>& state) override {
+        system.LoadIncrementalState(state);
+    }
+
+private:
+    System& system;
+};
+
+} // Anonymous namespace
+
+RewindBuffer::RewindBuffer(System& system, u32 interval_frames, std::size_t budget)
+    : RewindBuffer(std::make_unique<SystemRewindTarget>(system),
+                   std::max<u32>(interval_frames, 1) * GPU::frame_ticks, budget) {}
+
+RewindBuffer::RewindBuffer(std::unique_ptr<RewindTarget> target, u64 interval_ticks,
+                           std::size_t budget)
+    : target(std::move(target)), interval_ticks(std::max<u64>(interval_ticks, 1)),
+      budget(budget) {
+    worker_thread = std::thread([this] { WorkerLoop(); });
+}
+
+RewindBuffer::~RewindBuffer() {
+    {
+        std::lock_guard lock{mutex};
+        stop = true;
+    }
+    pending_cv.notify_one();
+    worker_thread.join();
+}
+
+void RewindBuffer::Update() {
+    if (!enabled) {
+        return;
+    }
+    const u64 ticks = target->GetTicks();
+    if (ticks < next_capture_ticks) {
+        return;
+    }
+    next_capture_ticks = ticks + interval_ticks;
+
+    try {
+        Capture(ticks);
+    } catch (const std::exception& e) {
+        LOG_ERROR(Core, "Disabling rewind, could not capture a snapshot: {}", e.what());
+        enabled = false;
+    }
+}
+
+void RewindBuffer::Capture(u64 ticks) {
+    {
+        std::lock_guard lock{mutex};
+        if (rebased) {
+            target->SetSnapshotBase(std::move(rebased));
+            rebased = nullptr;
+            rebasing = false;
+        }
+    }
+
+    auto snapshot = std::make_shared<Snapshot>();
+    snapshot->ticks = ticks;
+    snapshot->base = target->GetOrCreateSnapshotBase();
+    snapshot->data = target->SaveIncrementalState();
+    const std::size_t size = snapshot->data.size();
+
+    // Copying the whole RAM for a new base would stall emulation, so the worker thread builds it
+    // from the current base and the few pages this snapshot stores instead.
+    std::optional<RebaseRequest> request;
+    if (size > GetBaseSize(*snapshot->base) / RebaseRatio) {
+        std::lock_guard lock{mutex};
+        if (!rebasing) {
+            LOG_DEBUG(Core, "Taking a new rewind base, last snapshot was {} bytes", size);
+            request = RebaseRequest{snapshot->base, {}, target->NewSnapshotBaseId()};
+        }
+    }
+    if (request) {
+        request->pages = target->GetLastSnapshotPages();
+    }
+
+    {
+        std::lock_guard lock{mutex};
+        snapshots.push_back(snapshot);
+        pending.push_back(snapshot);
+        if (request) {
+            rebase_request = std::move(request);
+            rebasing = true;
+        }
+        Trim();
+    }
+    pending_cv.notify_one();
+}
+
+bool RewindBuffer::Rewind(u32 steps) {
+    std::shared_ptr<Snapshot> snapshot;
+    std::vector<u8> state;
+    {
+        std::lock_guard lock{mutex};
+        if (steps == 0 || snapshots.empty()) {
+            return false;
+        }
+        steps = std::min<u32>(steps, static_cast<u32>(snapshots.size()));
+        snapshot = snapshots[snapshots.size() - steps];
+        snapshots.erase(snapshots.end() - steps, snapshots.end());
+        state = snapshot->compressed ? Common::Compression::DecompressDataZSTD(snapshot->data)
+                                     : snapshot->data;
+    }
+
+    target->SetSnapshotBase(snapshot->base);
+    target->LoadIncrementalState(state);
+    next_capture_ticks = snapshot->ticks + interval_ticks;
+    return true;
+}
+
+std::size_t RewindBuffer::GetSnapshotCount() const {
+    std::lock_guard lock{mutex};
+    return snapshots.size();
+}
+
+std::size_t RewindBuffer::GetMemoryUsage() const {
+    std::lock_guard lock{mutex};
+    return ComputeMemoryUsage();
+}
+
+void RewindBuffer::Clear() {
+    std::lock_guard lock{mutex};
+    snapshots.clear();
+    pending.clear();
+    rebase_request.reset();
+    rebased = nullptr;
+    rebasing = false;
+    next_capture_ticks = 0;
+}
+
+void RewindBuffer::WorkerLoop() {
+    Common::SetCurrentThreadName("RewindWorker");
+
+    std::unique_lock lock{mutex};
+    while (true) {
+        pending_cv.wait(lock, [this] { return stop || !pending.empty() || rebase_request; });
+        if (stop) {
+            return;
+        }
+
+        if (rebase_request) {
+            RebaseRequest request = std::move(*rebase_request);
+            rebase_request.reset();
+
+            lock.unlock();
+            std::shared_ptr<const Memory::SnapshotBase> base =
+                Memory::ApplySnapshotPages(*request.base, request.pages, request.id);
+            lock.lock();
+
+            // Dropped if the buffer was cleared in the meantime
+            if (rebasing) {
+                rebased = std::move(base);
+            }
+            continue;
+        }
+
+        const std::shared_ptr<Snapshot> snapshot = std::move(pending.front());
+        pending.pop_front();
+
+        // The data is only replaced by this thread, so it can be read without the lock.
+        lock.unlock();
+        std::vector<u8> compressed = Common::Compression::CompressDataZSTD(
+            snapshot->data.data(), snapshot->data.size(), CompressionLevel);
+        lock.lock();
+
+        snapshot->data = std::move(compressed);
+        snapshot->compressed = true;
+        Trim();
+    }
+}
+
+std::size_t RewindBuffer::ComputeMemoryUsage() const {
+    std::size_t usage = 0;
+    const Memory::SnapshotBase* last_base = nullptr;
+    for (const auto& snapshot : snapshots) {
+        usage += snapshot->data.size();
+        // Bases are only ever replaced by newer ones, so snapshots sharing one are adjacent.
+        if (snapshot->base.get() != last_base) {
+            last_base = snapshot->base.get();
+            usage += GetBaseSize(*last_base);
+        }
+    }
+    return usage;
+}
+
+void RewindBuffer::Trim() {
+    std::size_t usage = ComputeMemoryUsage();
+    while (snapshots.size() > 1 && usage > budget) {
+        const auto& oldest = snapshots.front();
+        usage -= oldest->data.size();
+        if (snapshots[1]->base != oldest->base) {
+            usage -= GetBaseSize(*oldest->base);
+        }
+        snapshots.pop_front();
+    }
+}
+
+} // namespace Core
@@ -0,0 +1,142 @@
+// Copyright 2020 Citra Emulator Project
+// Licensed under GPLv2 or any later version
+// Refer to the license.txt file included.
+
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <vector>
+#include "common/common_types.h"
+#include "core/memory_snapshot.h"
+
+namespace Core {
+
+class System;
+
+/**
+ * The emulated state captured and restored by a RewindBuffer. The buffer uses System through this
+ * interface, which lets it be tested without running an application.
+ */
+class RewindTarget {
+public:
+    virtual ~RewindTarget() = default;
+
+    /// Returns the current emulated time, in ticks.
+    virtual u64 GetTicks() const = 0;
+
+    /// Returns the current snapshot base, taking one from the emulated memory if there is none.
+    virtual std::shared_ptr<const Memory::SnapshotBase> GetOrCreateSnapshotBase() = 0;
+
+    /// Makes the base current, for the following captures and restores.
+    virtual void SetSnapshotBase(std::shared_ptr<const Memory::SnapshotBase> base) = 0;
+
+    /// Returns an id for a new snapshot base.
+    virtual u64 NewSnapshotBaseId() = 0;
+
+    /// Serializes the emulated state relative to the current base.
+    virtual std::vector<u8> SaveIncrementalState() = 0;
+
+    /// Copies the RAM pages stored by the last call to SaveIncrementalState.
+    virtual Memory::SnapshotPages GetLastSnapshotPages() = 0;
+
+    /// Restores a state created by SaveIncrementalState against the current base.
+    virtual void LoadIncrementalState(const std::vector<u8>& state) = 0;
+};
+
+/**
+ * Keeps a bounded ring of recent in-memory savestates, so that emulation can be stepped backwards
+ * without touching the disk. Snapshots are incremental savestates captured every few emulated
+ * frames, and are compressed on a worker thread. The oldest snapshots are dropped once the memory
+ * budget is exceeded.
+ */
+class RewindBuffer {
+public:
+    /**
+     * @param system The system to capture
+     * @param interval_frames Number of emulated frames between two snapshots
+     * @param budget Maximum amount of memory used by the snapshots and their bases, in bytes
+     */
+    RewindBuffer(System& system, u32 interval_frames, std::size_t budget);
+
+    /**
+     * @param target The state to capture
+     * @param interval_ticks Number of emulated ticks between two snapshots
+     * @param budget Maximum amount of memory used by the snapshots and their bases, in bytes
+     */
+    RewindBuffer(std::unique_ptr<RewindTarget> target, u64 interval_ticks, std::size_t budget);
+
+    ~RewindBuffer();
+
+    /**
+     * Captures a snapshot if enough emulated time passed since the previous one. Must be called
+     * from the emulation thread, outside of CPU execution.
+     */
+    void Update();
+
+    /**
+     * Restores an earlier snapshot, dropping it and every newer one.
+     * @param steps How many snapshots to go back. 1 restores the most recent one.
+     * @returns false if there is no snapshot to restore.
+     */
+    bool Rewind(u32 steps);
+
+    /// Returns the number of snapshots currently stored.
+    std::size_t GetSnapshotCount() const;
+
+    /// Returns the amount of memory used by the snapshots and their bases, in bytes.
+    std::size_t GetMemoryUsage() const;
+
+    /// Drops every snapshot, for when the emulated state is replaced by another timeline.
+    void Clear();
+
+private:
+    struct Snapshot {
+        u64 ticks = 0;
+        std::shared_ptr<const Memory::SnapshotBase> base;
+        /// Serialized state, compressed once `compressed` is set
+        std::vector<u8> data;
+        bool compressed = false;
+    };
+
+    /// A newer base to build from the base of a snapshot and the pages it stores.
+    struct RebaseRequest {
+        std::shared_ptr<const Memory::SnapshotBase> base;
+        Memory::SnapshotPages pages;
+        u64 id = 0;
+    };
+
+    void Capture(u64 ticks);
+    void WorkerLoop();
+
+    /// Computes the memory usage. The mutex must be held.
+    std::size_t ComputeMemoryUsage() const;
+
+    /// Drops the oldest snapshots until the memory budget is respected. The mutex must be held.
+    void Trim();
+
+    std::unique_ptr<RewindTarget> target;
+    const u64 interval_ticks;
+    const std::size_t budget;
+    u64 next_capture_ticks = 0;
+    bool enabled = true;
+
+    mutable std::mutex mutex;
+    std::condition_variable pending_cv;
+    std::deque<std::shared_ptr<Snapshot>> snapshots;
+    std::deque<std::shared_ptr<Snapshot>> pending;
+    std::optional<RebaseRequest> rebase_request;
+    /// Base built by the worker thread, made current on the next capture
+    std::shared_ptr<const Memory::SnapshotBase> rebased;
+    /// Whether a rebase was requested and its base wasn't made current yet
+    bool rebasing = false;
+    bool stop = false;
+    std::thread worker_thread;
+};
+
+} // namespace Core
@@ -4,8 +4,8 @@
 
 #pragma once
 
-#include <array>
 #include <functional>
+#include <vector>
 #include "common/common_types.h"
 
 namespace RPC {
@@ -14,6 +14,12 @@ enum class PacketType {
     Undefined = 0,
     ReadMemory,
     WriteMemory,
+    // Version 2
+    ReadMemoryRanges,
+    Subscribe,
+    Unsubscribe,
+    SubscriptionUpdate,
+    RenewSubscription,
 };
 
 struct PacketHeader {
@@ -23,15 +29,38 @@ struct PacketHeader {
     u32 packet_size;
 };
 
-constexpr u32 CURRENT_VERSION = 1;
+/// Version 2 adds large packets, scatter/gather reads and subscriptions
+constexpr u32 CURRENT_VERSION = 2;
 constexpr u32 MIN_PACKET_SIZE = sizeof(PacketHeader);
-constexpr u32 MAX_PACKET_DATA_SIZE = 32;
+/// Largest packet payload, chosen to fit in a single UDP datagram
+constexpr u32 MAX_PACKET_DATA_SIZE = 60 * 1024;
 constexpr u32 MAX_PACKET_SIZE = MIN_PACKET_SIZE + MAX_PACKET_DATA_SIZE;
 constexpr u32 MAX_READ_SIZE = MAX_PACKET_DATA_SIZE;
+/// Largest packet payload accepted from and sent to version 1 clients
+constexpr u32 V1_MAX_PACKET_DATA_SIZE = 32;
+constexpr u32 V1_MAX_READ_SIZE = V1_MAX_PACKET_DATA_SIZE;
+/// Maximum number of ranges in a ReadMemoryRanges or Subscribe request
+constexpr u32 MAX_RANGE_COUNT = 256;
+
+/// Returns the largest packet payload allowed for the given protocol version.
+constexpr u32 GetMaxPacketDataSize(u32 version) {
+    return version >= 2 ? MAX_PACKET_DATA_SIZE : V1_MAX_PACKET_DATA_SIZE;
+}
+
+/// Time after which a subscription that wasn't renewed is dropped, so that clients which went
+/// away without unsubscribing don't keep theirs forever
+constexpr u32 SUBSCRIPTION_LEASE_SECONDS = 10;
+
+/// Subscription flags
+enum SubscriptionFlags : u32 {
+    /// Only send an update when the contents of the ranges changed since the previous one
+    SubscribeOnChange = 1 << 0,
+};
 
 class Packet {
 public:
-    Packet(const PacketHeader& header, u8* data, std::function<void(Packet&)> send_reply_callback);
+    Packet(const PacketHeader& header, const u8* data,
+           std::function<void(Packet&)> send_reply_callback);
 
     u32 GetVersion() const {
         return header.version;
@@ -53,12 +82,22 @@ public:
         return header;
     }
 
-    std::array<u8, MAX_PACKET_DATA_SIZE>& GetPacketData() {
+    std::vector<u8>& GetPacketData() {
+        return packet_data;
+    }
+
+    const std::vector<u8>& GetPacketData() const {
         return packet_data;
     }
 
+    void SetPacketType(PacketType type) {
+        header.packet_type = type;
+    }
+
+    /// Sets the size of the payload, resizing the data buffer to match.
     void SetPacketDataSize(u32 size) {
         header.packet_size = size;
+        packet_data.resize(size);
     }
 
     void SendReply() {
@@ -66,11 +105,8 @@ public:
     }
 
 private:
-    void HandleReadMemory(u32 address, u32 data_size);
-    void HandleWriteMemory(u32 address, const u8* data, u32 data_size);
-
     struct PacketHeader header;
-    std::array<u8, MAX_PACKET_DATA_SIZE> packet_data;
+    std::vector<u8> packet_data;
 
     std::function<void(Packet&)> send_reply_callback;
 };
@@ -1,6 +1,10 @@
+#include <cstring>
+#include <numeric>
+#include "common/hash.h"
 #include "common/logging/log.h"
 #include "core/arm/arm_interface.h"
 #include "core/core.h"
+#include "core/core_timing.h"
 #include "core/hle/kernel/process.h"
 #include "core/memory.h"
 #include "core/rpc/packet.h"
@@ -8,6 +12,11 @@
 
 namespace RPC {
 
+/// Maximum number of subscriptions, as their updates are read on the emulation thread
+constexpr std::size_t MAX_SUBSCRIPTIONS = 64;
+
+constexpr std::chrono::seconds SUBSCRIPTION_LEASE{SUBSCRIPTION_LEASE_SECONDS};
+
 RPCServer::RPCServer() : server(*this) {
     LOG_INFO(RPC_Server, "Starting RPC server ...");
 
@@ -28,20 +37,23 @@ void RPCServer::HandleReadMemory(Packet& packet, u32 address, u32 data_size) {
     if (data_size > MAX_READ_SIZE) {
         return;
     }
+    packet.SetPacketDataSize(data_size);
 
     // Note: Memory read occurs asynchronously from the state of the emulator
     Core::System::GetInstance().Memory().ReadBlock(
         *Core::System::GetInstance().Kernel().GetCurrentProcess(), address,
         packet.GetPacketData().data(), data_size);
-    packet.SetPacketDataSize(data_size);
     packet.SendReply();
 }
 
 void RPCServer::HandleWriteMemory(Packet& packet, u32 address, const u8* data, u32 data_size) {
-    // Only allow writing to certain memory regions
-    if ((address >= Memory::PROCESS_IMAGE_VADDR && address <= Memory::PROCESS_IMAGE_VADDR_END) ||
-        (address >= Memory::HEAP_VADDR && address <= Memory::HEAP_VADDR_END) ||
-        (address >= Memory::N3DS_EXTRA_RAM_VADDR && address <= Memory::N3DS_EXTRA_RAM_VADDR_END)) {
+    // Only allow writing to certain memory regions, and only within one of them
+    const auto in_region = [address, data_size](u32 begin, u32 end) {
+        return address >= begin && address < end && data_size <= end - address;
+    };
+    if (in_region(Memory::PROCESS_IMAGE_VADDR, Memory::PROCESS_IMAGE_VADDR_END) ||
+        in_region(Memory::HEAP_VADDR, Memory::HEAP_VADDR_END) ||
+        in_region(Memory::N3DS_EXTRA_RAM_VADDR, Memory::N3DS_EXTRA_RAM_VADDR_END)) {
         // Note: Memory write occurs asynchronously from the state of the emulator
         Core::System::GetInstance().Memory().WriteBlock(
             *Core::System::GetInstance().Kernel().GetCurrentProcess(), address, data, data_size);
@@ -54,47 +66,226 @@ void RPCServer::HandleWriteMemory(Packet& packet, u32 address, const u8* data, u
     packet.SendReply();
 }
 
-bool RPCServer::ValidatePacket(const PacketHeader& packet_header) {
-    if (packet_header.version <= CURRENT_VERSION) {
-        switch (packet_header.packet_type) {
-        case PacketType::ReadMemory:
-        case PacketType::WriteMemory:
-            if (packet_header.packet_size >= (sizeof(u32) * 2)) {
-                return true;
+void RPCServer::HandleReadMemoryRanges(Packet& packet, const std::vector<MemoryRange>& ranges) {
+    const u32 total_size = std::accumulate(
+        ranges.begin(), ranges.end(), u32{0},
+        [](u32 sum, const MemoryRange& range) { return sum + range.size; });
+
+    // Note: Memory read occurs asynchronously from the state of the emulator
+    packet.SetPacketDataSize(total_size);
+    ReadRanges(ranges, packet.GetPacketData().data());
+    packet.SendReply();
+}
+
+void RPCServer::HandleSubscribe(std::unique_ptr<Packet> packet, u32 flags,
+                                std::vector<MemoryRange> ranges) {
+    u32 subscription_id = 0;
+    {
+        std::lock_guard lock{subscription_mutex};
+        RemoveExpiredSubscriptions();
+        if (subscriptions.size() < MAX_SUBSCRIPTIONS) {
+            subscription_id = next_subscription_id++;
+        }
+    }
+
+    // The reply holds the id of the new subscription, or 0 if there are too many of them
+    packet->SetPacketDataSize(sizeof(subscription_id));
+    std::memcpy(packet->GetPacketData().data(), &subscription_id, sizeof(subscription_id));
+    packet->SendReply();
+
+    if (subscription_id != 0) {
+        packet->SetPacketType(PacketType::SubscriptionUpdate);
+        auto subscription = std::make_shared<Subscription>();
+        subscription->packet = std::move(packet);
+        subscription->ranges = std::move(ranges);
+        subscription->flags = flags;
+        subscription->expiry = std::chrono::steady_clock::now() + SUBSCRIPTION_LEASE;
+        std::lock_guard lock{subscription_mutex};
+        subscriptions.emplace(subscription_id, std::move(subscription));
+    }
+}
+
+void RPCServer::HandleUnsubscribe(Packet& packet, u32 subscription_id) {
+    {
+        std::lock_guard lock{subscription_mutex};
+        subscriptions.erase(subscription_id);
+    }
+    packet.SetPacketDataSize(0);
+    packet.SendReply();
+}
+
+void RPCServer::HandleRenewSubscription(Packet& packet, u32 subscription_id) {
+    // The reply is 1 if the subscription was renewed, or 0 if it doesn't exist (anymore)
+    u32 renewed = 0;
+    {
+        std::lock_guard lock{subscription_mutex};
+        RemoveExpiredSubscriptions();
+        const auto itr = subscriptions.find(subscription_id);
+        if (itr != subscriptions.end()) {
+            itr->second->expiry = std::chrono::steady_clock::now() + SUBSCRIPTION_LEASE;
+            renewed = 1;
+        }
+    }
+    packet.SetPacketDataSize(sizeof(renewed));
+    std::memcpy(packet.GetPacketData().data(), &renewed, sizeof(renewed));
+    packet.SendReply();
+}
+
+void RPCServer::RemoveExpiredSubscriptions() {
+    const auto now = std::chrono::steady_clock::now();
+    for (auto itr = subscriptions.begin(); itr != subscriptions.end();) {
+        if (itr->second->expiry <= now) {
+            LOG_DEBUG(RPC_Server, "Subscription {} expired", itr->first);
+            itr = subscriptions.erase(itr);
+        } else {
+            ++itr;
+        }
+    }
+}
+
+void RPCServer::OnVBlank() {
+    auto& system = Core::System::GetInstance();
+    server.OnVBlank(system.Memory(), system.CoreTiming().GetGlobalTicks());
+
+    // The updates are built without the lock, so that requests aren't held up by the memory reads.
+    // Subscriptions dropped in the meantime are kept alive until their last update is sent.
+    std::vector<std::pair<u32, std::shared_ptr<Subscription>>> active;
+    {
+        std::lock_guard lock{subscription_mutex};
+        if (subscriptions.empty()) {
+            return;
+        }
+        RemoveExpiredSubscriptions();
+        active.assign(subscriptions.begin(), subscriptions.end());
+    }
+    for (auto& [id, subscription_ptr] : active) {
+        Subscription& subscription = *subscription_ptr;
+        Packet& packet = *subscription.packet;
+        const u32 data_size = std::accumulate(
+            subscription.ranges.begin(), subscription.ranges.end(), u32{sizeof(id)},
+            [](u32 sum, const MemoryRange& range) { return sum + range.size; });
+        packet.SetPacketDataSize(data_size);
+        std::memcpy(packet.GetPacketData().data(), &id, sizeof(id));
+        ReadRanges(subscription.ranges, packet.GetPacketData().data() + sizeof(id));
+
+        if (subscription.flags & SubscribeOnChange) {
+            const u64 hash = Common::ComputeHash64(packet.GetPacketData().data() + sizeof(id),
+                                                   data_size - sizeof(id));
+            if (subscription.has_sent_update && hash == subscription.last_hash) {
+                continue;
             }
-            break;
-        default:
-            break;
+            subscription.last_hash = hash;
         }
+        subscription.has_sent_update = true;
+        packet.SendReply();
+    }
+}
+
+bool RPCServer::ParseRanges(const u8* data, std::size_t size, u32 max_total_size,
+                            std::vector<MemoryRange>& ranges) {
+    u32 count = 0;
+    if (size < sizeof(count)) {
+        return false;
+    }
+    std::memcpy(&count, data, sizeof(count));
+    if (count == 0 || count > MAX_RANGE_COUNT ||
+        size != sizeof(count) + count * sizeof(MemoryRange)) {
+        return false;
+    }
+
+    ranges.resize(count);
+    std::memcpy(ranges.data(), data + sizeof(count), count * sizeof(MemoryRange));
+
+    u64 total_size = 0;
+    for (const MemoryRange& range : ranges) {
+        total_size += range.size;
+    }
+    return total_size > 0 && total_size <= max_total_size;
+}
+
+void RPCServer::ReadRanges(const std::vector<MemoryRange>& ranges, u8* output) {
+    auto& system = Core::System::GetInstance();
+    const auto& process = *system.Kernel().GetCurrentProcess();
+    for (const MemoryRange& range : ranges) {
+        system.Memory().ReadBlock(process, range.address, output, range.size);
+        output += range.size;
+    }
+}
+
+bool RPCServer::ValidatePacket(const PacketHeader& packet_header) {
+    if (packet_header.version == 0 || packet_header.version > CURRENT_VERSION ||
+        packet_header.packet_size > GetMaxPacketDataSize(packet_header.version)) {
+        return false;
+    }
+    switch (packet_header.packet_type) {
+    case PacketType::ReadMemory:
+    case PacketType::WriteMemory:
+        return packet_header.packet_size >= (sizeof(u32) * 2);
+    case PacketType::ReadMemoryRanges:
+    case PacketType::Unsubscribe:
+    case PacketType::RenewSubscription:
+        return packet_header.version >= 2 && packet_header.packet_size >= sizeof(u32);
+    case PacketType::Subscribe:
+        return packet_header.version >= 2 && packet_header.packet_size >= (sizeof(u32) * 2);
+    default:
+        return false;
     }
-    return false;
 }
 
 void RPCServer::HandleSingleRequest(std::unique_ptr<Packet> request_packet) {
     bool success = false;
 
     if (ValidatePacket(request_packet->GetHeader())) {
-        // Currently, all request types use the address/data_size wire format
+        const u32 max_data_size = GetMaxPacketDataSize(request_packet->GetVersion());
+        const u8* request_data = request_packet->GetPacketData().data();
+        const std::size_t request_size = request_packet->GetPacketDataSize();
+
+        // The first two words hold the address/data_size for memory requests, and the range
+        // count/first address or the flags/range count for the others.
         u32 address = 0;
         u32 data_size = 0;
-        std::memcpy(&address, request_packet->GetPacketData().data(), sizeof(address));
-        std::memcpy(&data_size, request_packet->GetPacketData().data() + sizeof(address),
-                    sizeof(data_size));
+        std::memcpy(&address, request_data, sizeof(address));
+        if (request_size >= sizeof(u32) * 2) {
+            std::memcpy(&data_size, request_data + sizeof(address), sizeof(data_size));
+        }
 
+        std::vector<MemoryRange> ranges;
         switch (request_packet->GetPacketType()) {
         case PacketType::ReadMemory:
-            if (data_size > 0 && data_size <= MAX_READ_SIZE) {
+            if (data_size > 0 && data_size <= max_data_size) {
                 HandleReadMemory(*request_packet, address, data_size);
                 success = true;
             }
             break;
         case PacketType::WriteMemory:
-            if (data_size > 0 && data_size <= MAX_PACKET_DATA_SIZE - (sizeof(u32) * 2)) {
-                const u8* data = request_packet->GetPacketData().data() + (sizeof(u32) * 2);
+            if (data_size > 0 && data_size <= request_size - (sizeof(u32) * 2)) {
+                const u8* data = request_data + (sizeof(u32) * 2);
                 HandleWriteMemory(*request_packet, address, data, data_size);
                 success = true;
             }
             break;
+        case PacketType::ReadMemoryRanges:
+            if (ParseRanges(request_data, request_size, max_data_size, ranges)) {
+                HandleReadMemoryRanges(*request_packet, ranges);
+                success = true;
+            }
+            break;
+        case PacketType::Subscribe:
+            // Updates are prefixed by the subscription id
+            if (ParseRanges(request_data + sizeof(u32), request_size - sizeof(u32),
+                            max_data_size - sizeof(u32), ranges)) {
+                HandleSubscribe(std::move(request_packet), address, std::move(ranges));
+                return;
+            }
+            break;
+        case PacketType::Unsubscribe:
+            HandleUnsubscribe(*request_packet, address);
+            success = true;
+            break;
+        case PacketType::RenewSubscription:
+            HandleRenewSubscription(*request_packet, address);
+            success = true;
+            break;
         default:
             break;
         }
@@ -4,10 +4,14 @@
 
 #pragma once
 
+#include <chrono>
 #include <condition_variable>
 #include <memory>
 #include <mutex>
 #include <thread>
+#include <unordered_map>
+#include <vector>
+#include "common/common_types.h"
 #include "common/threadsafe_queue.h"
 #include "core/rpc/server.h"
 
@@ -23,18 +27,63 @@ public:
 
     void QueueRequest(std::unique_ptr<RPC::Packet> request);
 
+    /// Sends the pending subscription updates. Called from the emulation thread at every VBlank,
+    /// so that clients get a view of the memory consistent with a frame boundary.
+    void OnVBlank();
+
+    struct MemoryRange {
+        u32 address;
+        u32 size;
+    };
+
+    /// Checks that a request is well-formed for its type and protocol version.
+    static bool ValidatePacket(const PacketHeader& packet_header);
+
+    /**
+     * Parses a range count followed by that many address/size pairs.
+     * @returns false if the ranges are malformed, or if their total size exceeds max_total_size.
+     */
+    static bool ParseRanges(const u8* data, std::size_t size, u32 max_total_size,
+                            std::vector<MemoryRange>& ranges);
+
 private:
+    struct Subscription {
+        /// The Subscribe request, reused to send the updates to the client that made it. Only
+        /// used by the emulation thread once the subscription is made, like the fields below.
+        std::unique_ptr<Packet> packet;
+        std::vector<MemoryRange> ranges;
+        u32 flags = 0;
+        u64 last_hash = 0;
+        bool has_sent_update = false;
+        /// The subscription is dropped past this time, unless it is renewed. Guarded by
+        /// subscription_mutex.
+        std::chrono::steady_clock::time_point expiry;
+    };
+
     void Start();
     void Stop();
     void HandleReadMemory(Packet& packet, u32 address, u32 data_size);
     void HandleWriteMemory(Packet& packet, u32 address, const u8* data, u32 data_size);
-    bool ValidatePacket(const PacketHeader& packet_header);
+    void HandleReadMemoryRanges(Packet& packet, const std::vector<MemoryRange>& ranges);
+    void HandleSubscribe(std::unique_ptr<Packet> packet, u32 flags,
+                         std::vector<MemoryRange> ranges);
+    void HandleUnsubscribe(Packet& packet, u32 subscription_id);
+    void HandleRenewSubscription(Packet& packet, u32 subscription_id);
+    /// Drops the subscriptions whose lease ran out. subscription_mutex must be held.
+    void RemoveExpiredSubscriptions();
     void HandleSingleRequest(std::unique_ptr<Packet> request);
     void HandleRequestsLoop();
 
+    /// Reads the ranges one after the other into the output buffer.
+    static void ReadRanges(const std::vector<MemoryRange>& ranges, u8* output);
+
     Server server;
     Common::SPSCQueue<std::unique_ptr<Packet>> request_queue;
     std::thread request_handler_thread;
+
+    std::mutex subscription_mutex;
+    std::unordered_map<u32, std::shared_ptr<Subscription>> subscriptions;
+    u32 next_subscription_id = 1;
 };
 
 } // namespace RPC
@@ -3,7 +3,9 @@
 #include "core/rpc/packet.h"
 #include "core/rpc/rpc_server.h"
 #include "core/rpc/server.h"
+#include "core/rpc/shared_memory_server.h"
 #include "core/rpc/udp_server.h"
+#include "core/settings.h"
 
 namespace RPC {
 
@@ -21,10 +23,19 @@ void Server::Start() {
     } catch (...) {
         LOG_ERROR(RPC_Server, "Error starting UDP server");
     }
+
+    if (Settings::values.rpc_shared_memory) {
+        try {
+            shared_memory_server = std::make_unique<SharedMemoryServer>(callback);
+        } catch (const std::exception& e) {
+            LOG_ERROR(RPC_Server, "Error starting shared memory server: {}", e.what());
+        }
+    }
 }
 
 void Server::Stop() {
     udp_server.reset();
+    shared_memory_server.reset();
     NewRequestCallback(nullptr); // Notify the RPC server to end
 }
 
@@ -39,4 +50,10 @@ void Server::NewRequestCallback(std::unique_ptr<RPC::Packet> new_request) {
     rpc_server.QueueRequest(std::move(new_request));
 }
 
+void Server::OnVBlank(Memory::MemorySystem& memory, u64 ticks) {
+    if (shared_memory_server) {
+        shared_memory_server->OnVBlank(memory, ticks);
+    }
+}
+
 }; // namespace RPC
@@ -5,10 +5,16 @@
 #pragma once
 
 #include <memory>
+#include "common/common_types.h"
+
+namespace Memory {
+class MemorySystem;
+}
 
 namespace RPC {
 
 class RPCServer;
+class SharedMemoryServer;
 class UDPServer;
 class Packet;
 
@@ -19,10 +25,12 @@ public:
     void Start();
     void Stop();
     void NewRequestCallback(std::unique_ptr<Packet> new_request);
+    void OnVBlank(Memory::MemorySystem& memory, u64 ticks);
 
 private:
     RPCServer& rpc_server;
     std::unique_ptr<UDPServer> udp_server;
+    std::unique_ptr<SharedMemoryServer> shared_memory_server;
 };
 
 } // namespace RPC
@@ -0,0 +1,299 @@
+// Copyright 2020 Citra Emulator Project
+// Licensed under GPLv2 or any later version
+// Refer to the license.txt file included.
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <mutex>
+#include <new>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <fmt/format.h>
+#include "common/alignment.h"
+#include "common/logging/log.h"
+#include "common/thread.h"
+#include "core/memory.h"
+#include "core/rpc/packet.h"
+#include "core/rpc/shared_memory_server.h"
+#include "core/settings.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#elif !defined(__ANDROID__)
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+namespace RPC {
+
+namespace {
+
+/// A named shared memory region created by the emulator, removed when destroyed.
+class SharedMemoryRegion {
+public:
+    SharedMemoryRegion(const std::string& name, std::size_t size) : size(size) {
+#ifdef _WIN32
+        const std::string mapping_name = "Local\\" + name;
+        handle = CreateFileMappingA(INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE,
+                                    static_cast<DWORD>(static_cast<u64>(size) >> 32),
+                                    static_cast<DWORD>(size), mapping_name.c_str());
+        if (handle == nullptr) {
+            throw std::runtime_error("Could not create shared memory " + name);
+        }
+        if (GetLastError() == ERROR_ALREADY_EXISTS) {
+            // Another process owns a mapping with that name, don't share it with them
+            CloseHandle(handle);
+            throw std::runtime_error("Shared memory " + name + " already exists");
+        }
+        pointer = static_cast<u8*>(MapViewOfFile(handle, FILE_MAP_ALL_ACCESS, 0, 0, size));
+        if (pointer == nullptr) {
+            CloseHandle(handle);
+            throw std::runtime_error("Could not map shared memory " + name);
+        }
+#elif !defined(__ANDROID__)
+        path = "/" + name;
+        // A region with that name may belong to another process, never take it over
+        fd = shm_open(path.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+        if (fd < 0) {
+            throw std::runtime_error(errno == EEXIST
+                                         ? "Shared memory " + name + " already exists"
+                                         : "Could not create shared memory " + name);
+        }
+        void* result = MAP_FAILED;
+        if (ftruncate(fd, static_cast<off_t>(size)) == 0) {
+            result = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        }
+        if (result == MAP_FAILED) {
+            close(fd);
+            shm_unlink(path.c_str());
+            throw std::runtime_error("Could not map shared memory " + name);
+        }
+        pointer = static_cast<u8*>(result);
+#else
+        throw std::runtime_error("Shared memory is not supported on this platform");
+#endif
+    }
+
+    ~SharedMemoryRegion() {
+#ifdef _WIN32
+        UnmapViewOfFile(pointer);
+        CloseHandle(handle);
+#elif !defined(__ANDROID__)
+        munmap(pointer, size);
+        close(fd);
+        shm_unlink(path.c_str());
+#endif
+    }
+
+    SharedMemoryRegion(const SharedMemoryRegion&) = delete;
+    SharedMemoryRegion& operator=(const SharedMemoryRegion&) = delete;
+
+    u8* GetPointer() const {
+        return pointer;
+    }
+
+private:
+    std::size_t size;
+    u8* pointer = nullptr;
+#ifdef _WIN32
+    HANDLE handle = nullptr;
+#elif !defined(__ANDROID__)
+    std::string path;
+    int fd = -1;
+#endif
+};
+
+/// Size of a ring slot: the packet size prefix and the largest packet, kept cache line aligned
+constexpr u32 SLOT_SIZE = Common::AlignUp<u32>(sizeof(u32) + MAX_PACKET_SIZE, 64);
+constexpr std::size_t CONTROL_HEADER_SIZE = Common::AlignUp(sizeof(SharedMemoryControl), 64);
+constexpr std::size_t CONTROL_REGION_SIZE =
+    CONTROL_HEADER_SIZE + std::size_t{SLOT_SIZE} * SHARED_MEMORY_SLOT_COUNT * 2;
+
+/// Number of empty polls of the request ring before the worker starts sleeping between polls
+constexpr u32 SPIN_COUNT = 256;
+/// The sleep between polls doubles while the ring stays empty, up to the maximum. This bounds the
+/// latency of the first request after an idle period, and the wakeups of an idle emulator.
+constexpr auto MIN_IDLE_SLEEP = std::chrono::microseconds(50);
+constexpr auto MAX_IDLE_SLEEP = std::chrono::milliseconds(20);
+/// How long a reply waits for the client to make room in the response ring before being dropped
+constexpr auto REPLY_TIMEOUT = std::chrono::seconds(5);
+constexpr auto REPLY_RETRY_SLEEP = std::chrono::microseconds(100);
+
+u32 GetEmulatorProcessID() {
+#ifdef _WIN32
+    return static_cast<u32>(GetCurrentProcessId());
+#elif !defined(__ANDROID__)
+    return static_cast<u32>(getpid());
+#else
+    return 0;
+#endif
+}
+
+} // Anonymous namespace
+
+class SharedMemoryServer::Impl {
+public:
+    explicit Impl(std::function<void(std::unique_ptr<Packet>)> new_request_callback)
+        : fcram_size(Settings::values.is_new_3ds ? Memory::FCRAM_N3DS_SIZE : Memory::FCRAM_SIZE),
+          control_region(GetSharedMemoryName(SHARED_MEMORY_CONTROL_NAME, GetEmulatorProcessID()),
+                         CONTROL_REGION_SIZE),
+          fcram_region(GetSharedMemoryName(SHARED_MEMORY_FCRAM_NAME, GetEmulatorProcessID()),
+                       fcram_size),
+          new_request_callback(std::move(new_request_callback)) {
+
+        control = new (control_region.GetPointer()) SharedMemoryControl{};
+        control->slot_count = SHARED_MEMORY_SLOT_COUNT;
+        control->slot_size = SLOT_SIZE;
+        control->fcram_size = fcram_size;
+        control->layout_version = SHARED_MEMORY_LAYOUT_VERSION;
+        // Written last, clients must wait for it before using the region
+        std::atomic_thread_fence(std::memory_order_release);
+        control->magic = SHARED_MEMORY_MAGIC;
+        LOG_INFO(RPC_Server, "Serving RPC requests through shared memory {}",
+                 GetSharedMemoryName(SHARED_MEMORY_CONTROL_NAME, GetEmulatorProcessID()));
+
+        worker_thread = std::thread([this] { HandleRequestsLoop(); });
+    }
+
+    ~Impl() {
+        stop = true;
+        stop_event.Set();
+        worker_thread.join();
+    }
+
+    void OnVBlank(Memory::MemorySystem& memory, u64 ticks) {
+        if (control->snapshot_requested.load(std::memory_order_acquire) == 0) {
+            return;
+        }
+
+        const u32 sequence = control->snapshot_sequence.load(std::memory_order_relaxed);
+        control->snapshot_sequence.store(sequence + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        std::memcpy(fcram_region.GetPointer(), memory.GetFCRAMPointer(0), fcram_size);
+        control->snapshot_ticks.store(ticks, std::memory_order_relaxed);
+        control->snapshot_sequence.store(sequence + 2, std::memory_order_release);
+        control->snapshot_requested.store(0, std::memory_order_release);
+    }
+
+private:
+    u8* GetSlot(u32 index, bool response) const {
+        const u32 slot =
+            index % SHARED_MEMORY_SLOT_COUNT + (response ? SHARED_MEMORY_SLOT_COUNT : 0);
+        return control_region.GetPointer() + CONTROL_HEADER_SIZE + std::size_t{slot} * SLOT_SIZE;
+    }
+
+    void HandleRequestsLoop() {
+        Common::SetCurrentThreadName("RPCSharedMemory");
+
+        u32 idle_polls = 0;
+        std::chrono::microseconds idle_sleep = MIN_IDLE_SLEEP;
+        while (!stop) {
+            const u32 read = control->request_read.load(std::memory_order_relaxed);
+            if (read == control->request_write.load(std::memory_order_acquire)) {
+                if (++idle_polls < SPIN_COUNT) {
+                    std::this_thread::yield();
+                } else {
+                    // Woken up right away when stopping
+                    stop_event.WaitUntil(std::chrono::steady_clock::now() + idle_sleep);
+                    idle_sleep = std::min<std::chrono::microseconds>(idle_sleep * 2,
+                                                                     MAX_IDLE_SLEEP);
+                }
+                continue;
+            }
+            idle_polls = 0;
+            idle_sleep = MIN_IDLE_SLEEP;
+
+            // The packet copies the request, so the slot can be released right away
+            std::unique_ptr<Packet> packet = ReadRequest(GetSlot(read, false));
+            control->request_read.store(read + 1, std::memory_order_release);
+            if (packet) {
+                new_request_callback(std::move(packet));
+            }
+        }
+    }
+
+    std::unique_ptr<Packet> ReadRequest(const u8* slot) {
+        u32 size;
+        std::memcpy(&size, slot, sizeof(size));
+        if (size < MIN_PACKET_SIZE || size > MAX_PACKET_SIZE) {
+            LOG_WARNING(RPC_Server, "Received message with wrong size: {}", size);
+            return nullptr;
+        }
+
+        PacketHeader header;
+        std::memcpy(&header, slot + sizeof(size), sizeof(header));
+        if (size - MIN_PACKET_SIZE != header.packet_size) {
+            return nullptr;
+        }
+        return std::make_unique<Packet>(header, slot + sizeof(size) + MIN_PACKET_SIZE,
+                                        [this](Packet& packet) { SendReply(packet); });
+    }
+
+    void SendReply(Packet& packet) {
+        // Subscription updates come from the emulation thread, which must not wait for the client
+        const bool can_wait = packet.GetPacketType() != PacketType::SubscriptionUpdate;
+        const auto deadline = std::chrono::steady_clock::now() + REPLY_TIMEOUT;
+        while (!TryWriteReply(packet)) {
+            if (!can_wait || stop || std::chrono::steady_clock::now() >= deadline) {
+                control->dropped_responses.fetch_add(1, std::memory_order_release);
+                LOG_WARNING(RPC_Server, "Dropping reply id={}, the response ring is full",
+                            packet.GetId());
+                return;
+            }
+            std::this_thread::sleep_for(REPLY_RETRY_SLEEP);
+        }
+    }
+
+    /// Writes a reply to the response ring. Returns false if the ring is full.
+    bool TryWriteReply(Packet& packet) {
+        // Replies come from both the request handler and the emulation thread
+        std::lock_guard lock{reply_mutex};
+
+        const u32 write = control->response_write.load(std::memory_order_relaxed);
+        if (write - control->response_read.load(std::memory_order_acquire) >=
+            SHARED_MEMORY_SLOT_COUNT) {
+            return false;
+        }
+
+        u8* slot = GetSlot(write, true);
+        const u32 size = MIN_PACKET_SIZE + packet.GetPacketDataSize();
+        const PacketHeader& header = packet.GetHeader();
+        std::memcpy(slot, &size, sizeof(size));
+        std::memcpy(slot + sizeof(size), &header, sizeof(header));
+        std::memcpy(slot + sizeof(size) + MIN_PACKET_SIZE, packet.GetPacketData().data(),
+                    packet.GetPacketDataSize());
+        control->response_write.store(write + 1, std::memory_order_release);
+        return true;
+    }
+
+    const u32 fcram_size;
+    SharedMemoryRegion control_region;
+    SharedMemoryRegion fcram_region;
+    SharedMemoryControl* control = nullptr;
+
+    std::function<void(std::unique_ptr<Packet>)> new_request_callback;
+    std::mutex reply_mutex;
+    std::atomic_bool stop{false};
+    Common::Event stop_event;
+    std::thread worker_thread;
+};
+
+std::string GetSharedMemoryName(const char* prefix, u32 process_id) {
+    return fmt::format("{}-{}", prefix, process_id);
+}
+
+SharedMemoryServer::SharedMemoryServer(
+    std::function<void(std::unique_ptr<Packet>)> new_request_callback)
+    : impl(std::make_unique<Impl>(std::move(new_request_callback))) {}
+
+SharedMemoryServer::~SharedMemoryServer() = default;
+
+void SharedMemoryServer::OnVBlank(Memory::MemorySystem& memory, u64 ticks) {
+    impl->OnVBlank(memory, ticks);
+}
+
+} // namespace RPC
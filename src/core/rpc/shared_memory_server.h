@@ -0,0 +1,97 @@
+// Copyright 2020 Citra Emulator Project
+// Licensed under GPLv2 or any later version
+// Refer to the license.txt file included.
+
+#pragma once
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <string>
+#include "common/common_types.h"
+
+namespace Memory {
+class MemorySystem;
+}
+
+namespace RPC {
+
+class Packet;
+
+/// Prefix of the name of the shared memory region holding the control block and the
+/// request/response rings. The full name ends with the process ID of the emulator.
+constexpr char SHARED_MEMORY_CONTROL_NAME[] = "citra-rpc";
+/// Prefix of the name of the shared memory region holding the FCRAM snapshots, meant to be mapped
+/// read-only. The full name ends with the process ID of the emulator.
+constexpr char SHARED_MEMORY_FCRAM_NAME[] = "citra-rpc-fcram";
+
+/// Returns the full name of a shared memory region of the emulator with the given process ID,
+/// e.g. "citra-rpc-1234"
+std::string GetSharedMemoryName(const char* prefix, u32 process_id);
+
+constexpr u32 SHARED_MEMORY_MAGIC = 0x43505243; // "CRPC"
+constexpr u32 SHARED_MEMORY_LAYOUT_VERSION = 2;
+constexpr u32 SHARED_MEMORY_SLOT_COUNT = 16;
+
+/**
+ * Layout of the start of the control region. It is followed by SHARED_MEMORY_SLOT_COUNT request
+ * slots, then as many response slots, each `slot_size` bytes long. A slot holds a u32 size followed
+ * by a packet in the same format as over UDP. Both rings are single producer, single consumer: the
+ * client writes requests and reads responses, and the emulator does the opposite. Indices
+ * increase forever and are taken modulo the slot count. When the response ring is full, replies
+ * to requests wait for the client to make room, while subscription updates are dropped and
+ * counted in `dropped_responses`.
+ */
+struct SharedMemoryControl {
+    u32 magic;
+    u32 layout_version;
+    u32 slot_count;
+    u32 slot_size;
+    /// Size of the FCRAM snapshot region
+    u32 fcram_size;
+
+    /// Index of the next request slot to be written. Only written by the client.
+    alignas(64) std::atomic<u32> request_write;
+    /// Index of the next request slot to be read. Only written by the emulator.
+    alignas(64) std::atomic<u32> request_read;
+    /// Index of the next response slot to be written. Only written by the emulator.
+    alignas(64) std::atomic<u32> response_write;
+    /// Index of the next response slot to be read. Only written by the client.
+    alignas(64) std::atomic<u32> response_read;
+
+    /// Set to 1 by the client to ask for an FCRAM snapshot at the next frame boundary. The
+    /// emulator sets it back to 0 once the snapshot was taken.
+    alignas(64) std::atomic<u32> snapshot_requested;
+    /// Sequence lock of the FCRAM snapshot. Odd while a snapshot is being copied. A client read is
+    /// consistent if the sequence was the same even value before and after it.
+    std::atomic<u32> snapshot_sequence;
+    /// Emulated CPU ticks at which the current snapshot was taken
+    std::atomic<u64> snapshot_ticks;
+
+    /// Number of responses dropped because the response ring was full. Only written by the
+    /// emulator.
+    std::atomic<u32> dropped_responses;
+};
+static_assert(std::atomic<u32>::is_always_lock_free && std::atomic<u64>::is_always_lock_free,
+              "Atomics in shared memory must be lock-free");
+
+/**
+ * RPC transport for clients running on the same host, through named shared memory regions. It
+ * avoids the syscalls and copies of the UDP transport, and lets clients read frame-consistent
+ * FCRAM snapshots directly.
+ */
+class SharedMemoryServer {
+public:
+    explicit SharedMemoryServer(std::function<void(std::unique_ptr<Packet>)> new_request_callback);
+    ~SharedMemoryServer();
+
+    /// Takes an FCRAM snapshot if the client asked for one. Called by the emulation thread at
+    /// every VBlank.
+    void OnVBlank(Memory::MemorySystem& memory, u64 ticks);
+
+private:
+    class Impl;
+    std::unique_ptr<Impl> impl;
+};
+
+} // namespace RPC
@@ -66,16 +66,24 @@ private:
         std::memcpy(reply_buffer.data() + (4 * sizeof(u32)), reply_packet.GetPacketData().data(),
                     reply_packet.GetPacketDataSize());
 
-        boost::system::error_code error;
-        socket.send_to(boost::asio::buffer(reply_buffer), endpoint, 0, error);
-
-        if (error) {
-            LOG_WARNING(RPC_Server, "Failed to send reply: {}", error.message());
-        } else {
-            LOG_INFO(RPC_Server, "Sent reply version({}) id=({}) type=({}) size=({})",
-                     reply_packet.GetVersion(), reply_packet.GetId(), reply_packet.GetPacketType(),
-                     reply_packet.GetPacketDataSize());
-        }
+        // Replies are also sent from the emulation thread, which must not wait on the socket
+        boost::asio::post(io_context, [this, endpoint, reply_header,
+                                       reply_buffer = std::move(reply_buffer)] {
+            boost::system::error_code error;
+            socket.send_to(boost::asio::buffer(reply_buffer), endpoint, 0, error);
+
+            if (error) {
+                LOG_WARNING(RPC_Server, "Failed to send reply: {}", error.message());
+            } else if (reply_header.packet_type == PacketType::SubscriptionUpdate) {
+                // Pushed at every frame, logging them at a higher level would flood the log
+                LOG_TRACE(RPC_Server, "Sent subscription update id=({}) size=({})",
+                          reply_header.id, reply_header.packet_size);
+            } else {
+                LOG_INFO(RPC_Server, "Sent reply version({}) id=({}) type=({}) size=({})",
+                         reply_header.version, reply_header.id, reply_header.packet_type,
+                         reply_header.packet_size);
+            }
+        });
     }
 
     std::thread worker_thread;
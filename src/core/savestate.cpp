@@ -3,14 +3,18 @@
 // Refer to the license.txt file included.
 
 #include <chrono>
+#include <optional>
 #include <boost/serialization/binary_object.hpp>
 #include <cryptopp/hex.h>
 #include "common/archives.h"
 #include "common/logging/log.h"
 #include "common/scm_rev.h"
+#include "common/scope_exit.h"
+#include "common/swap.h"
 #include "common/zstd_compression.h"
 #include "core/cheats/cheats.h"
 #include "core/core.h"
+#include "core/rewind.h"
 #include "core/savestate.h"
 #include "network/network.h"
 #include "video_core/video_core.h"
@@ -23,8 +27,11 @@ struct CSTHeader {
     u64_le program_id;           /// ID of the ROM being executed. Also called title_id
     std::array<u8, 20> revision; /// Git hash of the revision this savestate was created with
     u64_le time;                 /// The time when this save state was created
+    u32_le version;              /// Format of the state data, see CSTVersion
+    u32_le chunk_count;          /// Number of compressed chunks (Chunked version only)
+    u64_le chunk_index_offset;   /// Offset of the CSTChunk array (Chunked version only)
 
-    std::array<u8, 216> reserved; /// Make heading 256 bytes so it has consistent size
+    std::array<u8, 200> reserved; /// Make heading 256 bytes so it has consistent size
 
     template <class Archive>
     void serialize(Archive& ar, const unsigned int) {
@@ -32,8 +39,28 @@ struct CSTHeader {
     }
 };
 static_assert(sizeof(CSTHeader) == 256, "CSTHeader should be 256 bytes");
+
+/// Location of a compressed chunk of the state data in the file
+struct CSTChunk {
+    u64_le offset;
+    u32_le compressed_size;
+    u32_le size;
+};
+static_assert(sizeof(CSTChunk) == 16, "CSTChunk should be 16 bytes");
 #pragma pack(pop)
 
+enum class CSTVersion : u32 {
+    /// The state data is a single zstd frame following the header. The reserved bytes of the
+    /// header were zero before versions were introduced.
+    Single = 0,
+    /// The state data is split into independently compressed zstd frames, located by an index.
+    Chunked = 1,
+};
+
+/// Size of the chunks of the state data before compression
+constexpr std::size_t CSTChunkSize = 4 * 1024 * 1024;
+constexpr s32 CSTCompressionLevel = 3;
+
 constexpr std::array<u8, 4> header_magic_bytes{{'C', 'S', 'T', 0x1B}};
 
 std::string GetSaveStatePath(u64 program_id, u32 slot) {
@@ -89,29 +116,30 @@ std::vector<SaveStateInfo> ListSaveStates(u64 program_id) {
     return result;
 }
 
-void System::SaveState(u32 slot) const {
-    std::ostringstream sstream{std::ios_base::binary};
-    // Serialize
-    oarchive oa{sstream};
-    oa&* this;
-
-    const std::string& str{sstream.str()};
-    auto buffer = Common::Compression::CompressDataZSTDDefault(
-        reinterpret_cast<const u8*>(str.data()), str.size());
-
-    const auto path = GetSaveStatePath(title_id, slot);
+void SaveStateToFile(const std::string& path, u64 program_id,
+                     const std::function<void(std::streambuf&)>& serialize) {
     if (!FileUtil::CreateFullPath(path)) {
         throw std::runtime_error("Could not create path " + path);
     }
 
-    FileUtil::IOFile file(path, "wb");
+    // The state is streamed to a temporary file, so that a failure while serializing doesn't
+    // destroy the savestate already in the slot.
+    const auto temp_path = path + ".tmp";
+    FileUtil::IOFile file(temp_path, "wb");
     if (!file) {
-        throw std::runtime_error("Could not open file " + path);
+        throw std::runtime_error("Could not open file " + temp_path);
     }
+    bool success = false;
+    SCOPE_EXIT({
+        if (!success) {
+            file.Close();
+            FileUtil::Delete(temp_path);
+        }
+    });
 
     CSTHeader header{};
     header.filetype = header_magic_bytes;
-    header.program_id = title_id;
+    header.program_id = program_id;
     std::string rev_bytes;
     CryptoPP::StringSource(Common::g_scm_rev, true,
                            new CryptoPP::HexDecoder(new CryptoPP::StringSink(rev_bytes)));
@@ -119,11 +147,89 @@ void System::SaveState(u32 slot) const {
     header.time = std::chrono::duration_cast<std::chrono::seconds>(
                       std::chrono::system_clock::now().time_since_epoch())
                       .count();
+    header.version = static_cast<u32>(CSTVersion::Chunked);
+
+    // The header is written again once the chunk index location is known
+    if (file.WriteBytes(&header, sizeof(header)) != sizeof(header)) {
+        throw std::runtime_error("Could not write to file " + path);
+    }
 
-    if (file.WriteBytes(&header, sizeof(header)) != sizeof(header) ||
-        file.WriteBytes(buffer.data(), buffer.size()) != buffer.size()) {
+    // Serialize, compressing chunks in parallel straight to the file
+    std::optional<std::vector<Common::Compression::ZSTDChunk>> chunks;
+    {
+        Common::Compression::ZSTDChunkedCompressStreamBuf compressor{file, CSTChunkSize,
+                                                                     CSTCompressionLevel};
+        serialize(compressor);
+        chunks = compressor.Finish();
+    }
+    if (!chunks) {
         throw std::runtime_error("Could not write to file " + path);
     }
+
+    std::vector<CSTChunk> index;
+    index.reserve(chunks->size());
+    for (const auto& chunk : *chunks) {
+        index.push_back({chunk.offset, chunk.compressed_size, chunk.size});
+    }
+    header.chunk_count = static_cast<u32>(index.size());
+    header.chunk_index_offset = file.Tell();
+    if (file.WriteArray(index.data(), index.size()) != index.size() ||
+        !file.Seek(0, SEEK_SET) || file.WriteBytes(&header, sizeof(header)) != sizeof(header) ||
+        !file.Close()) {
+        throw std::runtime_error("Could not write to file " + path);
+    }
+    if (FileUtil::Exists(path) && !FileUtil::Delete(path)) {
+        throw std::runtime_error("Could not replace file " + path);
+    }
+    if (!FileUtil::Rename(temp_path, path)) {
+        throw std::runtime_error("Could not rename file " + temp_path);
+    }
+    success = true;
+}
+
+void LoadStateFromFile(const std::string& path,
+                       const std::function<void(std::streambuf&)>& deserialize) {
+    FileUtil::IOFile file(path, "rb");
+    CSTHeader header;
+    if (!file || file.ReadBytes(&header, sizeof(header)) != sizeof(header)) {
+        throw std::runtime_error("Could not read from file at " + path);
+    }
+
+    const u32 version = header.version;
+    switch (static_cast<CSTVersion>(version)) {
+    case CSTVersion::Single: {
+        // Deserialize, decompressing straight from the file
+        Common::Compression::ZSTDDecompressStreamBuf decompressor{file};
+        deserialize(decompressor);
+        break;
+    }
+    case CSTVersion::Chunked: {
+        std::vector<CSTChunk> index(header.chunk_count);
+        if (!file.Seek(static_cast<s64>(header.chunk_index_offset), SEEK_SET) ||
+            file.ReadArray(index.data(), index.size()) != index.size()) {
+            throw std::runtime_error("Could not read from file at " + path);
+        }
+        std::vector<Common::Compression::ZSTDChunk> chunks;
+        chunks.reserve(index.size());
+        for (const auto& chunk : index) {
+            chunks.push_back({chunk.offset, chunk.compressed_size, chunk.size});
+        }
+
+        // Deserialize, decompressing chunks in parallel ahead of the archive
+        Common::Compression::ZSTDChunkedDecompressStreamBuf decompressor{file, std::move(chunks)};
+        deserialize(decompressor);
+        break;
+    }
+    default:
+        throw std::runtime_error(fmt::format("Unsupported savestate format version {}", version));
+    }
+}
+
+void System::SaveState(u32 slot) const {
+    SaveStateToFile(GetSaveStatePath(title_id, slot), title_id, [this](std::streambuf& stream) {
+        oarchive oa{stream};
+        oa&* this;
+    });
 }
 
 void System::LoadState(u32 slot) {
@@ -131,25 +237,57 @@ void System::LoadState(u32 slot) {
         throw std::runtime_error("Unable to load while connected to multiplayer");
     }
 
-    const auto path = GetSaveStatePath(title_id, slot);
+    LoadStateFromFile(GetSaveStatePath(title_id, slot), [this](std::streambuf& stream) {
+        iarchive ia{stream};
+        ia&* this;
+    });
+
+    // Rewinding must not go back to the timeline that was left
+    if (rewind_buffer) {
+        rewind_buffer->Clear();
+    }
+}
 
-    std::vector<u8> decompressed;
+void System::CreateSnapshotBase() {
+    // Make sure the memory contains what the rasterizer has cached, like serialization does
+    Memory::RasterizerFlushAll();
+    snapshot_base = memory->CreateSnapshotBase(NewSnapshotBaseId());
+}
+
+std::vector<u8> System::SaveIncrementalState() const {
+    if (!snapshot_base) {
+        throw std::runtime_error("No snapshot base to save an incremental state against");
+    }
+
+    std::ostringstream sstream{std::ios_base::binary};
     {
-        std::vector<u8> buffer(FileUtil::GetSize(path) - sizeof(CSTHeader));
+        memory->SetSnapshotBase(snapshot_base.get());
+        saving_incremental_state = true;
+        SCOPE_EXIT({
+            memory->SetSnapshotBase(nullptr);
+            saving_incremental_state = false;
+        });
+        oarchive oa{sstream};
+        oa&* this;
+    }
 
-        FileUtil::IOFile file(path, "rb");
-        file.Seek(sizeof(CSTHeader), SEEK_SET); // Skip header
-        if (file.ReadBytes(buffer.data(), buffer.size()) != buffer.size()) {
-            throw std::runtime_error("Could not read from file at " + path);
-        }
-        decompressed = Common::Compression::DecompressDataZSTD(buffer);
+    const std::string& str{sstream.str()};
+    return std::vector<u8>(str.begin(), str.end());
+}
+
+void System::LoadIncrementalState(const std::vector<u8>& state) {
+    if (Network::GetRoomMember().lock()->IsConnected()) {
+        throw std::runtime_error("Unable to load while connected to multiplayer");
+    }
+    if (!snapshot_base) {
+        throw std::runtime_error("No snapshot base to load an incremental state from");
     }
+
     std::istringstream sstream{
-        std::string{reinterpret_cast<char*>(decompressed.data()), decompressed.size()},
+        std::string{reinterpret_cast<const char*>(state.data()), state.size()},
         std::ios_base::binary};
-    decompressed.clear();
 
-    // Deserialize
+    // Deserialize. The memory is recreated during loading and given the base there.
     iarchive ia{sstream};
     ia&* this;
 }
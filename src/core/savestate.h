@@ -4,6 +4,9 @@
 
 #pragma once
 
+#include <functional>
+#include <streambuf>
+#include <string>
 #include <vector>
 #include "common/common_types.h"
 
@@ -24,4 +27,22 @@ constexpr u32 SaveStateSlotCount = 10; // Maximum count of savestate slots
 
 std::vector<SaveStateInfo> ListSaveStates(u64 program_id);
 
+/**
+ * Writes a savestate file, replacing the existing one only once it was written successfully.
+ * Throws std::runtime_error on failure.
+ * @param path path of the savestate file
+ * @param program_id ID of the running program, stored in the header
+ * @param serialize function writing the state data to the given stream
+ */
+void SaveStateToFile(const std::string& path, u64 program_id,
+                     const std::function<void(std::streambuf&)>& serialize);
+
+/**
+ * Reads a savestate file in any of the supported formats. Throws std::runtime_error on failure.
+ * @param path path of the savestate file
+ * @param deserialize function reading the state data from the given stream
+ */
+void LoadStateFromFile(const std::string& path,
+                       const std::function<void(std::streambuf&)>& deserialize);
+
 } // namespace Core
@@ -80,6 +80,11 @@ void LogSettings() {
     LOG_INFO(Config, "Citra Configuration:");
     log_setting("Core_UseCpuJit", values.use_cpu_jit);
     log_setting("Core_CPUClockPercentage", values.cpu_clock_percentage);
+    log_setting("Core_EnableRewind", values.enable_rewind);
+    log_setting("Core_RewindIntervalFrames", values.rewind_interval_frames);
+    log_setting("Core_RewindBufferSizeMB", values.rewind_buffer_size_mb);
+    log_setting("Core_MovieAnchorIntervalFrames", values.movie_anchor_interval_frames);
+    log_setting("Renderer_Backend", values.renderer_backend);
     log_setting("Renderer_UseGLES", values.use_gles);
     log_setting("Renderer_UseHwRenderer", values.use_hw_renderer);
     log_setting("Renderer_UseHwShader", values.use_hw_shader);
@@ -122,6 +127,9 @@ void LogSettings() {
     log_setting("DataStorage_UseVirtualSd", values.use_virtual_sd);
     log_setting("DataStorage_SdmcDir", values.sdmc_dir);
     log_setting("DataStorage_NandDir", values.nand_dir);
+    log_setting("DataStorage_RomFSCacheSizeMB", values.romfs_cache_size_mb);
+    log_setting("DataStorage_UseCodeCache", values.use_code_cache);
+    log_setting("DataStorage_UseSaveWriteBack", values.use_save_write_back);
     log_setting("System_IsNew3ds", values.is_new_3ds);
     log_setting("System_RegionValue", values.region_value);
     log_setting("Debugging_UseGdbstub", values.use_gdbstub);
@@ -19,6 +19,11 @@ enum class InitClock {
     FixedTime = 1,
 };
 
+enum class RendererBackend {
+    OpenGL = 0,
+    Null = 1,
+};
+
 enum class LayoutOption {
     Default,
     SingleScreen,
@@ -152,11 +157,18 @@ struct Values {
     // Core
     bool use_cpu_jit;
     int cpu_clock_percentage;
+    bool enable_rewind;
+    u32 rewind_interval_frames;
+    u32 rewind_buffer_size_mb;
+    u32 movie_anchor_interval_frames;
 
     // Data Storage
     bool use_virtual_sd;
     std::string nand_dir;
     std::string sdmc_dir;
+    u32 romfs_cache_size_mb;
+    bool use_code_cache;
+    bool use_save_write_back;
 
     // System
     int region_value;
@@ -164,6 +176,7 @@ struct Values {
     u64 init_time;
 
     // Renderer
+    RendererBackend renderer_backend;
     bool use_gles;
     bool use_hw_renderer;
     bool use_hw_shader;
@@ -227,6 +240,8 @@ struct Values {
 
     // Debugging
     bool record_frame_times;
+    bool record_hle_call_stats;
+    bool rpc_shared_memory;
     bool use_gdbstub;
     u16 gdbstub_port;
     std::string log_filter;
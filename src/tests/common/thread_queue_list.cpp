@@ -0,0 +1,170 @@
+// Copyright 2020 Citra Emulator Project
+// Licensed under GPLv2 or any later version
+// Refer to the license.txt file included.
+
+#include <array>
+#include <deque>
+#include <sstream>
+#include <vector>
+#include <boost/archive/binary_iarchive.hpp>
+#include <boost/archive/binary_oarchive.hpp>
+#include <catch2/catch.hpp>
+#include "common/thread_queue_list.h"
+
+namespace Common {
+
+namespace {
+
+struct Element : ThreadQueueListNode<Element> {
+    int id = 0;
+
+    template <class Archive>
+    void serialize(Archive& ar, const unsigned int) {
+        ar& id;
+    }
+};
+
+constexpr unsigned int NumLevels = 4;
+using Queue = ThreadQueueList<Element, NumLevels>;
+
+std::vector<int> PopAll(Queue& queue) {
+    std::vector<int> ids;
+    while (Element* element = queue.pop_first()) {
+        ids.push_back(element->id);
+    }
+    return ids;
+}
+
+/// Writes the layout of version 0 of ThreadQueueList, which queued element pointers in deques.
+struct LegacyQueue {
+    std::array<std::deque<Element*>, NumLevels> levels;
+
+    template <class Archive>
+    void serialize(Archive& ar, const unsigned int) {
+        s64 link = 0;
+        ar << link;
+        for (auto& level : levels) {
+            ar << link;
+            ar << level;
+        }
+    }
+};
+
+} // Anonymous namespace
+
+TEST_CASE("ThreadQueueList serves lower priorities first, in FIFO order", "[common]") {
+    std::array<Element, 6> elements;
+    for (std::size_t i = 0; i < elements.size(); ++i) {
+        elements[i].id = static_cast<int>(i);
+    }
+
+    Queue queue;
+    REQUIRE(queue.get_first() == nullptr);
+    queue.push_back(2, &elements[0]);
+    queue.push_back(1, &elements[1]);
+    queue.push_back(2, &elements[2]);
+    queue.push_front(2, &elements[3]);
+    queue.push_back(3, &elements[4]);
+    queue.push_back(1, &elements[5]);
+
+    REQUIRE(queue.get_first() == &elements[1]);
+    REQUIRE(queue.contains(&elements[4]) == 3);
+    REQUIRE(!queue.empty(1));
+    REQUIRE(queue.empty(0));
+    REQUIRE(PopAll(queue) == std::vector<int>{1, 5, 3, 0, 2, 4});
+    for (const Element& element : elements) {
+        REQUIRE(!element.IsQueued());
+    }
+}
+
+TEST_CASE("ThreadQueueList remove, move and rotate", "[common]") {
+    std::array<Element, 4> elements;
+    for (std::size_t i = 0; i < elements.size(); ++i) {
+        elements[i].id = static_cast<int>(i);
+    }
+
+    Queue queue;
+    for (Element& element : elements) {
+        queue.push_back(2, &element);
+    }
+
+    // Removing the head, the tail and an element in the middle keeps the links consistent
+    queue.remove(2, &elements[0]);
+    queue.remove(2, &elements[3]);
+    REQUIRE(!elements[0].IsQueued());
+    queue.remove(2, &elements[0]); // Not queued anymore, does nothing
+    queue.push_back(2, &elements[3]);
+    queue.remove(2, &elements[2]);
+
+    queue.push_back(2, &elements[0]);
+    queue.rotate(2);
+    queue.move(&elements[0], 2, 1);
+    REQUIRE(queue.pop_first_better(1) == nullptr);
+    REQUIRE(queue.pop_first_better(2) == &elements[0]);
+    REQUIRE(PopAll(queue) == std::vector<int>{3, 1});
+    REQUIRE(queue.empty(2));
+
+    queue.push_back(0, &elements[0]);
+    queue.push_back(3, &elements[1]);
+    queue.clear();
+    REQUIRE(queue.get_first() == nullptr);
+    REQUIRE(!elements[0].IsQueued());
+    REQUIRE(!elements[1].IsQueued());
+}
+
+TEST_CASE("ThreadQueueList serialization", "[common]") {
+    std::array<Element, 5> elements;
+    for (std::size_t i = 0; i < elements.size(); ++i) {
+        elements[i].id = static_cast<int>(i);
+    }
+
+    SECTION("round trip") {
+        Queue queue;
+        queue.push_back(3, &elements[0]);
+        queue.push_back(0, &elements[1]);
+        queue.push_back(3, &elements[2]);
+        queue.push_back(1, &elements[3]);
+
+        std::stringstream stream;
+        {
+            boost::archive::binary_oarchive oa{stream};
+            oa << queue;
+        }
+        Queue loaded;
+        {
+            boost::archive::binary_iarchive ia{stream};
+            ia >> loaded;
+        }
+        std::vector<int> ids;
+        while (Element* element = loaded.pop_first()) {
+            ids.push_back(element->id);
+            delete element;
+        }
+        REQUIRE(ids == std::vector<int>{1, 3, 0, 2});
+    }
+
+    SECTION("version 0") {
+        LegacyQueue legacy;
+        legacy.levels[1] = {&elements[4], &elements[2]};
+        legacy.levels[2] = {&elements[0]};
+
+        std::stringstream stream;
+        {
+            boost::archive::binary_oarchive oa{stream};
+            oa << legacy;
+        }
+        Queue loaded;
+        {
+            boost::archive::binary_iarchive ia{stream};
+            ia >> loaded;
+        }
+        std::vector<int> ids;
+        while (Element* element = loaded.pop_first()) {
+            ids.push_back(element->id);
+            delete element;
+        }
+        REQUIRE(ids == std::vector<int>{4, 2, 0});
+    }
+}
+
+} // namespace Common
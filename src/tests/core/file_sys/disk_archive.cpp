@@ -0,0 +1,111 @@
+// Copyright 2020 Citra Emulator Project
+// Licensed under GPLv2 or any later version
+// Refer to the license.txt file included.
+
+#include <string>
+#include <vector>
+#include <catch2/catch.hpp>
+#include "common/file_util.h"
+#include "common/scope_exit.h"
+#include "core/file_sys/disk_archive.h"
+#include "core/file_sys/errors.h"
+#include "core/settings.h"
+
+namespace FileSys {
+
+namespace {
+
+const std::vector<u8> TestData{0x01, 0x23, 0x45, 0x67, 0x89, 0xAB, 0xCD, 0xEF};
+
+std::unique_ptr<DiskFile> OpenFile(const std::string& path, const char* open_mode) {
+    Mode mode{};
+    mode.read_flag.Assign(1);
+    mode.write_flag.Assign(1);
+    return std::make_unique<DiskFile>(FileUtil::IOFile(path, open_mode), mode, nullptr);
+}
+
+/// Returns the contents of the host file, as seen by other processes
+std::vector<u8> ReadHostFile(const std::string& path) {
+    std::vector<u8> data(FileUtil::GetSize(path));
+    FileUtil::IOFile(path, "rb").ReadBytes(data.data(), data.size());
+    return data;
+}
+
+/// Writes the test data in small chunks
+void WriteTestData(DiskFile& file) {
+    for (std::size_t i = 0; i < TestData.size(); i += 2) {
+        const auto result = file.Write(i, 2, false, TestData.data() + i);
+        REQUIRE(result.Succeeded());
+        REQUIRE(*result == 2);
+    }
+}
+
+} // Anonymous namespace
+
+TEST_CASE("DiskFile writes through by default", "[core][file_sys]") {
+    Settings::values.use_save_write_back = false;
+    const std::string path = FileUtil::GetTempDirectory() + "citra_disk_file_test.bin";
+    SCOPE_EXIT({ FileUtil::Delete(path); });
+
+    auto file = OpenFile(path, "w+b");
+    WriteTestData(*file);
+    file->Flush();
+    REQUIRE(ReadHostFile(path) == TestData);
+}
+
+TEST_CASE("DiskFile writes back buffered writes", "[core][file_sys]") {
+    Settings::values.use_save_write_back = true;
+    SCOPE_EXIT({ Settings::values.use_save_write_back = false; });
+    const std::string path = FileUtil::GetTempDirectory() + "citra_disk_file_test.bin";
+    SCOPE_EXIT({ FileUtil::Delete(path); });
+
+    auto file = OpenFile(path, "w+b");
+    WriteTestData(*file);
+    file->Flush();
+    REQUIRE(file->GetSize() == TestData.size());
+
+    SECTION("on close") {
+        REQUIRE(file->Close());
+        REQUIRE(ReadHostFile(path) == TestData);
+    }
+
+    SECTION("on exit") {
+        DiskFile::WriteBackAll();
+        REQUIRE(ReadHostFile(path) == TestData);
+    }
+
+    SECTION("on destruction") {
+        file.reset();
+        REQUIRE(ReadHostFile(path) == TestData);
+    }
+
+    SECTION("before reading") {
+        std::vector<u8> data(TestData.size());
+        const auto result = file->Read(0, data.size(), data.data());
+        REQUIRE(result.Succeeded());
+        REQUIRE(*result == data.size());
+        REQUIRE(data == TestData);
+    }
+}
+
+TEST_CASE("DiskFile reports write-back errors", "[core][file_sys]") {
+    Settings::values.use_save_write_back = true;
+    SCOPE_EXIT({ Settings::values.use_save_write_back = false; });
+    const std::string path = FileUtil::GetTempDirectory() + "citra_disk_file_test.bin";
+    SCOPE_EXIT({ FileUtil::Delete(path); });
+    REQUIRE(FileUtil::CreateEmptyFile(path));
+
+    // The host file is read-only, so buffered writes succeed but can't be written back
+    auto file = OpenFile(path, "rb");
+    WriteTestData(*file);
+
+    std::vector<u8> data(TestData.size());
+    const auto result = file->Read(0, data.size(), data.data());
+    REQUIRE(result.Failed());
+    REQUIRE(result.Code() != ERROR_INSUFFICIENT_SPACE);
+
+    // The error is only reported once
+    REQUIRE(file->Read(0, data.size(), data.data()).Succeeded());
+}
+
+} // namespace FileSys
@@ -0,0 +1,202 @@
+// Copyright 2020 Citra Emulator Project
+// Licensed under GPLv2 or any later version
+// Refer to the license.txt file included.
+
+#include <algorithm>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+#include <catch2/catch.hpp>
+#include "common/file_util.h"
+#include "core/file_sys/layered_fs.h"
+#include "core/file_sys/romfs_reader.h"
+
+namespace FileSys {
+
+namespace {
+
+/// A RomFS held in memory, with no host file behind it
+class MemoryRomFSReader : public RomFSReader {
+public:
+    explicit MemoryRomFSReader(std::vector<u8> data) : data(std::move(data)) {}
+
+    std::size_t GetSize() const override {
+        return data.size();
+    }
+
+    std::size_t ReadFile(std::size_t offset, std::size_t length, u8* buffer) override {
+        if (offset >= data.size()) {
+            return 0;
+        }
+        length = std::min(length, data.size() - offset);
+        std::memcpy(buffer, data.data() + offset, length);
+        return length;
+    }
+
+private:
+    std::vector<u8> data;
+};
+
+/// Builds a RomFS holding only the root directory.
+std::vector<u8> MakeEmptyRomFS() {
+    RomFSHeader header{};
+    header.header_length = sizeof(header);
+    header.directory_hash_table = {0x28, 12};
+    header.directory_metadata_table = {0x34, 0x18};
+    header.file_hash_table = {0x4C, 12};
+    header.file_metadata_table = {0x58, 0};
+    header.file_data_offset = 0x60;
+
+    std::vector<u8> data(header.file_data_offset, 0xFF);
+    std::memcpy(data.data(), &header, sizeof(header));
+    // Root directory: it is its own parent, and has no siblings, children nor name
+    const u32 root_metadata[6]{0, 0xFFFFFFFF, 0xFFFFFFFF, 0xFFFFFFFF, 0xFFFFFFFF, 0};
+    std::memcpy(data.data() + 0x34, root_metadata, sizeof(root_metadata));
+    const u32 root_offset = 0;
+    std::memcpy(data.data() + 0x28, &root_offset, sizeof(root_offset));
+    return data;
+}
+
+std::vector<u8> ReadAll(RomFSReader& romfs) {
+    std::vector<u8> data(romfs.GetSize());
+    romfs.ReadFile(0, data.size(), data.data());
+    return data;
+}
+
+void WriteFile(const std::string& path, const std::vector<u8>& data) {
+    REQUIRE(FileUtil::CreateFullPath(path));
+    FileUtil::IOFile file(path, "wb");
+    REQUIRE(file.WriteBytes(data.data(), data.size()) == data.size());
+}
+
+void WriteFile(const std::string& path, const std::string& data) {
+    WriteFile(path, std::vector<u8>(data.begin(), data.end()));
+}
+
+/// A ROM with a RomFS and its mods, in a temporary directory
+class TestTitle {
+public:
+    TestTitle() {
+        FileUtil::DeleteDirRecursively(root);
+        FileUtil::UpdateUserPath(FileUtil::UserPath::CacheDir, root + "cache");
+
+        // Build the base RomFS with LayeredFS, out of the files of a directory
+        WriteFile(root + "base/a.txt", "original a");
+        std::vector<u8> b(100);
+        for (std::size_t i = 0; i < b.size(); ++i) {
+            b[i] = static_cast<u8>(i);
+        }
+        WriteFile(root + "base/b.bin", b);
+        LayeredFS base(std::make_shared<MemoryRomFSReader>(MakeEmptyRomFS()), root + "base/", "");
+        base_romfs = ReadAll(base);
+        WriteRom(base_romfs, 0);
+        ClearCache();
+
+        // Replace a.txt, and patch the first byte of b.bin
+        WriteFile(root + "mod/romfs/a.txt", "replaced a");
+        WriteFile(root + "mod/romfs_ext/b.bin.ips",
+                  std::vector<u8>{'P', 'A', 'T', 'C', 'H', 0, 0, 0, 0, 1, 'X', 'E', 'O', 'F'});
+    }
+
+    ~TestTitle() {
+        FileUtil::DeleteDirRecursively(root);
+    }
+
+    /// Writes the ROM holding the RomFS, followed by padding
+    void WriteRom(const std::vector<u8>& romfs, std::size_t padding) {
+        std::vector<u8> rom(romfs);
+        rom.resize(rom.size() + padding);
+        WriteFile(root + "rom.bin", rom);
+        romfs_size = romfs.size();
+    }
+
+    /// Returns the RomFS with the mods applied, using the cache when possible
+    std::vector<u8> Load() const {
+        auto romfs = std::make_shared<DirectRomFSReader>(FileUtil::IOFile(root + "rom.bin", "rb"),
+                                                         0, romfs_size);
+        LayeredFS layered(std::move(romfs), root + "mod/romfs/", root + "mod/romfs_ext/");
+        return ReadAll(layered);
+    }
+
+    /// Returns the RomFS with the mods applied, rebuilt without the cache
+    std::vector<u8> LoadWithoutCache() const {
+        ClearCache();
+        return Load();
+    }
+
+    std::string GetCachePath() const {
+        FileUtil::FSTEntry entry;
+        FileUtil::ScanDirectoryTree(root + "cache/layered_fs", entry);
+        return entry.children.size() == 1 ? entry.children[0].physicalName : "";
+    }
+
+    void ClearCache() const {
+        FileUtil::DeleteDirRecursively(root + "cache");
+    }
+
+    const std::string root = FileUtil::GetTempDirectory() + "citra_layered_fs_test/";
+    std::vector<u8> base_romfs;
+    std::size_t romfs_size = 0;
+};
+
+} // Anonymous namespace
+
+TEST_CASE("LayeredFS caches the rebuilt RomFS", "[core][file_sys]") {
+    TestTitle title;
+    const std::vector<u8> rebuilt = title.LoadWithoutCache();
+    REQUIRE(rebuilt != title.base_romfs);
+    REQUIRE(!title.GetCachePath().empty());
+    REQUIRE(title.Load() == rebuilt);
+}
+
+TEST_CASE("LayeredFS rebuilds the cache when the files change", "[core][file_sys]") {
+    TestTitle title;
+    const std::vector<u8> original = title.Load();
+
+    SECTION("a replacement file") {
+        WriteFile(title.root + "mod/romfs/a.txt", "replaced a, differently");
+    }
+
+    SECTION("a patch file") {
+        WriteFile(title.root + "mod/romfs_ext/b.bin.ips",
+                  std::vector<u8>{'P', 'A', 'T', 'C', 'H', 0, 0, 2, 0, 2, 'Y', 'Z', 'E', 'O', 'F'});
+    }
+
+    SECTION("the ROM") {
+        // Change the second byte of b.bin, which is kept by the patch. The RomFS metadata is
+        // unchanged, only the ROM file size tells it apart.
+        std::vector<u8> romfs = title.base_romfs;
+        const u8 b_second_byte[]{0, 1, 2, 3};
+        auto itr = std::search(romfs.begin(), romfs.end(), std::begin(b_second_byte),
+                               std::end(b_second_byte));
+        REQUIRE(itr != romfs.end());
+        *(itr + 1) = 0xAA;
+        title.WriteRom(romfs, 0x10);
+    }
+
+    const std::vector<u8> changed = title.Load();
+    REQUIRE(changed != original);
+    REQUIRE(changed == title.LoadWithoutCache());
+}
+
+TEST_CASE("LayeredFS rejects corrupted cache entries", "[core][file_sys]") {
+    TestTitle title;
+    const std::vector<u8> rebuilt = title.Load();
+    const std::string cache_path = title.GetCachePath();
+    REQUIRE(!cache_path.empty());
+
+    // Make the size of the first file larger than the base RomFS and the cache
+    std::vector<u8> cache(FileUtil::GetSize(cache_path));
+    REQUIRE(FileUtil::IOFile(cache_path, "rb").ReadBytes(cache.data(), cache.size()) ==
+            cache.size());
+    u64 metadata_size;
+    std::memcpy(&metadata_size, cache.data() + 0x10, sizeof(metadata_size));
+    const u64 huge_size = 0x7FFFFFFFFFFFFFFF;
+    std::memcpy(cache.data() + 0x28 + metadata_size + 0x10, &huge_size, sizeof(huge_size));
+    WriteFile(cache_path, cache);
+
+    REQUIRE(title.Load() == rebuilt);
+}
+
+} // namespace FileSys
@@ -0,0 +1,119 @@
+// Copyright 2020 Citra Emulator Project
+// Licensed under GPLv2 or any later version
+// Refer to the license.txt file included.
+
+#include <cstring>
+#include <string>
+#include <vector>
+#include <catch2/catch.hpp>
+#include "core/file_sys/ncch_container.h"
+
+namespace FileSys {
+
+namespace {
+
+/**
+ * Builds an LZSS compressed file: the uncompressed prefix, then the compressed stream, which is
+ * read backwards from its end, then the footer.
+ */
+std::vector<u8> MakeCompressed(const std::string& prefix, const std::vector<u8>& stream,
+                               u32 additional_size) {
+    std::vector<u8> result(prefix.begin(), prefix.end());
+    result.insert(result.end(), stream.begin(), stream.end());
+    const u32 buffer_top_and_bottom = (8u << 24) | static_cast<u32>(stream.size() + 8);
+    result.resize(result.size() + 8);
+    std::memcpy(result.data() + result.size() - 8, &buffer_top_and_bottom, sizeof(u32));
+    std::memcpy(result.data() + result.size() - 4, &additional_size, sizeof(u32));
+    return result;
+}
+
+/// Encodes a back reference copying `size` bytes from `distance` bytes after the destination.
+std::vector<u8> Reference(u32 size, u32 distance) {
+    const u32 value = ((size - 3) << 12) | (distance - 3);
+    return {static_cast<u8>(value & 0xFF), static_cast<u8>(value >> 8)};
+}
+
+std::vector<u8> Concat(std::initializer_list<std::vector<u8>> parts) {
+    std::vector<u8> result;
+    for (const auto& part : parts) {
+        result.insert(result.end(), part.begin(), part.end());
+    }
+    return result;
+}
+
+std::string Decompress(const std::vector<u8>& compressed, bool& success) {
+    const u32 size = static_cast<u32>(compressed.size());
+    std::vector<u8> decompressed(LZSS_GetDecompressedSize(compressed.data(), size));
+    success = LZSS_Decompress(compressed.data(), size, decompressed.data(),
+                              static_cast<u32>(decompressed.size()));
+    return std::string(decompressed.begin(), decompressed.end());
+}
+
+} // Anonymous namespace
+
+TEST_CASE("LZSS_Decompress literals and overlapping references", "[core][file_sys]") {
+    // Tokens are produced from the end of the output: the literals "X", "C", "B", "A", then a
+    // reference to the 3 bytes following its destination, which repeats them
+    const std::vector<u8> stream = Concat({Reference(18, 3), {'A', 'B', 'C', 'X'}, {0b0000'1000}});
+    const auto compressed = MakeCompressed("", stream, 7);
+
+    bool success = false;
+    REQUIRE(Decompress(compressed, success) == "ABCABCABCABCABCABCABCX");
+    REQUIRE(success);
+}
+
+TEST_CASE("LZSS_Decompress non-overlapping references and prefix", "[core][file_sys]") {
+    // Ten literals, then three references copying the ten bytes that follow them. The prefix
+    // below the compressed stream is kept as is.
+    const std::vector<u8> stream = Concat({Reference(10, 10), Reference(10, 10), Reference(10, 10),
+                                           {'0', '1'},
+                                           {0b0011'1000},
+                                           {'2', '3', '4', '5', '6', '7', '8', '9'},
+                                           {0b0000'0000}});
+    const auto compressed = MakeCompressed("PRE", stream, 14);
+
+    bool success = false;
+    REQUIRE(Decompress(compressed, success) == "PRE0123456789012345678901234567890123456789");
+    REQUIRE(success);
+}
+
+TEST_CASE("LZSS_Decompress rejects out of bounds data", "[core][file_sys]") {
+    bool success = true;
+
+    SECTION("reference past the end of the output") {
+        Decompress(MakeCompressed("", Concat({Reference(3, 3), {0b1000'0000}}), 5), success);
+    }
+
+    SECTION("reference longer than the remaining output") {
+        const std::vector<u8> stream = Concat({Reference(18, 3), {'A', 'B'}, {0b0010'0000}});
+        Decompress(MakeCompressed("", stream, 3), success);
+    }
+
+    SECTION("truncated reference") {
+        Decompress(MakeCompressed("", {'A', 0b1000'0000}, 4), success);
+    }
+
+    SECTION("footer pointing outside of the file") {
+        std::vector<u8> compressed = MakeCompressed("", {'A', 0b0000'0000}, 4);
+        compressed[compressed.size() - 5] = 0xFF; // Footer size
+        Decompress(compressed, success);
+    }
+
+    SECTION("too small") {
+        const std::vector<u8> compressed(7);
+        std::vector<u8> decompressed(16);
+        success = LZSS_Decompress(compressed.data(), static_cast<u32>(compressed.size()),
+                                  decompressed.data(), static_cast<u32>(decompressed.size()));
+    }
+
+    SECTION("output smaller than the input") {
+        const auto compressed = MakeCompressed("", {'A', 0b0000'0000}, 0);
+        std::vector<u8> decompressed(compressed.size() - 1);
+        success = LZSS_Decompress(compressed.data(), static_cast<u32>(compressed.size()),
+                                  decompressed.data(), static_cast<u32>(decompressed.size()));
+    }
+
+    REQUIRE(!success);
+}
+
+} // namespace FileSys
@@ -0,0 +1,141 @@
+// Copyright 2020 Citra Emulator Project
+// Licensed under GPLv2 or any later version
+// Refer to the license.txt file included.
+
+#include <array>
+#include <memory>
+#include <string>
+#include <vector>
+#include <catch2/catch.hpp>
+#include "common/file_util.h"
+#include "common/scope_exit.h"
+#include "core/file_sys/romfs_reader.h"
+#include "core/hw/aes/cipher.h"
+#include "core/settings.h"
+
+namespace FileSys {
+
+namespace {
+
+constexpr std::size_t BlockSize = DirectRomFSReader::BlockSize;
+constexpr std::size_t FileOffset = 0x200;
+constexpr std::size_t DataSize = 16 * BlockSize + 0x123;
+constexpr std::array<u8, 16> Key{0x01, 0x23, 0x45, 0x67, 0x89, 0xAB, 0xCD, 0xEF,
+                                 0xFE, 0xDC, 0xBA, 0x98, 0x76, 0x54, 0x32, 0x10};
+constexpr std::array<u8, 16> Ctr{0x00, 0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0x77,
+                                 0x88, 0x99, 0xAA, 0xBB, 0xCC, 0xDD, 0xEE, 0xFF};
+
+std::vector<u8> MakePlainText() {
+    std::vector<u8> data(DataSize);
+    u32 seed = 42;
+    for (u8& value : data) {
+        seed = seed * 1103515245 + 12345;
+        value = static_cast<u8>(seed >> 16);
+    }
+    return data;
+}
+
+/// Writes the RomFS encrypted after a header, like in an NCCH.
+void WriteEncryptedFile(const std::string& path, std::vector<u8> data) {
+    HW::AES::TransformCTR(Key, Ctr, 0, data.data(), data.size());
+    FileUtil::IOFile file(path, "wb");
+    const std::vector<u8> header(FileOffset, 0xCC);
+    REQUIRE(file.WriteBytes(header.data(), header.size()) == header.size());
+    REQUIRE(file.WriteBytes(data.data(), data.size()) == data.size());
+}
+
+std::unique_ptr<DirectRomFSReader> OpenReader(const std::string& path) {
+    return std::make_unique<DirectRomFSReader>(FileUtil::IOFile(path, "rb"), FileOffset, DataSize,
+                                               Key, Ctr, 0);
+}
+
+std::vector<u8> Read(DirectRomFSReader& reader, std::size_t offset, std::size_t length) {
+    std::vector<u8> buffer(length);
+    buffer.resize(reader.ReadFile(offset, length, buffer.data()));
+    return buffer;
+}
+
+std::vector<u8> Slice(const std::vector<u8>& data, std::size_t offset, std::size_t length) {
+    return std::vector<u8>(data.begin() + offset, data.begin() + offset + length);
+}
+
+} // Anonymous namespace
+
+TEST_CASE("DirectRomFSReader decrypts reads through its block cache", "[core][file_sys]") {
+    Settings::values.romfs_cache_size_mb = 1;
+    const std::string path = FileUtil::GetTempDirectory() + "citra_romfs_reader_test.bin";
+    SCOPE_EXIT({ FileUtil::Delete(path); });
+    const std::vector<u8> plain_text = MakePlainText();
+    WriteEncryptedFile(path, plain_text);
+
+    auto reader = OpenReader(path);
+    REQUIRE(reader->GetSize() == DataSize);
+    REQUIRE(reader->GetDataPointer(0, 16) == nullptr);
+
+    // Unaligned reads, within a block, across blocks, and at the end of the data
+    REQUIRE(Read(*reader, 5, 100) == Slice(plain_text, 5, 100));
+    REQUIRE(Read(*reader, BlockSize - 7, 20) == Slice(plain_text, BlockSize - 7, 20));
+    REQUIRE(Read(*reader, DataSize - 10, 100) == Slice(plain_text, DataSize - 10, 10));
+    REQUIRE(Read(*reader, DataSize, 1).empty());
+
+    // Large reads bypass the cache
+    const auto stats = reader->GetCacheStats();
+    REQUIRE(Read(*reader, 3, 8 * BlockSize) == Slice(plain_text, 3, 8 * BlockSize));
+    REQUIRE(reader->GetCacheStats().hits == stats.hits);
+    REQUIRE(reader->GetCacheStats().misses == stats.misses);
+
+    // Reading a block again hits the cache
+    REQUIRE(Read(*reader, 40, 8) == Slice(plain_text, 40, 8));
+    REQUIRE(reader->GetCacheStats().hits == stats.hits + 1);
+}
+
+TEST_CASE("DirectRomFSReader shares its cache between readers of a RomFS", "[core][file_sys]") {
+    Settings::values.romfs_cache_size_mb = 1;
+    const std::string path = FileUtil::GetTempDirectory() + "citra_romfs_reader_share_test.bin";
+    SCOPE_EXIT({ FileUtil::Delete(path); });
+    const std::vector<u8> plain_text = MakePlainText();
+    WriteEncryptedFile(path, plain_text);
+
+    auto first = OpenReader(path);
+    auto second = OpenReader(path);
+    REQUIRE(Read(*first, 0x1000, 0x100) == Slice(plain_text, 0x1000, 0x100));
+    const auto stats = second->GetCacheStats();
+    REQUIRE(stats.misses == 1);
+
+    // The block read by the first reader is cached for the second one
+    REQUIRE(Read(*second, 0x1100, 0x100) == Slice(plain_text, 0x1100, 0x100));
+    REQUIRE(second->GetCacheStats().hits == stats.hits + 1);
+
+    // A reader opened once the others are gone starts from an empty cache
+    first.reset();
+    second.reset();
+    auto third = OpenReader(path);
+    REQUIRE(third->GetCacheStats().hits == 0);
+    REQUIRE(third->GetCacheStats().misses == 0);
+}
+
+TEST_CASE("DirectRomFSReader reads ahead of sequential reads", "[core][file_sys]") {
+    Settings::values.romfs_cache_size_mb = 1;
+    const std::string path = FileUtil::GetTempDirectory() + "citra_romfs_reader_ahead_test.bin";
+    SCOPE_EXIT({ FileUtil::Delete(path); });
+    const std::vector<u8> plain_text = MakePlainText();
+    WriteEncryptedFile(path, plain_text);
+
+    // Another reader keeps the cache alive once the reading one is gone
+    auto other = OpenReader(path);
+    auto reader = OpenReader(path);
+    REQUIRE(Read(*reader, 0, BlockSize) == Slice(plain_text, 0, BlockSize));
+    REQUIRE(Read(*reader, BlockSize, BlockSize) == Slice(plain_text, BlockSize, BlockSize));
+
+    // Destroying the reader waits for its read-ahead to finish
+    reader.reset();
+    const auto stats = other->GetCacheStats();
+    REQUIRE(stats.read_ahead_blocks > 0);
+
+    // The blocks following the sequential reads were cached, and decrypted correctly
+    REQUIRE(Read(*other, 2 * BlockSize + 1, 0x80) == Slice(plain_text, 2 * BlockSize + 1, 0x80));
+    REQUIRE(other->GetCacheStats().hits == stats.hits + 1);
+    REQUIRE(other->GetCacheStats().misses == stats.misses);
+}
+
+} // namespace FileSys
@@ -0,0 +1,110 @@
+// Copyright 2020 Citra Emulator Project
+// Licensed under GPLv2 or any later version
+// Refer to the license.txt file included.
+
+#include <array>
+#include <chrono>
+#include <string>
+#include <catch2/catch.hpp>
+#include "common/file_util.h"
+#include "common/scope_exit.h"
+#include "core/hle/call_profiler.h"
+#include "core/hle/service/service.h"
+
+namespace HLE {
+
+namespace {
+
+class TestService final : public Service::ServiceFramework<TestService> {
+public:
+    TestService() : ServiceFramework("test:p") {
+        static const FunctionInfo functions[] = {
+            {0x00010000, &TestService::Handler, "Fast"},
+            {0x00020000, &TestService::Handler, "Slow, \"really\""},
+        };
+        RegisterHandlers(functions);
+    }
+
+private:
+    void Handler(Kernel::HLERequestContext& ctx) {}
+};
+
+} // Anonymous namespace
+
+using std::chrono::nanoseconds;
+
+TEST_CASE("CallProfiler aggregates service calls", "[core][hle]") {
+    TestService service;
+    CallProfiler profiler(0);
+
+    profiler.RecordServiceCall(service, 0x00010000, nanoseconds{1});
+    profiler.RecordServiceCall(service, 0x00010000, nanoseconds{3});
+    profiler.RecordServiceCall(service, 0x00010000, nanoseconds{1000});
+    profiler.RecordServiceCall(service, 0x00020000, std::chrono::hours{1});
+
+    const auto stats = profiler.GetServiceCallStats();
+    REQUIRE(stats.size() == 2);
+
+    // The most expensive function comes first
+    REQUIRE(stats[0].function_name == "Slow, \"really\"");
+    REQUIRE(stats[0].count == 1);
+    REQUIRE(stats[0].histogram[CallProfiler::NumHistogramBuckets - 1] == 1);
+
+    REQUIRE(stats[1].service_name == "test:p");
+    REQUIRE(stats[1].function_name == "Fast");
+    REQUIRE(stats[1].header == 0x00010000);
+    REQUIRE(stats[1].count == 3);
+    REQUIRE(stats[1].total_ns == 1004);
+    REQUIRE(stats[1].max_ns == 1000);
+
+    // Bucket i counts calls of [2^i, 2^(i+1)) ns: 1 ns, 3 ns and 1000 ns
+    std::array<u64, CallProfiler::NumHistogramBuckets> histogram{};
+    histogram[0] = 1;
+    histogram[1] = 1;
+    histogram[9] = 1;
+    REQUIRE(stats[1].histogram == histogram);
+
+    profiler.Reset();
+    REQUIRE(profiler.GetServiceCallStats().empty());
+}
+
+TEST_CASE("CallProfiler counts SVC calls", "[core][hle]") {
+    CallProfiler profiler(0);
+
+    profiler.RecordSVCCall(0x32, "SendSyncRequest");
+    profiler.RecordSVCCall(0x32, "SendSyncRequest");
+    profiler.RecordSVCCall(0x0A, "SleepThread");
+    profiler.RecordSVCCall(CallProfiler::NumSVCs, "Invalid");
+
+    const auto stats = profiler.GetSVCCallStats();
+    REQUIRE(stats.size() == 2);
+    REQUIRE(stats[0].id == 0x32);
+    REQUIRE(stats[0].name == "SendSyncRequest");
+    REQUIRE(stats[0].count == 2);
+    REQUIRE(stats[1].id == 0x0A);
+    REQUIRE(stats[1].count == 1);
+}
+
+TEST_CASE("CallProfiler escapes names in dumps", "[core][hle]") {
+    TestService service;
+    CallProfiler profiler(0);
+    profiler.RecordServiceCall(service, 0x00020000, nanoseconds{10});
+
+    const std::string path = FileUtil::GetTempDirectory() + "call_profiler_test";
+    SCOPE_EXIT({
+        FileUtil::Delete(path + ".csv");
+        FileUtil::Delete(path + ".json");
+    });
+
+    std::string out;
+    REQUIRE(profiler.DumpCSV(path + ".csv"));
+    FileUtil::ReadFileToString(true, path + ".csv", out);
+    REQUIRE(out.find("service,\"test:p\",\"Slow, \"\"really\"\"\",0x00020000,1,10,10,") !=
+            std::string::npos);
+
+    REQUIRE(profiler.DumpJSON(path + ".json"));
+    FileUtil::ReadFileToString(true, path + ".json", out);
+    REQUIRE(out.find("\"function\": \"Slow, \\\"really\\\"\"") != std::string::npos);
+}
+
+} // namespace HLE
@@ -0,0 +1,211 @@
+// Copyright 2020 Citra Emulator Project
+// Licensed under GPLv2 or any later version
+// Refer to the license.txt file included.
+
+#include <cstring>
+#include <string>
+#include <utility>
+#include <vector>
+#include <catch2/catch.hpp>
+#include "common/alignment.h"
+#include "common/file_util.h"
+#include "core/file_sys/cia_common.h"
+#include "core/file_sys/cia_container.h"
+#include "core/file_sys/ncch_container.h"
+#include "core/file_sys/ticket.h"
+#include "core/file_sys/title_metadata.h"
+#include "core/hle/service/am/am.h"
+#include "core/hle/service/fs/archive.h"
+#include "core/loader/loader.h"
+
+namespace Service::AM {
+
+namespace {
+
+constexpr u64 TestTitleId = 0x0004000000123400;
+constexpr std::size_t CIAAlignment = 0x40;
+/// Size of the RSA-2048 signature, with its type and padding
+constexpr std::size_t SignatureSize = 0x140;
+
+void Write(std::vector<u8>& data, std::size_t offset, const void* value, std::size_t size) {
+    if (data.size() < offset + size) {
+        data.resize(offset + size);
+    }
+    std::memcpy(data.data() + offset, value, size);
+}
+
+/// Writes the type of an RSA-2048 signature, leaving the signature itself blank.
+void WriteSignature(std::vector<u8>& data, std::size_t offset) {
+    const u32_be signature_type = FileSys::Rsa2048Sha256;
+    Write(data, offset, &signature_type, sizeof(signature_type));
+}
+
+/// Builds an unencrypted CIA holding contents of the specified sizes, followed by a meta section.
+std::vector<u8> MakeCIA(const std::vector<u64>& content_sizes) {
+    const std::size_t ticket_size = SignatureSize + sizeof(FileSys::Ticket::Body);
+    const std::size_t tmd_size =
+        SignatureSize + sizeof(FileSys::TitleMetadata::Body) +
+        content_sizes.size() * sizeof(FileSys::TitleMetadata::ContentChunk);
+    u64 content_size = 0;
+    for (const u64 size : content_sizes) {
+        content_size += size;
+    }
+
+    // The certificate chain is empty
+    const std::size_t ticket_offset = Common::AlignUp(FileSys::CIA_HEADER_SIZE, CIAAlignment);
+    const std::size_t tmd_offset = Common::AlignUp(ticket_offset + ticket_size, CIAAlignment);
+    const std::size_t content_offset = Common::AlignUp(tmd_offset + tmd_size, CIAAlignment);
+    const std::size_t meta_offset = Common::AlignUp(content_offset + content_size, CIAAlignment);
+
+    std::vector<u8> cia(meta_offset + FileSys::CIA_METADATA_SIZE);
+    const u32_le header_size = static_cast<u32>(FileSys::CIA_HEADER_SIZE);
+    const u32_le ticket_size_le = static_cast<u32>(ticket_size);
+    const u32_le tmd_size_le = static_cast<u32>(tmd_size);
+    const u32_le meta_size = static_cast<u32>(FileSys::CIA_METADATA_SIZE);
+    const u64_le content_size_le = content_size;
+    Write(cia, 0x00, &header_size, sizeof(header_size));
+    Write(cia, 0x0C, &ticket_size_le, sizeof(ticket_size_le));
+    Write(cia, 0x10, &tmd_size_le, sizeof(tmd_size_le));
+    Write(cia, 0x14, &meta_size, sizeof(meta_size));
+    Write(cia, 0x18, &content_size_le, sizeof(content_size_le));
+    for (std::size_t i = 0; i < content_sizes.size(); ++i) {
+        cia[0x20 + i / 8] |= 0x80 >> (i % 8);
+    }
+
+    WriteSignature(cia, ticket_offset);
+    FileSys::Ticket::Body ticket{};
+    ticket.title_id = TestTitleId;
+    Write(cia, ticket_offset + SignatureSize, &ticket, sizeof(ticket));
+
+    WriteSignature(cia, tmd_offset);
+    FileSys::TitleMetadata::Body tmd{};
+    tmd.title_id = TestTitleId;
+    tmd.content_count = static_cast<u16>(content_sizes.size());
+    Write(cia, tmd_offset + SignatureSize, &tmd, sizeof(tmd));
+
+    std::size_t offset = content_offset;
+    for (std::size_t i = 0; i < content_sizes.size(); ++i) {
+        FileSys::TitleMetadata::ContentChunk chunk{};
+        chunk.id = static_cast<u32>(i);
+        chunk.index = static_cast<u16>(i);
+        chunk.size = content_sizes[i];
+        Write(cia, tmd_offset + SignatureSize + sizeof(tmd) + i * sizeof(chunk), &chunk,
+              sizeof(chunk));
+
+        for (u64 j = 0; j < content_sizes[i]; ++j) {
+            cia[offset++] = static_cast<u8>(i + j);
+        }
+    }
+    return cia;
+}
+
+/// Builds an unencrypted NCCH of the specified size, with a RomFS and nothing else.
+std::vector<u8> MakeNCCH(std::size_t size) {
+    NCCH_Header header{};
+    header.magic = Loader::MakeMagic('N', 'C', 'C', 'H');
+    header.no_crypto.Assign(1);
+    header.romfs_offset = 1;
+    header.romfs_size = 1;
+    std::vector<u8> ncch(size);
+    std::memcpy(ncch.data(), &header, sizeof(header));
+    return ncch;
+}
+
+/// Writes the main content of the test title, overwriting the existing file in place
+void OverwriteContent(const std::vector<u8>& data) {
+    const std::string path = GetTitleContentPath(FS::MediaType::SDMC, TestTitleId);
+    FileUtil::IOFile file(path, "r+b");
+    REQUIRE(file.WriteBytes(data.data(), data.size()) == data.size());
+    REQUIRE(file.Resize(data.size()));
+}
+
+/// Installs the test title from a CIA
+void InstallTestTitle(const std::string& root, const std::vector<u64>& content_sizes) {
+    const std::vector<u8> cia = MakeCIA(content_sizes);
+    const std::string path = root + "test.cia";
+    REQUIRE(FileUtil::CreateFullPath(path));
+    REQUIRE(FileUtil::IOFile(path, "wb").WriteBytes(cia.data(), cia.size()) == cia.size());
+    REQUIRE(InstallCIA(path) == InstallStatus::Success);
+}
+
+} // Anonymous namespace
+
+TEST_CASE("InstallCIA reports progress over the installed data", "[core][am]") {
+    const std::string root = FileUtil::GetTempDirectory() + "citra_am_install_test/";
+    FileUtil::DeleteDirRecursively(root);
+    FileUtil::UpdateUserPath(FileUtil::UserPath::SDMCDir, root + "sdmc");
+    FileUtil::UpdateUserPath(FileUtil::UserPath::NANDDir, root + "nand");
+
+    // Contents larger than the install chunks, and a small one
+    const std::vector<u64> content_sizes{0x123450, 0x20, 0x300000};
+    const std::vector<u8> cia = MakeCIA(content_sizes);
+    const std::string path = root + "test.cia";
+    REQUIRE(FileUtil::CreateFullPath(path));
+    REQUIRE(FileUtil::IOFile(path, "wb").WriteBytes(cia.data(), cia.size()) == cia.size());
+
+    FileSys::CIAContainer container;
+    REQUIRE(container.Load(cia) == Loader::ResultStatus::Success);
+    u64 install_size = container.GetContentOffset();
+    for (const u64 size : content_sizes) {
+        install_size += size;
+    }
+    REQUIRE(install_size < cia.size());
+
+    std::vector<std::pair<std::size_t, std::size_t>> progress;
+    REQUIRE(InstallCIA(path, [&progress](std::size_t written, std::size_t total) {
+                progress.emplace_back(written, total);
+            }) == InstallStatus::Success);
+
+    // The total is the installed data, which excludes the meta section, and is reached at the end
+    REQUIRE(!progress.empty());
+    for (std::size_t i = 0; i < progress.size(); ++i) {
+        REQUIRE(progress[i].second == install_size);
+        REQUIRE(progress[i].first <= install_size);
+        if (i != 0) {
+            REQUIRE(progress[i].first >= progress[i - 1].first);
+        }
+    }
+    REQUIRE(progress.back().first == install_size);
+
+    // The contents were installed
+    for (std::size_t i = 0; i < content_sizes.size(); ++i) {
+        const std::string content_path =
+            GetTitleContentPath(FS::MediaType::SDMC, TestTitleId, static_cast<u16>(i));
+        REQUIRE(FileUtil::GetSize(content_path) == content_sizes[i]);
+    }
+
+    FileUtil::DeleteDirRecursively(root);
+}
+
+TEST_CASE("The title index follows changes to installed titles", "[core][am]") {
+    const std::string root = FileUtil::GetTempDirectory() + "citra_am_index_test/";
+    FileUtil::DeleteDirRecursively(root);
+    FileUtil::UpdateUserPath(FileUtil::UserPath::SDMCDir, root + "sdmc");
+    FileUtil::UpdateUserPath(FileUtil::UserPath::NANDDir, root + "nand");
+    FileUtil::UpdateUserPath(FileUtil::UserPath::CacheDir, root + "cache");
+    const std::vector<u64> title_ids{TestTitleId};
+
+    // The content of the CIA isn't an NCCH
+    InstallTestTitle(root, {0x400});
+    REQUIRE(ScanForInstalledTitles(FS::MediaType::SDMC).empty());
+
+    // Invalid titles aren't indexed: they are parsed again, and found once they can be loaded,
+    // even though their files look the same
+    OverwriteContent(MakeNCCH(0x400));
+    REQUIRE(ScanForInstalledTitles(FS::MediaType::SDMC) == title_ids);
+    REQUIRE(ScanForInstalledTitles(FS::MediaType::SDMC) == title_ids);
+
+    // Overwriting the content in place doesn't modify the folder, but is noticed
+    OverwriteContent(std::vector<u8>(0x200));
+    REQUIRE(ScanForInstalledTitles(FS::MediaType::SDMC).empty());
+
+    // So is updating the index directly
+    OverwriteContent(MakeNCCH(0x300));
+    REQUIRE(UpdateTitleIndex(FS::MediaType::SDMC, TestTitleId));
+    REQUIRE(ScanForInstalledTitles(FS::MediaType::SDMC) == title_ids);
+    REQUIRE(ScanForInstalledTitles(FS::MediaType::NAND).empty());
+
+    FileUtil::DeleteDirRecursively(root);
+}
+
+} // namespace Service::AM
@@ -0,0 +1,107 @@
+// Copyright 2020 Citra Emulator Project
+// Licensed under GPLv2 or any later version
+// Refer to the license.txt file included.
+
+#include <algorithm>
+#include <vector>
+#include <catch2/catch.hpp>
+#include <cryptopp/aes.h>
+#include <cryptopp/modes.h>
+#include "core/hw/aes/cipher.h"
+
+namespace HW::AES {
+
+namespace {
+
+constexpr AESKey Key{0x2B, 0x7E, 0x15, 0x16, 0x28, 0xAE, 0xD2, 0xA6,
+                     0xAB, 0xF7, 0x15, 0x88, 0x09, 0xCF, 0x4F, 0x3C};
+constexpr AESKey IV{0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07,
+                    0x08, 0x09, 0x0A, 0x0B, 0x0C, 0x0D, 0x0E, 0x0F};
+
+/// Large enough for the biggest pieces to be split across several worker threads
+constexpr std::size_t DataSize = 0x500000;
+
+std::vector<u8> MakeData(std::size_t size) {
+    std::vector<u8> data(size);
+    u32 seed = 1;
+    for (u8& value : data) {
+        seed = seed * 1103515245 + 12345;
+        value = static_cast<u8>(seed >> 16);
+    }
+    return data;
+}
+
+} // Anonymous namespace
+
+TEST_CASE("TransformCTR matches a single-threaded transform", "[core][aes]") {
+    const std::vector<u8> data = MakeData(DataSize);
+
+    // Unaligned offsets and sizes, small and split across threads
+    for (const auto& [offset, size] : {std::pair<u64, std::size_t>{0, DataSize},
+                                       {5, DataSize - 5},
+                                       {0x123457, 0x300001},
+                                       {31, 17}}) {
+        std::vector<u8> expected(data.begin(), data.begin() + size);
+        CryptoPP::CTR_Mode<CryptoPP::AES>::Decryption d(Key.data(), Key.size(), IV.data());
+        d.Seek(offset);
+        d.ProcessData(expected.data(), expected.data(), expected.size());
+
+        std::vector<u8> result(data.begin(), data.begin() + size);
+        TransformCTR(Key, IV, offset, result.data(), result.size());
+        // Compared outside of REQUIRE, which would print megabytes of data on failure
+        const bool matches = result == expected;
+        REQUIRE(matches);
+    }
+}
+
+TEST_CASE("CBCDecryptor matches a single-threaded decryption", "[core][aes]") {
+    const std::vector<u8> data = MakeData(DataSize);
+    std::vector<u8> expected(data.size());
+    CryptoPP::CBC_Mode<CryptoPP::AES>::Decryption d(Key.data(), Key.size(), IV.data());
+    d.ProcessData(expected.data(), data.data(), data.size());
+
+    // Returns whether decrypting the data in pieces of the specified sizes gives the expected data
+    const auto decrypts_in_pieces = [&](const std::vector<std::size_t>& piece_sizes) {
+        CBCDecryptor decryptor(Key, IV);
+        std::vector<u8> result;
+        std::vector<u8> out;
+        std::size_t offset = 0;
+        for (const std::size_t piece_size : piece_sizes) {
+            decryptor.Process(data.data() + offset, piece_size, out);
+            result.insert(result.end(), out.begin(), out.end());
+            offset += piece_size;
+            REQUIRE(result.size() + decryptor.GetPendingSize() == offset);
+        }
+        REQUIRE(offset == data.size());
+        REQUIRE(decryptor.GetPendingSize() == 0);
+        return result == expected;
+    };
+
+    SECTION("in one piece") {
+        REQUIRE(decrypts_in_pieces({DataSize}));
+    }
+
+    SECTION("in aligned pieces split across threads") {
+        REQUIRE(decrypts_in_pieces({0x200000, 0x300000}));
+    }
+
+    SECTION("in unaligned pieces carrying partial blocks over") {
+        // Carried blocks completed by a large piece, by several small pieces, and by a piece
+        // that is exactly the missing size
+        REQUIRE(decrypts_in_pieces({7, 0x200003, 1, 2, 3, 16, 0x2FFFD8, 5, 2, 1}));
+    }
+
+    SECTION("in pieces smaller than a block") {
+        std::vector<std::size_t> piece_sizes;
+        std::size_t size = 0;
+        for (std::size_t piece_size = 1; size + piece_size < 0x1000;
+             piece_size = piece_size % 31 + 1) {
+            piece_sizes.push_back(piece_size);
+            size += piece_size;
+        }
+        piece_sizes.push_back(DataSize - size);
+        REQUIRE(decrypts_in_pieces(piece_sizes));
+    }
+}
+
+} // namespace HW::AES
@@ -0,0 +1,162 @@
+// Copyright 2020 Citra Emulator Project
+// Licensed under GPLv2 or any later version
+// Refer to the license.txt file included.
+
+#include <cstring>
+#include <string>
+#include <vector>
+#include <catch2/catch.hpp>
+#include "common/file_util.h"
+#include "core/file_sys/ncch_container.h"
+#include "core/loader/game_metadata_index.h"
+#include "core/loader/loader.h"
+#include "core/loader/smdh.h"
+
+namespace Loader {
+
+namespace {
+
+constexpr u64 TestProgramId = 0x0004000000123400;
+/// Size of the 3DSX header, with the SMDH and RomFS offsets
+constexpr u16 THREEDSXHeaderSize = 44;
+constexpr u32 SMDHOffset = 0x40;
+constexpr std::size_t THREEDSXSize = SMDHOffset + sizeof(SMDH);
+constexpr std::size_t NCCHSize = 0x1000;
+
+std::vector<u8> MakeSMDH(u8 marker) {
+    std::vector<u8> smdh(sizeof(SMDH), marker);
+    const u32 magic = MakeMagic('S', 'M', 'D', 'H');
+    std::memcpy(smdh.data(), &magic, sizeof(magic));
+    return smdh;
+}
+
+/// Builds a 3DSX with no code, holding the specified SMDH if it isn't empty
+std::vector<u8> Make3DSX(const std::vector<u8>& smdh) {
+    std::vector<u8> data(THREEDSXSize);
+    const u32 magic = MakeMagic('3', 'D', 'S', 'X');
+    std::memcpy(data.data(), &magic, sizeof(magic));
+    std::memcpy(data.data() + 4, &THREEDSXHeaderSize, sizeof(THREEDSXHeaderSize));
+    if (!smdh.empty()) {
+        const u32 smdh_location[]{SMDHOffset, static_cast<u32>(smdh.size())};
+        std::memcpy(data.data() + 0x20, smdh_location, sizeof(smdh_location));
+        std::memcpy(data.data() + SMDHOffset, smdh.data(), smdh.size());
+    }
+    return data;
+}
+
+/// Builds an NCCH with only a RomFS. If it is encrypted, its seed is unknown so it can't be read.
+std::vector<u8> MakeNCCH(bool encrypted) {
+    NCCH_Header header{};
+    header.magic = MakeMagic('N', 'C', 'C', 'H');
+    header.program_id = TestProgramId;
+    header.romfs_offset = 4;
+    header.romfs_size = 1;
+    if (encrypted) {
+        header.extended_header_size = 0x400;
+        header.seed_crypto.Assign(1);
+    } else {
+        header.no_crypto.Assign(1);
+    }
+    std::vector<u8> data(NCCHSize);
+    std::memcpy(data.data(), &header, sizeof(header));
+    return data;
+}
+
+/// Writes a game, overwriting the existing file in place so that its size may stay the same
+void WriteGame(const std::string& path, const std::vector<u8>& data) {
+    REQUIRE(FileUtil::CreateFullPath(path));
+    if (!FileUtil::Exists(path)) {
+        REQUIRE(FileUtil::CreateEmptyFile(path));
+    }
+    FileUtil::IOFile file(path, "r+b");
+    REQUIRE(file.WriteBytes(data.data(), data.size()) == data.size());
+    REQUIRE(file.Resize(data.size()));
+}
+
+/// A game library and its index, in a temporary directory
+class TestLibrary {
+public:
+    TestLibrary() {
+        FileUtil::DeleteDirRecursively(root);
+        // There are no keys nor seeds
+        FileUtil::UpdateUserPath(FileUtil::UserPath::SysDataDir, root + "sysdata");
+    }
+
+    ~TestLibrary() {
+        FileUtil::DeleteDirRecursively(root);
+    }
+
+    /// Gets the metadata of a game through a newly loaded index, then saves the index
+    GameMetadata Get(const std::string& path) const {
+        GameMetadataIndex index(index_path);
+        GameMetadata metadata = index.Get(path);
+        REQUIRE(index.Save());
+        return metadata;
+    }
+
+    const std::string root = FileUtil::GetTempDirectory() + "citra_game_metadata_index_test/";
+    const std::string index_path = root + "index.bin";
+};
+
+} // Anonymous namespace
+
+TEST_CASE("GameMetadataIndex persists the metadata of games", "[core][loader]") {
+    TestLibrary library;
+    const std::string path = library.root + "games/game.3dsx";
+    const std::vector<u8> smdh = MakeSMDH(0x11);
+    WriteGame(path, Make3DSX(smdh));
+
+    const GameMetadata metadata = library.Get(path);
+    REQUIRE(metadata.file_type == FileType::THREEDSX);
+    REQUIRE(!metadata.encrypted);
+    REQUIRE(metadata.smdh == smdh);
+    REQUIRE(FileUtil::Exists(library.index_path));
+
+    const GameMetadata indexed = library.Get(path);
+    REQUIRE(indexed.file_type == FileType::THREEDSX);
+    REQUIRE(indexed.smdh == smdh);
+
+    // Changing the size of the file makes it read again
+    std::vector<u8> data = Make3DSX(MakeSMDH(0x22));
+    data.resize(data.size() + 0x10);
+    WriteGame(path, data);
+    REQUIRE(library.Get(path).smdh == MakeSMDH(0x22));
+
+    // Several games are read at once, in order
+    const std::string other_path = library.root + "games/other.3dsx";
+    WriteGame(other_path, Make3DSX(MakeSMDH(0x33)));
+    GameMetadataIndex index(library.index_path);
+    const std::vector<GameMetadata> games = index.Get({other_path, path});
+    REQUIRE(games.size() == 2);
+    REQUIRE(games[0].smdh == MakeSMDH(0x33));
+    REQUIRE(games[1].smdh == MakeSMDH(0x22));
+}
+
+TEST_CASE("GameMetadataIndex reads games without an SMDH again", "[core][loader]") {
+    TestLibrary library;
+    const std::string path = library.root + "games/game.3dsx";
+    WriteGame(path, Make3DSX({}));
+    REQUIRE(library.Get(path).smdh.empty());
+
+    // The file keeps its size, and likely its modification time
+    const std::vector<u8> smdh = MakeSMDH(0x44);
+    WriteGame(path, Make3DSX(smdh));
+    REQUIRE(library.Get(path).smdh == smdh);
+}
+
+TEST_CASE("GameMetadataIndex reads encrypted games again", "[core][loader]") {
+    TestLibrary library;
+    const std::string path = library.root + "games/game.cxi";
+    WriteGame(path, MakeNCCH(true));
+    const GameMetadata encrypted = library.Get(path);
+    REQUIRE(encrypted.file_type == FileType::CXI);
+    REQUIRE(encrypted.encrypted);
+
+    // Stands for the keys becoming available, without the file changing size
+    WriteGame(path, MakeNCCH(false));
+    const GameMetadata decrypted = library.Get(path);
+    REQUIRE(decrypted.file_type == FileType::CXI);
+    REQUIRE(!decrypted.encrypted);
+}
+
+} // namespace Loader
@@ -0,0 +1,73 @@
+// Copyright 2020 Citra Emulator Project
+// Licensed under GPLv2 or any later version
+// Refer to the license.txt file included.
+
+#include <sstream>
+#include <vector>
+#include <boost/archive/binary_iarchive.hpp>
+#include <boost/archive/binary_oarchive.hpp>
+#include <catch2/catch.hpp>
+#include "core/memory_snapshot.h"
+
+namespace Memory {
+
+TEST_CASE("SerializeRegion round trips the pages changed since the base", "[core][memory]") {
+    constexpr std::size_t NumPages = 16;
+    std::vector<u8> data(NumPages * PAGE_SIZE);
+    for (std::size_t i = 0; i < data.size(); ++i) {
+        data[i] = static_cast<u8>(i * 7 + i / PAGE_SIZE);
+    }
+    const std::vector<u8> base = data;
+
+    // Change the first byte of one page, the last byte of another and a whole third one
+    data[1 * PAGE_SIZE] ^= 0xFF;
+    data[8 * PAGE_SIZE - 1] ^= 0xFF;
+    std::fill(data.begin() + 15 * PAGE_SIZE, data.end(), u8{0x5A});
+
+    std::stringstream stream;
+    {
+        boost::archive::binary_oarchive oa{stream};
+        SerializeRegion(oa, data.data(), data.size(), &base);
+    }
+    // Only the three changed pages are stored
+    REQUIRE(stream.str().size() > 3 * PAGE_SIZE);
+    REQUIRE(stream.str().size() < 4 * PAGE_SIZE);
+
+    std::vector<u8> loaded(data.size(), 0xCC);
+    {
+        boost::archive::binary_iarchive ia{stream};
+        SerializeRegion(ia, loaded.data(), loaded.size(), &base);
+    }
+    REQUIRE(loaded == data);
+}
+
+TEST_CASE("SerializeRegion stores the whole region without a base", "[core][memory]") {
+    std::vector<u8> data(4 * PAGE_SIZE);
+    for (std::size_t i = 0; i < data.size(); ++i) {
+        data[i] = static_cast<u8>(i * 13);
+    }
+
+    std::stringstream stream;
+    {
+        boost::archive::binary_oarchive oa{stream};
+        SerializeRegion(oa, data.data(), data.size(), nullptr);
+    }
+
+    std::vector<u8> loaded(data.size());
+    {
+        boost::archive::binary_iarchive ia{stream};
+        SerializeRegion(ia, loaded.data(), loaded.size(), nullptr);
+    }
+    REQUIRE(loaded == data);
+}
+
+TEST_CASE("SerializeRegion rejects a base of another size", "[core][memory]") {
+    std::vector<u8> data(2 * PAGE_SIZE);
+    const std::vector<u8> base(PAGE_SIZE);
+
+    std::stringstream stream;
+    boost::archive::binary_oarchive oa{stream};
+    REQUIRE_THROWS_AS(SerializeRegion(oa, data.data(), data.size(), &base), std::runtime_error);
+}
+
+} // namespace Memory
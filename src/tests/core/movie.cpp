@@ -0,0 +1,117 @@
+// Copyright 2020 Citra Emulator Project
+// Licensed under GPLv2 or any later version
+// Refer to the license.txt file included.
+
+#include <limits>
+#include <vector>
+#include <catch2/catch.hpp>
+#include "core/movie.h"
+
+namespace Core {
+
+namespace {
+
+CTMAnchor MakeAnchor(u64 frame, u64 input_offset) {
+    CTMAnchor anchor{};
+    anchor.frame = frame;
+    anchor.input_offset = input_offset;
+    return anchor;
+}
+
+/// Input offsets of a recording where every frame holds 7 bytes of input
+std::vector<u64> MakeFrameIndex(u64 frame_count) {
+    std::vector<u64> frame_index;
+    for (u64 frame = 0; frame <= frame_count; ++frame) {
+        frame_index.push_back(frame * 7);
+    }
+    return frame_index;
+}
+
+} // Anonymous namespace
+
+TEST_CASE("Movie anchors are placed every interval", "[core][movie]") {
+    constexpr u32 interval = 600;
+    std::vector<CTMAnchor> anchors;
+
+    // The first anchor is due right away
+    REQUIRE(Movie::GetNextAnchorFrame(anchors, 0, interval) == 0);
+
+    // Simulate a recording, capturing anchors when due like Movie::Update
+    u64 next = Movie::GetNextAnchorFrame(anchors, 0, interval);
+    for (u64 frame = 0; frame <= 2000; ++frame) {
+        if (frame >= next) {
+            anchors.push_back(MakeAnchor(frame, frame * 7));
+            next = Movie::GetNextAnchorFrame(anchors, frame, interval);
+        }
+    }
+    REQUIRE(anchors.size() == 4);
+    REQUIRE(anchors[0].frame == 0);
+    REQUIRE(anchors[1].frame == 600);
+    REQUIRE(anchors[2].frame == 1200);
+    REQUIRE(anchors[3].frame == 1800);
+
+    // A state loaded after an anchor keeps the interval relative to that anchor
+    REQUIRE(Movie::GetNextAnchorFrame(anchors, 1850, interval) == 2400);
+
+    // Anchors are off with an interval of 0
+    REQUIRE(Movie::GetNextAnchorFrame({}, 0, 0) == std::numeric_limits<u64>::max());
+}
+
+TEST_CASE("Movie anchors that don't match the input are dropped", "[core][movie]") {
+    const std::vector<u64> frame_index = MakeFrameIndex(1000);
+    std::vector<CTMAnchor> anchors{MakeAnchor(0, 0), MakeAnchor(300, 300 * 7),
+                                   MakeAnchor(600, 600 * 7 + 1), MakeAnchor(900, 900 * 7)};
+
+    // Loading a state from frame 700: the anchor at 600 is from another branch of the recording,
+    // and the one at 900 is after the loaded state.
+    Movie::DropStaleAnchors(anchors, MakeFrameIndex(700), 700);
+    REQUIRE(anchors.size() == 2);
+    REQUIRE(anchors[0].frame == 0);
+    REQUIRE(anchors[1].frame == 300);
+
+    // Anchors past the end of the index are dropped too
+    anchors.push_back(MakeAnchor(1200, 1200 * 7));
+    Movie::DropStaleAnchors(anchors, frame_index, 1500);
+    REQUIRE(anchors.size() == 2);
+}
+
+TEST_CASE("Movie seeks restore the closest anchor or play on", "[core][movie]") {
+    const std::vector<CTMAnchor> anchors{MakeAnchor(0, 0), MakeAnchor(600, 600 * 7),
+                                         MakeAnchor(1200, 1200 * 7)};
+
+    SECTION("forward past an anchor ahead of the current frame") {
+        const auto plan = Movie::PlanSeek(anchors, 100, 700);
+        REQUIRE(plan.possible);
+        REQUIRE(plan.anchor == 1);
+    }
+
+    SECTION("forward with no anchor in between plays on") {
+        const auto plan = Movie::PlanSeek(anchors, 650, 1000);
+        REQUIRE(plan.possible);
+        REQUIRE(!plan.anchor);
+    }
+
+    SECTION("to the current frame") {
+        const auto plan = Movie::PlanSeek(anchors, 650, 650);
+        REQUIRE(plan.possible);
+        REQUIRE(!plan.anchor);
+    }
+
+    SECTION("backward restores the anchor at or before the frame") {
+        const auto plan = Movie::PlanSeek(anchors, 1500, 600);
+        REQUIRE(plan.possible);
+        REQUIRE(plan.anchor == 1);
+
+        const auto plan_before = Movie::PlanSeek(anchors, 1500, 599);
+        REQUIRE(plan_before.possible);
+        REQUIRE(plan_before.anchor == 0);
+    }
+
+    SECTION("without anchors") {
+        REQUIRE(Movie::PlanSeek({}, 100, 200).possible);
+        REQUIRE(!Movie::PlanSeek({}, 100, 200).anchor);
+        REQUIRE(!Movie::PlanSeek({}, 200, 100).possible);
+    }
+}
+
+} // namespace Core
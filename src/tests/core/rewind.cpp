@@ -0,0 +1,179 @@
+// Copyright 2020 Citra Emulator Project
+// Licensed under GPLv2 or any later version
+// Refer to the license.txt file included.
+
+#include <chrono>
+#include <sstream>
+#include <thread>
+#include <vector>
+#include <boost/archive/binary_iarchive.hpp>
+#include <boost/archive/binary_oarchive.hpp>
+#include <catch2/catch.hpp>
+#include "core/rewind.h"
+
+namespace Core {
+
+namespace {
+
+constexpr std::size_t NumPages = 16;
+constexpr u64 Interval = 100;
+
+/// Emulated state made of a tick count and a small RAM, serialized like System does.
+class TestTarget final : public RewindTarget {
+public:
+    u64 ticks = 0;
+    std::vector<u8> ram = std::vector<u8>(NumPages * Memory::PAGE_SIZE);
+    std::shared_ptr<const Memory::SnapshotBase> base;
+
+    u64 GetTicks() const override {
+        return ticks;
+    }
+
+    std::shared_ptr<const Memory::SnapshotBase> GetOrCreateSnapshotBase() override {
+        if (!base) {
+            auto new_base = std::make_shared<Memory::SnapshotBase>();
+            new_base->id = NewSnapshotBaseId();
+            new_base->fcram = ram;
+            base = std::move(new_base);
+        }
+        return base;
+    }
+
+    void SetSnapshotBase(std::shared_ptr<const Memory::SnapshotBase> new_base) override {
+        base = std::move(new_base);
+    }
+
+    u64 NewSnapshotBaseId() override {
+        return next_base_id++;
+    }
+
+    std::vector<u8> SaveIncrementalState() override {
+        std::ostringstream stream;
+        {
+            boost::archive::binary_oarchive oa{stream};
+            oa << ticks;
+            Memory::SerializeRegion(oa, ram.data(), ram.size(), &base->fcram, &last_pages);
+        }
+        const std::string str = stream.str();
+        return std::vector<u8>(str.begin(), str.end());
+    }
+
+    Memory::SnapshotPages GetLastSnapshotPages() override {
+        Memory::SnapshotPages pages;
+        pages.fcram = Memory::CopyPages(ram.data(), last_pages);
+        return pages;
+    }
+
+    void LoadIncrementalState(const std::vector<u8>& state) override {
+        std::istringstream stream{std::string(state.begin(), state.end())};
+        boost::archive::binary_iarchive ia{stream};
+        ia >> ticks;
+        Memory::SerializeRegion(ia, ram.data(), ram.size(), &base->fcram);
+    }
+
+private:
+    u64 next_base_id = 1;
+    std::vector<u32> last_pages;
+};
+
+/// Advances the emulated time by one interval, writes to a page and lets the buffer capture.
+void Step(RewindBuffer& buffer, TestTarget& target, std::size_t page, u8 value) {
+    target.ticks += Interval;
+    target.ram[page * Memory::PAGE_SIZE + value % Memory::PAGE_SIZE] = value;
+    buffer.Update();
+}
+
+} // Anonymous namespace
+
+TEST_CASE("RewindBuffer restores captured states", "[core]") {
+    auto target_ptr = std::make_unique<TestTarget>();
+    TestTarget& target = *target_ptr;
+    RewindBuffer buffer(std::move(target_ptr), Interval, 64 * 1024 * 1024);
+
+    std::vector<std::vector<u8>> states;
+    for (u8 i = 0; i < 6; ++i) {
+        Step(buffer, target, i % NumPages, i + 1);
+        states.push_back(target.ram);
+    }
+    REQUIRE(buffer.GetSnapshotCount() == 6);
+
+    // Changes made after the last capture are dropped
+    target.ram[3] = 0xFF;
+    REQUIRE(buffer.Rewind(1));
+    REQUIRE(target.ram == states[5]);
+    REQUIRE(target.ticks == 6 * Interval);
+    REQUIRE(buffer.GetSnapshotCount() == 5);
+
+    REQUIRE(buffer.Rewind(2));
+    REQUIRE(target.ram == states[3]);
+    REQUIRE(buffer.GetSnapshotCount() == 3);
+
+    // Capturing resumes one interval after the restored snapshot
+    Step(buffer, target, 9, 42);
+    REQUIRE(buffer.GetSnapshotCount() == 4);
+    REQUIRE(buffer.Rewind(1));
+    REQUIRE(target.ram[9 * Memory::PAGE_SIZE + 42] == 42);
+
+    REQUIRE(buffer.Rewind(100));
+    REQUIRE(target.ram == states[0]);
+    REQUIRE(buffer.GetSnapshotCount() == 0);
+    REQUIRE(!buffer.Rewind(1));
+}
+
+TEST_CASE("RewindBuffer rebases when snapshots grow", "[core]") {
+    auto target_ptr = std::make_unique<TestTarget>();
+    TestTarget& target = *target_ptr;
+    RewindBuffer buffer(std::move(target_ptr), Interval, 64 * 1024 * 1024);
+
+    Step(buffer, target, 0, 1);
+    const u64 first_base_id = target.base->id;
+
+    // Touching a quarter of the RAM makes the snapshot large enough to request a new base
+    std::vector<std::vector<u8>> states;
+    for (std::size_t page = 0; page < NumPages / 4; ++page) {
+        target.ram[page * Memory::PAGE_SIZE] = 0xA0;
+    }
+    Step(buffer, target, 5, 2);
+    states.push_back(target.ram);
+
+    // The new base is built in the background and used from a later capture on
+    for (u8 i = 0; i < 100 && target.base->id == first_base_id; ++i) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        Step(buffer, target, 6, i + 3);
+        states.push_back(target.ram);
+    }
+    REQUIRE(target.base->id != first_base_id);
+
+    // The new base holds the RAM of the snapshot it was built from
+    REQUIRE(target.base->fcram == states[0]);
+
+    // Snapshots made against either base restore correctly
+    REQUIRE(buffer.Rewind(1));
+    REQUIRE(target.ram == states.back());
+    REQUIRE(buffer.Rewind(static_cast<u32>(states.size()) - 1));
+    REQUIRE(target.ram == states[0]);
+}
+
+TEST_CASE("RewindBuffer respects its memory budget", "[core]") {
+    auto target_ptr = std::make_unique<TestTarget>();
+    TestTarget& target = *target_ptr;
+    // Room for the base and a few single page snapshots
+    const std::size_t budget = target.ram.size() + 4 * Memory::PAGE_SIZE + 1024;
+    RewindBuffer buffer(std::move(target_ptr), Interval, budget);
+
+    for (u8 i = 0; i < 20; ++i) {
+        Step(buffer, target, 0, i);
+    }
+    REQUIRE(buffer.GetSnapshotCount() < 20);
+    REQUIRE(buffer.GetMemoryUsage() <= budget);
+
+    const std::vector<u8> latest = target.ram;
+    REQUIRE(buffer.Rewind(1));
+    REQUIRE(target.ram == latest);
+
+    buffer.Clear();
+    REQUIRE(buffer.GetSnapshotCount() == 0);
+    REQUIRE(!buffer.Rewind(1));
+}
+
+} // namespace Core
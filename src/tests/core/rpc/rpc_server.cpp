@@ -0,0 +1,106 @@
+// Copyright 2020 Citra Emulator Project
+// Licensed under GPLv2 or any later version
+// Refer to the license.txt file included.
+
+#include <cstring>
+#include <limits>
+#include <vector>
+#include <catch2/catch.hpp>
+#include "core/rpc/packet.h"
+#include "core/rpc/rpc_server.h"
+
+namespace RPC {
+
+namespace {
+
+using MemoryRange = RPCServer::MemoryRange;
+
+std::vector<u8> EncodeRanges(u32 count, const std::vector<MemoryRange>& ranges) {
+    std::vector<u8> data(sizeof(count) + ranges.size() * sizeof(MemoryRange));
+    std::memcpy(data.data(), &count, sizeof(count));
+    std::memcpy(data.data() + sizeof(count), ranges.data(), ranges.size() * sizeof(MemoryRange));
+    return data;
+}
+
+bool Parse(const std::vector<u8>& data, u32 max_total_size, std::vector<MemoryRange>& ranges) {
+    return RPCServer::ParseRanges(data.data(), data.size(), max_total_size, ranges);
+}
+
+} // Anonymous namespace
+
+TEST_CASE("RPCServer::ParseRanges", "[core][rpc]") {
+    std::vector<MemoryRange> ranges;
+
+    SECTION("well-formed ranges are parsed") {
+        const std::vector<MemoryRange> input{{0x08000000, 16}, {0x00100000, 4}};
+        REQUIRE(Parse(EncodeRanges(2, input), MAX_PACKET_DATA_SIZE, ranges));
+        REQUIRE(ranges.size() == 2);
+        REQUIRE(ranges[0].address == 0x08000000);
+        REQUIRE(ranges[0].size == 16);
+        REQUIRE(ranges[1].address == 0x00100000);
+        REQUIRE(ranges[1].size == 4);
+    }
+
+    SECTION("the count must match the data") {
+        const std::vector<MemoryRange> input{{0x08000000, 16}, {0x00100000, 4}};
+        REQUIRE(!Parse(EncodeRanges(3, input), MAX_PACKET_DATA_SIZE, ranges));
+        REQUIRE(!Parse(EncodeRanges(1, input), MAX_PACKET_DATA_SIZE, ranges));
+        REQUIRE(!Parse(EncodeRanges(0, {}), MAX_PACKET_DATA_SIZE, ranges));
+        REQUIRE(!Parse(std::vector<u8>(2), MAX_PACKET_DATA_SIZE, ranges));
+    }
+
+    SECTION("the range count is limited") {
+        const std::vector<MemoryRange> input(MAX_RANGE_COUNT + 1, MemoryRange{0x08000000, 1});
+        REQUIRE(!Parse(EncodeRanges(MAX_RANGE_COUNT + 1, input), MAX_PACKET_DATA_SIZE, ranges));
+    }
+
+    SECTION("the total size is limited without overflowing") {
+        REQUIRE(Parse(EncodeRanges(1, {{0x08000000, 64}}), 64, ranges));
+        REQUIRE(!Parse(EncodeRanges(1, {{0x08000000, 65}}), 64, ranges));
+        REQUIRE(!Parse(EncodeRanges(1, {{0x08000000, 0}}), 64, ranges));
+
+        const u32 max = std::numeric_limits<u32>::max();
+        const std::vector<MemoryRange> input{{0x08000000, max}, {0x08000000, 2}};
+        REQUIRE(!Parse(EncodeRanges(2, input), MAX_PACKET_DATA_SIZE, ranges));
+    }
+}
+
+TEST_CASE("RPCServer::ValidatePacket", "[core][rpc]") {
+    const auto validate = [](u32 version, PacketType type, u32 size) {
+        return RPCServer::ValidatePacket(PacketHeader{version, 1, type, size});
+    };
+
+    SECTION("memory requests need an address and a size") {
+        REQUIRE(validate(1, PacketType::ReadMemory, 8));
+        REQUIRE(validate(2, PacketType::WriteMemory, 12));
+        REQUIRE(!validate(1, PacketType::ReadMemory, 4));
+        REQUIRE(!validate(2, PacketType::WriteMemory, 0));
+    }
+
+    SECTION("the payload size depends on the version") {
+        REQUIRE(validate(1, PacketType::WriteMemory, V1_MAX_PACKET_DATA_SIZE));
+        REQUIRE(!validate(1, PacketType::WriteMemory, V1_MAX_PACKET_DATA_SIZE + 1));
+        REQUIRE(validate(2, PacketType::WriteMemory, MAX_PACKET_DATA_SIZE));
+        REQUIRE(!validate(2, PacketType::WriteMemory, MAX_PACKET_DATA_SIZE + 1));
+    }
+
+    SECTION("version 2 requests are rejected from version 1 clients") {
+        REQUIRE(validate(2, PacketType::ReadMemoryRanges, 4));
+        REQUIRE(!validate(1, PacketType::ReadMemoryRanges, 4));
+        REQUIRE(validate(2, PacketType::Subscribe, 8));
+        REQUIRE(!validate(2, PacketType::Subscribe, 4));
+        REQUIRE(!validate(1, PacketType::Subscribe, 8));
+        REQUIRE(validate(2, PacketType::Unsubscribe, 4));
+        REQUIRE(validate(2, PacketType::RenewSubscription, 4));
+        REQUIRE(!validate(1, PacketType::RenewSubscription, 4));
+    }
+
+    SECTION("unknown versions and types are rejected") {
+        REQUIRE(!validate(0, PacketType::ReadMemory, 8));
+        REQUIRE(!validate(CURRENT_VERSION + 1, PacketType::ReadMemory, 8));
+        REQUIRE(!validate(2, PacketType::SubscriptionUpdate, 8));
+        REQUIRE(!validate(2, PacketType::Undefined, 8));
+    }
+}
+
+} // namespace RPC
@@ -0,0 +1,92 @@
+// Copyright 2020 Citra Emulator Project
+// Licensed under GPLv2 or any later version
+// Refer to the license.txt file included.
+
+#include <array>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <boost/archive/binary_iarchive.hpp>
+#include <boost/archive/binary_oarchive.hpp>
+#include <boost/serialization/vector.hpp>
+#include <catch2/catch.hpp>
+#include "common/file_util.h"
+#include "common/scope_exit.h"
+#include "common/zstd_compression.h"
+#include "core/savestate.h"
+
+namespace Core {
+
+namespace {
+
+std::vector<u32> MakeTestData(std::size_t size) {
+    std::vector<u32> data(size);
+    u32 seed = 12345;
+    for (u32& value : data) {
+        seed = seed * 1103515245 + 12345;
+        value = seed >> 8;
+    }
+    return data;
+}
+
+std::vector<u32> LoadTestData(const std::string& path) {
+    std::vector<u32> loaded;
+    LoadStateFromFile(path, [&loaded](std::streambuf& stream) {
+        boost::archive::binary_iarchive ia{stream};
+        ia >> loaded;
+    });
+    return loaded;
+}
+
+} // Anonymous namespace
+
+TEST_CASE("Savestate files round trip through the chunked format", "[core]") {
+    const std::string path = FileUtil::GetTempDirectory() + "citra_savestate_test.cst";
+    SCOPE_EXIT({ FileUtil::Delete(path); });
+
+    // Large enough to span several chunks, with a partial last one
+    const std::vector<u32> data = MakeTestData(5 * 1024 * 1024);
+
+    SaveStateToFile(path, 0x0004000000123400, [&data](std::streambuf& stream) {
+        boost::archive::binary_oarchive oa{stream};
+        oa << data;
+    });
+    REQUIRE(FileUtil::Exists(path));
+    REQUIRE(!FileUtil::Exists(path + ".tmp"));
+
+    REQUIRE(LoadTestData(path) == data);
+
+    REQUIRE_THROWS_AS(LoadStateFromFile(path + ".missing", [](std::streambuf&) {}),
+                      std::runtime_error);
+}
+
+TEST_CASE("Savestate files from before chunking are still loaded", "[core]") {
+    const std::string path = FileUtil::GetTempDirectory() + "citra_savestate_legacy_test.cst";
+    SCOPE_EXIT({ FileUtil::Delete(path); });
+
+    const std::vector<u32> data = MakeTestData(64 * 1024);
+    std::ostringstream stream{std::ios_base::binary};
+    {
+        boost::archive::binary_oarchive oa{stream};
+        oa << data;
+    }
+    const std::string serialized = stream.str();
+    const std::vector<u8> compressed = Common::Compression::CompressDataZSTDDefault(
+        reinterpret_cast<const u8*>(serialized.data()), serialized.size());
+
+    // Version 0 files are a header with only the magic set, followed by a single zstd frame
+    std::array<u8, 256> header{};
+    header[0] = 'C';
+    header[1] = 'S';
+    header[2] = 'T';
+    header[3] = 0x1B;
+    {
+        FileUtil::IOFile file(path, "wb");
+        REQUIRE(file.WriteBytes(header.data(), header.size()) == header.size());
+        REQUIRE(file.WriteBytes(compressed.data(), compressed.size()) == compressed.size());
+    }
+
+    REQUIRE(LoadTestData(path) == data);
+}
+
+} // namespace Core
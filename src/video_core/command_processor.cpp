@@ -303,6 +303,14 @@ static void WritePicaReg(u32 id, u32 value, u32 mask) {
 
         bool is_indexed = (id == PICA_REG_INDEX(pipeline.trigger_draw_indexed));
 
+        if (VideoCore::g_renderer->Rasterizer()->DiscardsPrimitives()) {
+            // Nothing would be drawn, so don't spend time loading and shading the vertices
+            if (g_debug_context) {
+                g_debug_context->OnEvent(DebugContext::Event::FinishedPrimitiveBatch, nullptr);
+            }
+            break;
+        }
+
         if (accelerate_draw &&
             VideoCore::g_renderer->Rasterizer()->AccelerateDrawBatch(is_indexed)) {
             if (g_debug_context) {
@@ -85,6 +85,11 @@ public:
         return false;
     }
 
+    /// Returns whether primitives are discarded, in which case vertices don't need to be processed
+    virtual bool DiscardsPrimitives() const {
+        return false;
+    }
+
     virtual void LoadDiskResources(const std::atomic_bool& stop_loading,
                                    const DiskResourceLoadCallback& callback) {}
 
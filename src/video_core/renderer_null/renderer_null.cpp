@@ -0,0 +1,56 @@
+// Copyright 2020 Citra Emulator Project
+// Licensed under GPLv2 or any later version
+// Refer to the license.txt file included.
+
+#include <chrono>
+#include <memory>
+#include <thread>
+#include "common/logging/log.h"
+#include "core/core.h"
+#include "core/core_timing.h"
+#include "core/frontend/emu_window.h"
+#include "core/perf_stats.h"
+#include "core/tracer/recorder.h"
+#include "video_core/debug_utils/debug_utils.h"
+#include "video_core/renderer_null/renderer_null.h"
+#include "video_core/video_core.h"
+
+namespace VideoCore {
+
+RendererNull::RendererNull(Frontend::EmuWindow& window) : RendererBase{window} {}
+
+RendererNull::~RendererNull() = default;
+
+ResultStatus RendererNull::Init() {
+    rasterizer = std::make_unique<RasterizerNull>();
+    return ResultStatus::Success;
+}
+
+void RendererNull::SwapBuffers() {
+    if (g_renderer_screenshot_requested) {
+        LOG_WARNING(Render, "Screenshots are not supported by the null renderer");
+        g_renderer_screenshot_requested = false;
+    }
+
+    m_current_frame++;
+
+    Core::System::GetInstance().perf_stats->EndSystemFrame();
+
+    render_window.PollEvents();
+
+    Core::System::GetInstance().frame_limiter.DoFrameLimiting(
+        Core::System::GetInstance().CoreTiming().GetGlobalTimeUs());
+    Core::System::GetInstance().perf_stats->BeginSystemFrame();
+
+    if (Pica::g_debug_context && Pica::g_debug_context->recorder) {
+        Pica::g_debug_context->recorder->FrameFinished();
+    }
+}
+
+void RendererNull::TryPresent(int timeout_ms) {
+    // There is never a frame to present. Wait like a renderer would while waiting for one, so that
+    // the presentation threads of the frontends don't spin.
+    std::this_thread::sleep_for(std::chrono::milliseconds(timeout_ms));
+}
+
+} // namespace VideoCore
@@ -0,0 +1,56 @@
+// Copyright 2020 Citra Emulator Project
+// Licensed under GPLv2 or any later version
+// Refer to the license.txt file included.
+
+#pragma once
+
+#include "common/common_types.h"
+#include "video_core/rasterizer_interface.h"
+#include "video_core/renderer_base.h"
+
+namespace Frontend {
+class EmuWindow;
+}
+
+namespace VideoCore {
+
+/**
+ * Rasterizer that discards everything it is given. Memory fills, display transfers and texture
+ * copies are left to the software implementations of the GPU, so that emulated memory stays
+ * coherent for the games that read back from it.
+ */
+class RasterizerNull : public RasterizerInterface {
+public:
+    void AddTriangle(const Pica::Shader::OutputVertex& v0, const Pica::Shader::OutputVertex& v1,
+                     const Pica::Shader::OutputVertex& v2) override {}
+    void DrawTriangles() override {}
+    void NotifyPicaRegisterChanged(u32 id) override {}
+    void FlushAll() override {}
+    void FlushRegion(PAddr addr, u32 size) override {}
+    void InvalidateRegion(PAddr addr, u32 size) override {}
+    void FlushAndInvalidateRegion(PAddr addr, u32 size) override {}
+    void ClearAll(bool flush) override {}
+
+    bool DiscardsPrimitives() const override {
+        return true;
+    }
+};
+
+/**
+ * Renderer that draws and presents nothing, for running the CPU, HLE and audio emulation without a
+ * graphics context. It still paces emulated frames and updates the performance statistics.
+ */
+class RendererNull : public RendererBase {
+public:
+    explicit RendererNull(Frontend::EmuWindow& window);
+    ~RendererNull() override;
+
+    ResultStatus Init() override;
+    void ShutDown() override {}
+    void SwapBuffers() override;
+    void TryPresent(int timeout_ms) override;
+    void PrepareVideoDumping() override {}
+    void CleanupVideoDumping() override {}
+};
+
+} // namespace VideoCore
@@ -9,6 +9,7 @@
 #include "video_core/pica.h"
 #include "video_core/pica_state.h"
 #include "video_core/renderer_base.h"
+#include "video_core/renderer_null/renderer_null.h"
 #include "video_core/renderer_opengl/gl_vars.h"
 #include "video_core/renderer_opengl/renderer_opengl.h"
 #include "video_core/video_core.h"
@@ -45,7 +46,15 @@ ResultStatus Init(Frontend::EmuWindow& emu_window, Memory::MemorySystem& memory)
 
     OpenGL::GLES = Settings::values.use_gles;
 
-    g_renderer = std::make_unique<OpenGL::RendererOpenGL>(emu_window);
+    switch (Settings::values.renderer_backend) {
+    case Settings::RendererBackend::Null:
+        g_renderer = std::make_unique<RendererNull>(emu_window);
+        break;
+    case Settings::RendererBackend::OpenGL:
+    default:
+        g_renderer = std::make_unique<OpenGL::RendererOpenGL>(emu_window);
+        break;
+    }
     ResultStatus result = g_renderer->Init();
 
     if (result != ResultStatus::Success) {